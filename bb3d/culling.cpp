@@ -0,0 +1,101 @@
+#include "bb3d/culling.hpp"
+
+#include <GL/glew.h>  // for GL_LINE_LOOP, GL_LINE_STRIP, GL_TRIANGLE_FAN, GL_TRIANGLE_STRIP
+
+#include <algorithm>  // for min, max
+
+#include "bb3d/shader/camera_uniforms.hpp"  // for CameraUniforms, CameraBlock
+
+namespace bb3d {
+
+Frustum::Frustum(const glm::mat4 &view_proj) {
+  // glm is column major, view_proj[c][r] is row r of column c.
+  const auto row = [&view_proj](int r) {
+    return glm::vec4(view_proj[0][r], view_proj[1][r], view_proj[2][r], view_proj[3][r]);
+  };
+  // A point is inside when -w <= x, y, z <= w in clip space.
+  planes_[0] = row(3) + row(0);
+  planes_[1] = row(3) - row(0);
+  planes_[2] = row(3) + row(1);
+  planes_[3] = row(3) - row(1);
+  planes_[4] = row(3) + row(2);
+  planes_[5] = row(3) - row(2);
+}
+
+Frustum Frustum::FromCamera() {
+  const CameraBlock &block = CameraUniforms::Get().Block();
+  return Frustum(block.proj * block.view);
+}
+
+bool Frustum::Intersects(const Aabb &box) const {
+  for (const glm::vec4 &plane : planes_) {
+    // The corner furthest along the plane's normal is outside only if the whole box is.
+    const glm::vec3 corner(plane.x > 0 ? box.max.x : box.min.x, plane.y > 0 ? box.max.y : box.min.y,
+                           plane.z > 0 ? box.max.z : box.min.z);
+    if (glm::dot(glm::vec3(plane), corner) + plane.w < 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+CullStats SegmentChunks::Visible(const Frustum &frustum, const GLenum mode,
+                                 std::vector<GLint> *firsts, std::vector<GLint> *counts) const {
+  const bool whole_segments = mode == GL_LINE_LOOP || mode == GL_TRIANGLE_FAN;
+  // vertices a strip shares with the next chunk
+  const GLint overlap = mode == GL_LINE_STRIP ? 1 : mode == GL_TRIANGLE_STRIP ? 2 : 0;
+
+  firsts->resize(0);
+  counts->resize(0);
+  CullStats stats{0, 0};
+  GLint last_segment_end = -1;
+  for (const Chunk &chunk : chunks_) {
+    if (!frustum.Intersects(chunk.bounds)) {
+      stats.culled++;
+      continue;
+    }
+    stats.drawn++;
+    const bool same_segment = chunk.segment_end == last_segment_end;
+    last_segment_end = chunk.segment_end;
+    if (whole_segments) {
+      if (!same_segment) {
+        firsts->push_back(chunk.segment_first);
+        counts->push_back(chunk.segment_end - chunk.segment_first);
+      }
+      continue;
+    }
+    const GLint end = std::min(chunk.first + chunk.count + overlap, chunk.segment_end);
+    if (same_segment && firsts->back() + counts->back() >= chunk.first) {
+      counts->back() = end - firsts->back();
+    } else {
+      firsts->push_back(chunk.first);
+      counts->push_back(end - chunk.first);
+    }
+  }
+  return stats;
+}
+
+void GridTiles::Reset(const int rows, const int cols) {
+  rows_ = rows;
+  cols_ = cols;
+  tile_rows_ = (rows + kTileSize - 1) / kTileSize;
+  tile_cols_ = (cols + kTileSize - 1) / kTileSize;
+  tiles_.assign(static_cast<size_t>(tile_rows_ * tile_cols_), Aabb{});
+}
+
+void GridTiles::ExtendPoint(const int row, const int col, const Aabb &bounds) {
+  if (rows_ == 0 || cols_ == 0) {
+    return;
+  }
+  const int tile_row_begin = std::min(std::max(row - 1, 0), rows_ - 1) / kTileSize;
+  const int tile_row_end = std::min(row, rows_ - 1) / kTileSize;
+  const int tile_col_begin = std::min(std::max(col - 1, 0), cols_ - 1) / kTileSize;
+  const int tile_col_end = std::min(col, cols_ - 1) / kTileSize;
+  for (int tile_row = tile_row_begin; tile_row <= tile_row_end; tile_row++) {
+    for (int tile_col = tile_col_begin; tile_col <= tile_col_end; tile_col++) {
+      tiles_[static_cast<size_t>(tile_row * tile_cols_ + tile_col)].Extend(bounds);
+    }
+  }
+}
+
+};  // namespace bb3d
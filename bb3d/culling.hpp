@@ -0,0 +1,167 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLint, GLenum
+
+#include <algorithm>    // for min
+#include <array>        // for array
+#include <cstddef>      // for size_t
+#include <glm/glm.hpp>  // for vec3, vec4, mat4
+#include <limits>       // for numeric_limits
+#include <utility>      // for pair
+#include <vector>       // for vector
+
+#include "bb3d/span.hpp"  // for Span
+
+namespace bb3d {
+
+// Axis-aligned bounding box. A default constructed box is empty and contains nothing.
+struct Aabb {
+  glm::vec3 min{std::numeric_limits<float>::infinity()};
+  glm::vec3 max{-std::numeric_limits<float>::infinity()};
+
+  void Extend(const glm::vec3 &point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+  }
+  void Extend(const Aabb &other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+  }
+  [[nodiscard]] bool Empty() const { return min.x > max.x || min.y > max.y || min.z > max.z; }
+};
+
+// The six clip planes of a view-projection matrix (Gribb and Hartmann), for rejecting bounding
+// boxes which are entirely outside of the view. The test is conservative: a box which straddles two
+// planes outside of a frustum corner is reported as visible.
+class Frustum {
+ public:
+  explicit Frustum(const glm::mat4 &view_proj);
+  // From the view and proj currently in CameraUniforms.
+  static Frustum FromCamera();
+
+  [[nodiscard]] bool Intersects(const Aabb &box) const;
+
+ private:
+  std::array<glm::vec4, 6> planes_{};
+};
+
+// Number of chunks the last Draw submitted and skipped.
+struct CullStats {
+  int drawn;
+  int culled;
+};
+
+// Bounds of the polylines of Lines and ColorLines, split into chunks of at most kChunkVertices
+// vertices, so that only the visible parts of a long polyline are drawn.
+class SegmentChunks {
+ public:
+  // Divisible by 2 and 3, so GL_LINES and GL_TRIANGLES chunks start on a primitive boundary.
+  static constexpr GLint kChunkVertices = 1536;
+
+  // Segment k is vertices [firsts[k], firsts[k] + sizes[k]) and position_of(vertex) returns the
+  // position of a vertex.
+  template <typename PositionOf>
+  void Update(Span<GLint> firsts, Span<GLint> sizes, PositionOf position_of) {
+    chunks_.clear();
+    for (size_t k = 0; k < firsts.size(); k++) {
+      const GLint segment_end = firsts[k] + sizes[k];
+      for (GLint first = firsts[k]; first < segment_end; first += kChunkVertices) {
+        Chunk chunk{first, std::min(kChunkVertices, segment_end - first), firsts[k], segment_end,
+                    Aabb{}};
+        // Strips continue into the next chunk, include the vertices they share.
+        const GLint bounds_end = std::min(first + chunk.count + 2, segment_end);
+        for (GLint vertex = first; vertex < bounds_end; vertex++) {
+          chunk.bounds.Extend(position_of(vertex));
+        }
+        chunks_.push_back(chunk);
+      }
+    }
+  }
+
+  // Replace firsts/counts with the ranges to draw with `mode`: the visible chunks, adjacent ones
+  // merged. Line loops and triangle fans are drawn whole if any part of them is visible.
+  CullStats Visible(const Frustum &frustum, GLenum mode, std::vector<GLint> *firsts,
+                    std::vector<GLint> *counts) const;
+  [[nodiscard]] int NumChunks() const { return static_cast<int>(chunks_.size()); }
+
+ private:
+  struct Chunk {
+    GLint first;
+    GLint count;
+    GLint segment_first;
+    GLint segment_end;
+    Aabb bounds;
+  };
+  std::vector<Chunk> chunks_{};
+};
+
+// Bounds of a rows x cols grid of cells, such as the quads of Gridmesh, kept per tile of
+// kTileSize x kTileSize cells. Cells are numbered row * cols + col, which has to be their order in
+// the buffers so that the visible cells form ranges which one multi-draw can submit.
+class GridTiles {
+ public:
+  static constexpr int kTileSize = 32;
+
+  // Resize to rows x cols cells and empty all tiles.
+  void Reset(int rows, int cols);
+  // Extend the tiles of the cells which use grid point (row, col), cells (row - 1, col - 1) up to
+  // (row, col), by `bounds`. Points are numbered like cells, with the last row and column of points
+  // only used by their neighbors when the grid has one point more than cells in each direction.
+  void ExtendPoint(int row, int col, const Aabb &bounds);
+  [[nodiscard]] int NumTiles() const { return tile_rows_ * tile_cols_; }
+
+  // Calls draw(cell_begin, cell_end) for each range of cells [cell_begin, cell_end) whose tiles are
+  // visible, merging ranges which continue on the next row, and returns the number of tiles drawn
+  // and culled.
+  template <typename Draw>
+  CullStats ForEachVisibleRange(const Frustum &frustum, Draw draw) {
+    CullStats stats{0, 0};
+    int range_begin = 0;
+    int range_end = 0;
+    for (int tile_row = 0; tile_row < tile_rows_; tile_row++) {
+      runs_.resize(0);
+      for (int tile_col = 0; tile_col < tile_cols_; tile_col++) {
+        const Aabb &bounds = tiles_[static_cast<size_t>(tile_row * tile_cols_ + tile_col)];
+        if (bounds.Empty() || !frustum.Intersects(bounds)) {
+          stats.culled++;
+          continue;
+        }
+        stats.drawn++;
+        const int col_begin = tile_col * kTileSize;
+        const int col_end = std::min(col_begin + kTileSize, cols_);
+        if (!runs_.empty() && runs_.back().second == col_begin) {
+          runs_.back().second = col_end;
+        } else {
+          runs_.emplace_back(col_begin, col_end);
+        }
+      }
+      const int row_end = std::min((tile_row + 1) * kTileSize, rows_);
+      for (int row = tile_row * kTileSize; row < row_end; row++) {
+        for (const std::pair<int, int> &run : runs_) {
+          const int begin = row * cols_ + run.first;
+          if (begin != range_end && range_end > range_begin) {
+            draw(range_begin, range_end);
+            range_begin = begin;
+          } else if (range_end == range_begin) {
+            range_begin = begin;
+          }
+          range_end = row * cols_ + run.second;
+        }
+      }
+    }
+    if (range_end > range_begin) {
+      draw(range_begin, range_end);
+    }
+    return stats;
+  }
+
+ private:
+  int rows_ = 0;
+  int cols_ = 0;
+  int tile_rows_ = 0;
+  int tile_cols_ = 0;
+  std::vector<Aabb> tiles_{};
+  std::vector<std::pair<int, int> > runs_{};  // reused by ForEachVisibleRange
+};
+
+};  // namespace bb3d
@@ -0,0 +1,30 @@
+#pragma once
+
+namespace bb3d {
+
+// Calls upload(begin, end) for every run [begin, end) of elements in [0, size) for which
+// changed(k) is true. Runs separated by fewer than max_gap unchanged elements are merged, since one
+// slightly larger upload is cheaper than two small ones.
+template <typename Changed, typename Upload>
+void ForEachDirtyRun(const int size, const int max_gap, Changed changed, Upload upload) {
+  int run_begin = -1;
+  int run_end = -1;
+  for (int k = 0; k < size; k++) {
+    if (!changed(k)) {
+      continue;
+    }
+    if (run_begin >= 0 && k - run_end >= max_gap) {
+      upload(run_begin, run_end);
+      run_begin = -1;
+    }
+    if (run_begin < 0) {
+      run_begin = k;
+    }
+    run_end = k + 1;
+  }
+  if (run_begin >= 0) {
+    upload(run_begin, run_end);
+  }
+}
+
+};  // namespace bb3d
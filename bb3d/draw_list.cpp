@@ -0,0 +1,46 @@
+#include "bb3d/draw_list.hpp"
+
+#include <algorithm>  // for stable_sort, find_if
+#include <tuple>      // for tie
+#include <utility>    // for move
+
+#include "bb3d/assert.hpp"    // for ASSERT
+#include "bb3d/profiler.hpp"  // for Profiler
+
+namespace bb3d {
+
+int DrawList::Add(std::function<DrawState()> state, std::function<void()> draw) {
+  const int handle = next_handle_++;
+  entries_.push_back({handle, std::move(state), std::move(draw)});
+  return handle;
+}
+
+void DrawList::Remove(const int handle) {
+  const auto entry =
+      std::find_if(entries_.begin(), entries_.end(),
+                   [handle](const Entry &candidate) { return candidate.handle == handle; });
+  ASSERT(entry != entries_.end());
+  entries_.erase(entry);
+}
+
+void DrawList::Draw(const DrawPass pass) {
+  const Profiler::CpuScope cpu_scope("DrawList::Draw");
+  submissions_.clear();
+  for (size_t k = 0; k < entries_.size(); k++) {
+    const DrawState state = entries_[k].state();
+    if (state.pass == pass) {
+      submissions_.push_back({state, k});
+    }
+  }
+  // Programs are the most expensive to switch, then textures, then blending.
+  std::stable_sort(submissions_.begin(), submissions_.end(),
+                   [](const Submission &a, const Submission &b) {
+                     return std::tie(a.state.program, a.state.texture, a.state.blend) <
+                            std::tie(b.state.program, b.state.texture, b.state.blend);
+                   });
+  for (const Submission &submission : submissions_) {
+    entries_[submission.entry].draw();
+  }
+}
+
+};  // namespace bb3d
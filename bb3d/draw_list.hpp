@@ -0,0 +1,67 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLuint
+
+#include <cstddef>     // for size_t
+#include <functional>  // for function
+#include <vector>      // for vector
+
+namespace bb3d {
+
+enum class DrawPass {
+  kOpaque,
+  // Blended, drawn after everything opaque.
+  kTransparent,
+};
+
+// The state a drawable's Draw sets, which DrawList sorts the submissions by. Each drawable
+// describes its own with a State() method.
+struct DrawState {
+  DrawPass pass = DrawPass::kOpaque;
+  GLuint program = 0;
+  GLuint texture = 0;  // on texture unit 0, 0 if none
+  bool blend = false;
+};
+
+// Retained-mode scene: drawables are added once and drawn by Window::Run every frame until they
+// are removed. Each frame the submissions of a pass are sorted by program, texture and blend
+// state, so that with the state cache of GlState consecutive drawables only change what differs
+// between them, whatever order they were added in. Submissions with the same state keep the order
+// they were added in. See GlState::FrameStats for the number of state changes per frame.
+class DrawList {
+ public:
+  // Draw `drawable` every frame with drawable.Draw(draw_args...), e.g. the mode of a ColorLines,
+  // sorted by drawable.State(). The drawable has to outlive its submission. Returns a handle for
+  // Remove.
+  template <typename T, typename... Args>
+  int Add(T &drawable, Args... draw_args) {
+    return Add([&drawable]() { return drawable.State(); },
+               [&drawable, draw_args...]() { drawable.Draw(draw_args...); });
+  }
+  // Same as above for anything else: state is called every frame before sorting.
+  int Add(std::function<DrawState()> state, std::function<void()> draw);
+  void Remove(int handle);
+  [[nodiscard]] size_t Size() const { return entries_.size(); }
+
+  // Draw the submissions of one pass, in state order, with the view and projection in
+  // CameraUniforms.
+  void Draw(DrawPass pass);
+
+ private:
+  struct Entry {
+    int handle;
+    std::function<DrawState()> state;
+    std::function<void()> draw;
+  };
+
+  struct Submission {
+    DrawState state;
+    size_t entry;  // index into entries_
+  };
+
+  int next_handle_ = 0;
+  std::vector<Entry> entries_{};
+  std::vector<Submission> submissions_{};  // reused by Draw
+};
+
+};  // namespace bb3d
@@ -0,0 +1,307 @@
+#include "bb3d/frame_capture.hpp"
+
+#include <GL/glew.h>   // for glReadPixels, glFenceSync, glClientWaitSync, glMapBufferRange
+#include <sys/stat.h>  // for mkdir
+#include <zlib.h>      // for compress2, compressBound, crc32, Z_BEST_SPEED, Z_OK
+
+#include <cerrno>   // for errno, EEXIST
+#include <cstdint>  // for uint8_t, uint32_t
+#include <cstdio>   // for fprintf, fopen, fwrite, fclose, snprintf, stderr
+#include <cstdlib>  // for EXIT_FAILURE
+#include <cstring>  // for memcpy
+#include <mutex>    // for lock_guard, unique_lock
+#include <string>   // for string
+#include <utility>  // for move
+#include <vector>   // for vector
+
+#include "bb3d/assert.hpp"  // for ASSERT, exit_thread_safe
+
+namespace bb3d {
+
+FrameCapture::FrameCapture(const CaptureOptions &options, const int width, const int height)
+    : options_(options),
+      width_(width),
+      height_(height),
+      frame_bytes_(4 * static_cast<size_t>(width) * static_cast<size_t>(height)),
+      writer_() {
+  ASSERT(width_ > 0 && height_ > 0);
+  ASSERT(options_.max_queued_frames > 0);
+
+  if (options_.format == CaptureFormat::kPngSequence) {
+    if (mkdir(options_.path.c_str(), 0755) != 0 && errno != EEXIST) {
+      fprintf(stderr, "Frame capture: can't create directory '%s'\n", options_.path.c_str());
+      exit_thread_safe(EXIT_FAILURE);
+    }
+  } else {
+    stream_ = fopen(options_.path.c_str(), "wb");
+    if (stream_ == nullptr) {
+      fprintf(stderr, "Frame capture: can't open '%s'\n", options_.path.c_str());
+      exit_thread_safe(EXIT_FAILURE);
+    }
+    if (options_.format == CaptureFormat::kY4m) {
+      fprintf(stream_, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width_, height_, options_.fps);
+    }
+  }
+
+  for (Readback &readback : readbacks_) {
+    glGenBuffers(1, &readback.pixel_buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixel_buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<GLsizeiptr>(frame_bytes_), nullptr,
+                 GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  writer_ = std::thread(&FrameCapture::WriterLoop, this);
+}
+
+FrameCapture::~FrameCapture() {
+  CollectFinished(true);
+  for (Readback &readback : readbacks_) {
+    glDeleteBuffers(1, &readback.pixel_buffer);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  frame_queued_.notify_one();
+  writer_.join();
+
+  if (stream_ != nullptr) {
+    fclose(stream_);
+  }
+  fprintf(stderr, "Frame capture: %d frames written to '%s', %d dropped\n", stats_.written,
+          options_.path.c_str(), stats_.dropped);
+}
+
+void FrameCapture::CaptureFrame(const GLuint framebuffer) {
+  const int frame = next_frame_++;
+
+  CollectFinished(false);
+  Readback *free_readback = nullptr;
+  for (Readback &readback : readbacks_) {
+    if (readback.fence == nullptr) {
+      free_readback = &readback;
+      break;
+    }
+  }
+  if (free_readback == nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.dropped++;
+    fprintf(stderr, "Frame capture: dropped frame %d, the GPU is behind on readbacks\n", frame);
+    return;
+  }
+
+  GLint previous_read_framebuffer = 0;
+  glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &previous_read_framebuffer);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glReadBuffer(framebuffer == 0 ? GL_BACK : GL_COLOR_ATTACHMENT0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, free_readback->pixel_buffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  // Into the pixel buffer, so this only queues the copy. RGBA because it matches the framebuffer
+  // layout, which keeps the copy on the driver's fast path.
+  glReadPixels(0, 0, width_, height_, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, static_cast<GLuint>(previous_read_framebuffer));
+
+  free_readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  free_readback->frame = frame;
+}
+
+void FrameCapture::CollectFinished(const bool wait) {
+  // Oldest first, so frames reach the writer in order. Fences signal in order too, so once one
+  // isn't done the newer ones aren't either.
+  while (true) {
+    Readback *oldest = nullptr;
+    for (Readback &readback : readbacks_) {
+      if (readback.fence != nullptr && (oldest == nullptr || readback.frame < oldest->frame)) {
+        oldest = &readback;
+      }
+    }
+    if (oldest == nullptr) {
+      return;
+    }
+    Collect(*oldest, wait);
+    if (oldest->fence != nullptr) {
+      return;
+    }
+  }
+}
+
+void FrameCapture::Collect(Readback &readback, const bool wait) {
+  if (readback.fence == nullptr) {
+    return;
+  }
+  const GLuint64 timeout_ns = wait ? 1000000000 : 0;
+  GLenum status = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout_ns);
+  while (wait && status == GL_TIMEOUT_EXPIRED) {
+    status = glClientWaitSync(readback.fence, 0, timeout_ns);
+  }
+  if (status == GL_TIMEOUT_EXPIRED) {
+    return;
+  }
+  glDeleteSync(readback.fence);
+  readback.fence = nullptr;
+
+  std::vector<uint8_t> rgba;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.size() >= options_.max_queued_frames) {
+      stats_.dropped++;
+      fprintf(stderr, "Frame capture: dropped frame %d, the writer is behind\n", readback.frame);
+      return;
+    }
+    if (!free_buffers_.empty()) {
+      rgba = std::move(free_buffers_.back());
+      free_buffers_.pop_back();
+    }
+  }
+  rgba.resize(frame_bytes_);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixel_buffer);
+  const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                        static_cast<GLsizeiptr>(frame_bytes_), GL_MAP_READ_BIT);
+  memcpy(rgba.data(), pixels, frame_bytes_);
+  glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    queue_.push_back(Frame{readback.frame, std::move(rgba)});
+    stats_.captured++;
+  }
+  frame_queued_.notify_one();
+}
+
+CaptureStats FrameCapture::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return stats_;
+}
+
+void FrameCapture::WriterLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    frame_queued_.wait(lock, [this]() { return stopping_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return;  // stopping, and everything is written
+    }
+    Frame frame = std::move(queue_.front());
+    queue_.pop_front();
+
+    lock.unlock();
+    Write(frame);
+    lock.lock();
+
+    stats_.written++;
+    free_buffers_.push_back(std::move(frame.rgba));
+  }
+}
+
+void FrameCapture::Write(const Frame &frame) {
+  if (options_.format == CaptureFormat::kPngSequence) {
+    WritePng(frame);
+  } else {
+    WriteStream(frame);
+  }
+}
+
+static void AppendBigEndian(std::vector<uint8_t> &out, const uint32_t value) {
+  out.push_back(static_cast<uint8_t>(value >> 24U));
+  out.push_back(static_cast<uint8_t>(value >> 16U));
+  out.push_back(static_cast<uint8_t>(value >> 8U));
+  out.push_back(static_cast<uint8_t>(value));
+}
+
+static void AppendPngChunk(std::vector<uint8_t> &out, const char *type, const uint8_t *data,
+                           const size_t size) {
+  AppendBigEndian(out, static_cast<uint32_t>(size));
+  const size_t type_begin = out.size();
+  out.insert(out.end(), type, type + 4);
+  out.insert(out.end(), data, data + size);
+  const uLong crc = crc32(0, out.data() + type_begin, static_cast<uInt>(size + 4));
+  AppendBigEndian(out, static_cast<uint32_t>(crc));
+}
+
+void FrameCapture::WritePng(const Frame &frame) {
+  // Raw scanlines: a filter type byte (0, none) and RGB, top row first.
+  const auto width = static_cast<size_t>(width_);
+  const size_t row_bytes = 1 + 3 * width;
+  scratch_.resize(row_bytes * static_cast<size_t>(height_));
+  for (int row = 0; row < height_; row++) {
+    const uint8_t *src = frame.rgba.data() + 4 * width * static_cast<size_t>(height_ - 1 - row);
+    uint8_t *dst = scratch_.data() + row_bytes * static_cast<size_t>(row);
+    *dst++ = 0;
+    for (size_t k = 0; k < width; k++) {
+      *dst++ = src[4 * k];
+      *dst++ = src[4 * k + 1];
+      *dst++ = src[4 * k + 2];
+    }
+  }
+
+  // Favor speed over size, so the writer keeps up.
+  uLongf compressed_size = compressBound(static_cast<uLong>(scratch_.size()));
+  std::vector<uint8_t> compressed(compressed_size);
+  if (compress2(compressed.data(), &compressed_size, scratch_.data(),
+                static_cast<uLong>(scratch_.size()), Z_BEST_SPEED) != Z_OK) {
+    fprintf(stderr, "Frame capture: compressing frame %d failed\n", frame.frame);
+    return;
+  }
+
+  std::vector<uint8_t> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  std::vector<uint8_t> header;
+  AppendBigEndian(header, static_cast<uint32_t>(width_));
+  AppendBigEndian(header, static_cast<uint32_t>(height_));
+  // 8 bit depth, truecolor, deflate, adaptive filtering, no interlace
+  header.insert(header.end(), {8, 2, 0, 0, 0});
+  AppendPngChunk(png, "IHDR", header.data(), header.size());
+  AppendPngChunk(png, "IDAT", compressed.data(), compressed_size);
+  AppendPngChunk(png, "IEND", nullptr, 0);
+
+  std::string path(options_.path.size() + 32, '\0');
+  snprintf(path.data(), path.size(), "%s/frame_%06d.png", options_.path.c_str(), frame.frame);
+  FILE *file = fopen(path.c_str(), "wb");
+  if (file == nullptr || fwrite(png.data(), 1, png.size(), file) != png.size()) {
+    fprintf(stderr, "Frame capture: writing '%s' failed\n", path.c_str());
+  }
+  if (file != nullptr) {
+    fclose(file);
+  }
+}
+
+void FrameCapture::WriteStream(const Frame &frame) {
+  const auto width = static_cast<size_t>(width_);
+  const size_t plane = width * static_cast<size_t>(height_);
+  scratch_.resize(3 * plane);
+  for (int row = 0; row < height_; row++) {
+    const uint8_t *src = frame.rgba.data() + 4 * width * static_cast<size_t>(height_ - 1 - row);
+    const size_t dst = width * static_cast<size_t>(row);
+    for (size_t k = 0; k < width; k++) {
+      const int r = src[4 * k];
+      const int g = src[4 * k + 1];
+      const int b = src[4 * k + 2];
+      if (options_.format == CaptureFormat::kRawRgb) {
+        scratch_[3 * (dst + k)] = static_cast<uint8_t>(r);
+        scratch_[3 * (dst + k) + 1] = static_cast<uint8_t>(g);
+        scratch_[3 * (dst + k) + 2] = static_cast<uint8_t>(b);
+      } else {
+        // BT.601 limited range, which is what Y4M readers assume, as planar Y, U and V.
+        scratch_[dst + k] = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        // The chroma offset of 128 is added before shifting, to keep the sums positive.
+        scratch_[plane + dst + k] =
+            static_cast<uint8_t>((-38 * r - 74 * g + 112 * b + 128 * 256 + 128) >> 8);
+        scratch_[2 * plane + dst + k] =
+            static_cast<uint8_t>((112 * r - 94 * g - 18 * b + 128 * 256 + 128) >> 8);
+      }
+    }
+  }
+
+  if (options_.format == CaptureFormat::kY4m) {
+    fputs("FRAME\n", stream_);
+  }
+  if (fwrite(scratch_.data(), 1, scratch_.size(), stream_) != scratch_.size()) {
+    fprintf(stderr, "Frame capture: writing frame %d to '%s' failed\n", frame.frame,
+            options_.path.c_str());
+  }
+}
+
+};  // namespace bb3d
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLuint, GLsync
+
+#include <array>               // for array
+#include <condition_variable>  // for condition_variable
+#include <cstddef>             // for size_t
+#include <cstdint>             // for uint8_t
+#include <cstdio>              // for FILE
+#include <deque>               // for deque
+#include <mutex>               // for mutex
+#include <string>              // for string
+#include <thread>              // for thread
+#include <vector>              // for vector
+
+namespace bb3d {
+
+enum class CaptureFormat {
+  // One PNG per frame, <path>/frame_000000.png, ...
+  kPngSequence,
+  // YUV4MPEG2 (4:4:4) stream in the file <path>, playable by ffmpeg and mpv.
+  kY4m,
+  // Headerless rgb24 stream in the file <path>, e.g. for
+  //   ffmpeg -f rawvideo -pixel_format rgb24 -video_size WxH -framerate 60 -i <path> out.mp4
+  kRawRgb,
+};
+
+struct CaptureOptions {
+  CaptureFormat format = CaptureFormat::kPngSequence;
+  std::string path;
+  int fps = 60;  // only recorded in the Y4M header
+  // Frames read back but not yet written. When the writer falls this far behind, new frames are
+  // dropped instead of growing the queue.
+  size_t max_queued_frames = 16;
+};
+
+struct CaptureStats {
+  int captured;  // handed to the writer
+  int written;
+  int dropped;  // readback ring or writer queue full
+};
+
+// Records the frames a Window renders without stalling it. Each frame is read back into one of a
+// ring of pixel buffer objects, and only mapped once its fence has signaled, a couple of frames
+// later. Converting and writing the frames happens on a background thread. When either the ring or
+// the writer's queue is full, the frame is dropped and counted instead of waiting.
+//
+// The frame size is fixed when the capture starts.
+class FrameCapture {
+ public:
+  FrameCapture(const CaptureOptions &options, int width, int height);
+  // Collects the frames still in flight, waiting for them, and finishes writing.
+  ~FrameCapture();
+  FrameCapture(const FrameCapture &) = delete;
+  FrameCapture &operator=(const FrameCapture &) = delete;
+
+  // Start reading back the color buffer of `framebuffer` (0 for the window's back buffer), after
+  // the frame is drawn and before it is swapped. Also passes finished readbacks to the writer.
+  void CaptureFrame(GLuint framebuffer);
+
+  [[nodiscard]] CaptureStats Stats() const;
+
+ private:
+  static constexpr int kNumPixelBuffers = 3;
+
+  struct Readback {
+    GLuint pixel_buffer = 0;
+    GLsync fence = nullptr;
+    int frame = 0;
+  };
+
+  struct Frame {
+    int frame;
+    std::vector<uint8_t> rgba;  // bottom row first, as read by glReadPixels
+  };
+
+  // Hand the readbacks which are done to the writer, or all of them when `wait` is set.
+  void CollectFinished(bool wait);
+  void Collect(Readback &readback, bool wait);
+  void WriterLoop();
+  void Write(const Frame &frame);
+  void WritePng(const Frame &frame);
+  void WriteStream(const Frame &frame);
+
+  CaptureOptions options_;
+  int width_;
+  int height_;
+  size_t frame_bytes_;
+  int next_frame_ = 0;
+  std::array<Readback, kNumPixelBuffers> readbacks_{};
+
+  // shared with the writer thread
+  mutable std::mutex mutex_{};
+  std::condition_variable frame_queued_{};
+  std::deque<Frame> queue_{};
+  std::vector<std::vector<uint8_t> > free_buffers_{};  // recycled Frame::rgba
+  bool stopping_ = false;
+  CaptureStats stats_{0, 0, 0};
+
+  // only touched by the writer thread
+  FILE *stream_ = nullptr;
+  std::vector<uint8_t> scratch_{};
+
+  std::thread writer_;
+};
+
+};  // namespace bb3d
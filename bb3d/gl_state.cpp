@@ -0,0 +1,111 @@
+#include "bb3d/gl_state.hpp"
+
+#include <GL/glew.h>  // for glUseProgram, glBindVertexArray, glBindTexture, glEnable, glDisable
+
+#include <utility>  // for pair, make_pair
+
+namespace bb3d {
+
+GlState &GlState::Get() {
+  // Never destroyed, drawables may still Invalidate from static destructors.
+  static GlState *instance = new GlState();
+  return *instance;
+}
+
+void GlState::UseProgram(const GLuint program) {
+  if (program_ == program) {
+    stats_.skipped++;
+    return;
+  }
+  glUseProgram(program);
+  program_ = program;
+  stats_.programs++;
+}
+
+void GlState::BindVertexArray(const GLuint vertex_array) {
+  if (vertex_array_ == vertex_array) {
+    stats_.skipped++;
+    return;
+  }
+  glBindVertexArray(vertex_array);
+  vertex_array_ = vertex_array;
+  stats_.vertex_arrays++;
+}
+
+void GlState::BindTexture(const GLuint unit, const GLenum target, const GLuint texture) {
+  TextureBinding *binding = nullptr;
+  for (TextureBinding &candidate : textures_) {
+    if (candidate.unit == unit && candidate.target == target) {
+      binding = &candidate;
+      break;
+    }
+  }
+  if (binding != nullptr && binding->texture == texture) {
+    stats_.skipped++;
+    return;
+  }
+  if (active_texture_unit_ != unit) {
+    glActiveTexture(GL_TEXTURE0 + unit);
+    active_texture_unit_ = unit;
+    stats_.textures++;
+  }
+  glBindTexture(target, texture);
+  stats_.textures++;
+  if (binding != nullptr) {
+    binding->texture = texture;
+  } else {
+    textures_.push_back({unit, target, texture});
+  }
+}
+
+void GlState::SetEnabled(const GLenum capability, const bool enabled) {
+  std::pair<GLenum, bool> *cached = nullptr;
+  for (std::pair<GLenum, bool> &candidate : capabilities_) {
+    if (candidate.first == capability) {
+      cached = &candidate;
+      break;
+    }
+  }
+  if (cached != nullptr && cached->second == enabled) {
+    stats_.skipped++;
+    return;
+  }
+  if (enabled) {
+    glEnable(capability);
+  } else {
+    glDisable(capability);
+  }
+  stats_.capabilities++;
+  if (cached != nullptr) {
+    cached->second = enabled;
+  } else {
+    capabilities_.emplace_back(capability, enabled);
+  }
+}
+
+void GlState::BlendFunc(const GLenum source_factor, const GLenum destination_factor) {
+  const std::pair<GLenum, GLenum> blend_func = std::make_pair(source_factor, destination_factor);
+  if (blend_func_ == blend_func) {
+    stats_.skipped++;
+    return;
+  }
+  glBlendFunc(source_factor, destination_factor);
+  blend_func_ = blend_func;
+  stats_.blend_funcs++;
+}
+
+void GlState::Invalidate() {
+  program_.reset();
+  vertex_array_.reset();
+  active_texture_unit_.reset();
+  textures_.clear();
+  capabilities_.clear();
+  blend_func_.reset();
+}
+
+void GlState::EndFrame() {
+  frame_stats_ = stats_;
+  stats_ = {0, 0, 0, 0, 0, 0, 0};
+}
+
+};  // namespace bb3d
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLenum, GLuint
+
+#include <optional>  // for optional
+#include <utility>   // for pair
+#include <vector>    // for vector
+
+namespace bb3d {
+
+// GL calls made through GlState in one frame, by kind.
+struct GlStateStats {
+  int draws;          // glDraw* and glMultiDraw*, as counted by the drawables
+  int programs;       // glUseProgram
+  int vertex_arrays;  // glBindVertexArray
+  int textures;       // glBindTexture, and glActiveTexture when switching units
+  int capabilities;   // glEnable and glDisable
+  int blend_funcs;    // glBlendFunc
+  int skipped;        // calls left out because they wouldn't have changed anything
+};
+
+// Cache of the GL state which the drawables set on every Draw: the program, the vertex array, the
+// textures, blending and smoothing. Calls which wouldn't change anything are skipped, so drawables
+// drawn one after another with the same state, such as the sorted submissions of a DrawList, only
+// pay for what differs between them. Drawables leave their state bound after drawing instead of
+// unbinding it.
+//
+// The cache only stays right if every such change goes through it. Code which changes any of this
+// state with plain GL calls, or deletes a bound program, vertex array or texture, has to call
+// Invalidate afterwards.
+class GlState {
+ public:
+  // The process-wide instance. It describes the context of the last Window created, which
+  // Invalidates it when its context is made current.
+  static GlState &Get();
+
+  void UseProgram(GLuint program);
+  void BindVertexArray(GLuint vertex_array);
+  // Bind `texture` to `target` of texture unit `unit` (0 for GL_TEXTURE0).
+  void BindTexture(GLuint unit, GLenum target, GLuint texture);
+  // glEnable or glDisable.
+  void SetEnabled(GLenum capability, bool enabled);
+  void BlendFunc(GLenum source_factor, GLenum destination_factor);
+  // Forget what is bound, so the next call of each kind is made.
+  void Invalidate();
+  // Count glDraw* calls made outside of GlState, for FrameStats.
+  void CountDraws(int draws) { stats_.draws += draws; }
+
+  // Start counting the next frame. The counts so far become FrameStats. Called by Window::Run, and
+  // by benchmarks which draw without it.
+  void EndFrame();
+  // Counts of the last frame.
+  [[nodiscard]] const GlStateStats &FrameStats() const { return frame_stats_; }
+
+ private:
+  struct TextureBinding {
+    GLuint unit;
+    GLenum target;
+    GLuint texture;
+  };
+
+  GlState() = default;
+
+  std::optional<GLuint> program_{};
+  std::optional<GLuint> vertex_array_{};
+  std::optional<GLuint> active_texture_unit_{};
+  std::vector<TextureBinding> textures_{};
+  std::vector<std::pair<GLenum, bool> > capabilities_{};
+  std::optional<std::pair<GLenum, GLenum> > blend_func_{};
+
+  GlStateStats stats_{0, 0, 0, 0, 0, 0, 0};
+  GlStateStats frame_stats_{0, 0, 0, 0, 0, 0, 0};
+};
+
+};  // namespace bb3d
@@ -0,0 +1,138 @@
+#include "bb3d/headless_context.hpp"
+
+#include <GL/glew.h>  // for glGenFramebuffers, glBindFramebuffer, glRenderbufferStorage
+
+// Keep eglplatform.h from pulling in Xlib, whose macros collide with everything.
+#define EGL_NO_X11
+#include <EGL/egl.h>     // for eglInitialize, eglCreateContext, eglMakeCurrent, EGLint
+#include <EGL/eglext.h>  // for EGL_PLATFORM_SURFACELESS_MESA, PFNEGLGETPLATFORMDISPLAYEXTPROC
+
+#include <cstdio>   // for fprintf, stderr
+#include <cstdlib>  // for EXIT_FAILURE
+#include <cstring>  // for strstr
+
+#include "bb3d/assert.hpp"  // for exit_thread_safe
+
+namespace bb3d {
+
+static bool HasExtension(EGLDisplay display, const char *extension) {
+  const char *extensions = eglQueryString(display, EGL_EXTENSIONS);
+  return extensions != nullptr && strstr(extensions, extension) != nullptr;
+}
+
+[[noreturn]] static void EglFailure(const char *what) {
+  fprintf(stderr, "Headless context: %s failed (EGL error 0x%x)\n", what, eglGetError());
+  exit_thread_safe(EXIT_FAILURE);
+}
+
+static EGLDisplay OpenDisplay() {
+  // Surfaceless needs no X server, Wayland compositor or DRM device, which is what we want on
+  // render farm and CI machines.
+  if (HasExtension(EGL_NO_DISPLAY, "EGL_MESA_platform_surfaceless")) {
+    const auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+        eglGetProcAddress("eglGetPlatformDisplayEXT"));
+    if (get_platform_display != nullptr) {
+      EGLDisplay display =
+          get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+      if (display != EGL_NO_DISPLAY && eglInitialize(display, nullptr, nullptr) == EGL_TRUE) {
+        return display;
+      }
+    }
+  }
+  EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  if (display == EGL_NO_DISPLAY || eglInitialize(display, nullptr, nullptr) != EGL_TRUE) {
+    EglFailure("eglInitialize");
+  }
+  return display;
+}
+
+HeadlessContext::HeadlessContext(const int width, const int height)
+    : width_(width), height_(height) {
+  EGLDisplay display = OpenDisplay();
+  display_ = display;
+  if (eglBindAPI(EGL_OPENGL_API) != EGL_TRUE) {
+    EglFailure("eglBindAPI(EGL_OPENGL_API)");
+  }
+
+  const bool surfaceless = HasExtension(display, "EGL_KHR_surfaceless_context");
+  const EGLint config_attributes[] = {EGL_SURFACE_TYPE, surfaceless ? 0 : EGL_PBUFFER_BIT,
+                                      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                      EGL_RED_SIZE, 8,
+                                      EGL_GREEN_SIZE, 8,
+                                      EGL_BLUE_SIZE, 8,
+                                      EGL_ALPHA_SIZE, 8,
+                                      EGL_NONE};
+  EGLConfig config = nullptr;
+  EGLint num_configs = 0;
+  if (eglChooseConfig(display, config_attributes, &config, 1, &num_configs) != EGL_TRUE ||
+      num_configs == 0) {
+    EglFailure("eglChooseConfig");
+  }
+
+  // Same version and profile as the GLFW window.
+  const EGLint context_attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 4,
+                                       EGL_CONTEXT_MINOR_VERSION, 0,
+                                       EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                                       EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+                                       EGL_NONE};
+  EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+  if (context == EGL_NO_CONTEXT) {
+    EglFailure("eglCreateContext");
+  }
+  context_ = context;
+
+  // Nothing is ever drawn to the surface, so without surfaceless support a 1x1 pbuffer will do.
+  EGLSurface surface = EGL_NO_SURFACE;
+  if (!surfaceless) {
+    const EGLint pbuffer_attributes[] = {EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE};
+    surface = eglCreatePbufferSurface(display, config, pbuffer_attributes);
+    if (surface == EGL_NO_SURFACE) {
+      EglFailure("eglCreatePbufferSurface");
+    }
+  }
+  surface_ = surface;
+
+  if (eglMakeCurrent(display, surface, surface, context) != EGL_TRUE) {
+    EglFailure("eglMakeCurrent");
+  }
+}
+
+void HeadlessContext::CreateFramebuffer() {
+  glGenRenderbuffers(1, &color_renderbuffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, color_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width_, height_);
+  glGenRenderbuffers(1, &depth_renderbuffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width_, height_);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                            color_renderbuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                            depth_renderbuffer_);
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "Headless context: framebuffer incomplete (0x%x)\n", status);
+    exit_thread_safe(EXIT_FAILURE);
+  }
+  glViewport(0, 0, width_, height_);
+}
+
+HeadlessContext::~HeadlessContext() {
+  if (framebuffer_ != 0) {
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(1, &framebuffer_);
+    glDeleteRenderbuffers(1, &color_renderbuffer_);
+    glDeleteRenderbuffers(1, &depth_renderbuffer_);
+  }
+  eglMakeCurrent(display_, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (surface_ != nullptr) {
+    eglDestroySurface(display_, surface_);
+  }
+  eglDestroyContext(display_, context_);
+  eglTerminate(display_);
+}
+
+};  // namespace bb3d
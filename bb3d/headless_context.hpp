@@ -0,0 +1,38 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLuint
+
+namespace bb3d {
+
+// An OpenGL 4.0 core context without a window or display, created through EGL, which renders into a
+// framebuffer object of a fixed size. It prefers Mesa's surfaceless platform and falls back to the
+// default display with a pbuffer surface, so it works on a GPU driver as well as on llvmpipe.
+//
+// The context is made current and the framebuffer bound for the lifetime of the object.
+class HeadlessContext {
+ public:
+  HeadlessContext(int width, int height);
+  ~HeadlessContext();
+  HeadlessContext(const HeadlessContext &) = delete;
+  HeadlessContext &operator=(const HeadlessContext &) = delete;
+
+  [[nodiscard]] int Width() const { return width_; }
+  [[nodiscard]] int Height() const { return height_; }
+  [[nodiscard]] GLuint Framebuffer() const { return framebuffer_; }
+
+  // Create the framebuffer. Separate from the constructor because it needs GL functions, which are
+  // only loaded once the context is current.
+  void CreateFramebuffer();
+
+ private:
+  int width_;
+  int height_;
+  void *display_ = nullptr;  // EGLDisplay
+  void *context_ = nullptr;  // EGLContext
+  void *surface_ = nullptr;  // EGLSurface, null when surfaceless
+  GLuint framebuffer_ = 0;
+  GLuint color_renderbuffer_ = 0;
+  GLuint depth_renderbuffer_ = 0;
+};
+
+};  // namespace bb3d
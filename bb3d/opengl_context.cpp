@@ -3,13 +3,15 @@
 #include <GL/glew.h>  // for glEnable, GL_TRUE, GL_DONT_CARE, glClear, glClea...
 
 #include <algorithm>  // for max
+#include <array>      // for array
 #include <chrono>     // for duration, duration_cast, operator-, high_resolut...
-#include <cstdio>     // for fprintf, stderr, sprintf
+#include <cstdio>     // for fprintf, stderr, sprintf, snprintf
 #include <cstdlib>    // for EXIT_FAILURE
 #include <iostream>
 #include <queue>   // for queue
-#include <string>  // for string
-#include <vector>  // for vector
+#include <string>   // for string
+#include <utility>  // for move
+#include <vector>   // for vector
 
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>  // for glfwWindowHint, glfwGetWindowUserPointer, glfwGe...
@@ -17,18 +19,27 @@
 #include <glm/glm.hpp>                   // for operator+, vec3, mat4, radians, vec4, vec<>::(an...
 #include <glm/gtc/matrix_transform.hpp>  // for lookAt, ortho, perspective
 
-#include "bb3d/assert.hpp"             // for exit_thread_safe
-#include "bb3d/camera.hpp"             // for Camera
-#include "bb3d/gl_error.hpp"           // for GlDebugOutput
-#include "bb3d/shader/colorlines.hpp"  // for ColoredVec3, ColorLines
-#include "bb3d/shader/freetype.hpp"    // for Freetype
+#include "bb3d/assert.hpp"                  // for exit_thread_safe
+#include "bb3d/camera.hpp"                  // for Camera
+#include "bb3d/gl_error.hpp"                // for GlDebugOutput
+#include "bb3d/gl_state.hpp"                // for GlState, GlStateStats
+#include "bb3d/profiler.hpp"                // for Profiler
+#include "bb3d/redraw.hpp"                  // for RequestRedraw, TakeRedrawRequest, RedrawRequested
+#include "bb3d/scene_snapshot.hpp"          // for SceneSnapshot, SceneSnapshots
+#include "bb3d/shader/camera_uniforms.hpp"  // for CameraUniforms
+#include "bb3d/shader/colorlines.hpp"       // for ColoredVec3, ColorLines
+#include "bb3d/shader/freetype.hpp"         // for Freetype
 #include "tools/cpp/runfiles/runfiles.h"
 
 namespace bb3d {
 static GLFWwindow *OpenglSetup(WindowState *window_state);
+static void InitializeGl(bool headless);
 
 std::string g_argv0;
 
+// How often Run polls for pick readbacks in flight while it has nothing to draw.
+static constexpr double kPickPollInterval = 0.002;
+
 std::string Window::GetBazelRlocation(const std::string &path) {
   using bazel::tools::cpp::runfiles::Runfiles;
 
@@ -38,13 +49,17 @@ std::string Window::GetBazelRlocation(const std::string &path) {
     bb3d::exit_thread_safe(EXIT_FAILURE);
   }
 
-  std::string error;
-  std::unique_ptr<Runfiles> bazel_runfiles(Runfiles::Create(g_argv0));
-  if (bazel_runfiles == nullptr) {
-    std::cerr << error << std::endl;
-    std::cerr << "Aborting because Runfiles not initialized." << std::endl;
-    bb3d::exit_thread_safe(EXIT_FAILURE);
-  }
+  // Creating Runfiles parses the runfiles manifest, so do it once rather than per lookup.
+  static const std::unique_ptr<Runfiles> bazel_runfiles = [] {
+    std::string error;
+    std::unique_ptr<Runfiles> runfiles(Runfiles::Create(g_argv0, &error));
+    if (runfiles == nullptr) {
+      std::cerr << error << std::endl;
+      std::cerr << "Aborting because Runfiles not initialized." << std::endl;
+      bb3d::exit_thread_safe(EXIT_FAILURE);
+    }
+    return runfiles;
+  }();
 
   std::string runfile_path = bazel_runfiles->Rlocation("bb3d/" + path);
   if (runfile_path.empty()) {
@@ -57,38 +72,128 @@ std::string Window::GetBazelRlocation(const std::string &path) {
 
 Window::Window(char *argv0)
   : window_state_(std::make_unique<bb3d::WindowState>(bb3d::WindowState())),
-    glfw_window(OpenglSetup(window_state_.get()), &glfwDestroyWindow) {
+    glfw_window(OpenglSetup(window_state_.get()), &glfwDestroyWindow),
+    headless_(nullptr) {
+  g_argv0 = argv0;
+};
+
+Window::Window(char *argv0, const HeadlessOptions &headless)
+  : window_state_(std::make_unique<bb3d::WindowState>(bb3d::WindowState())),
+    glfw_window(nullptr, &glfwDestroyWindow),
+    headless_(std::make_unique<HeadlessContext>(headless.width, headless.height)),
+    headless_num_frames_(headless.num_frames) {
   g_argv0 = argv0;
+  InitializeGl(true);
+  headless_->CreateFramebuffer();
 };
 
 Window::~Window() {
+  // needs the GL context
+  capture_.reset();
+  picker_.reset();
   glfwTerminate();
 };
 
 void Window::Close() {
+  if (headless_ != nullptr) {
+    headless_should_close_ = true;
+    return;
+  }
   glfwSetWindowShouldClose(glfw_window.get(), GLFW_TRUE);
 }
 
-bool Window::ShouldClose() { return glfwWindowShouldClose(glfw_window.get()) != 0; }
+bool Window::ShouldClose() {
+  if (headless_ != nullptr) {
+    return headless_should_close_ ||
+           (headless_num_frames_ > 0 && frame_count_ - run_first_frame_ >= headless_num_frames_);
+  }
+  return glfwWindowShouldClose(glfw_window.get()) != 0;
+}
 
-void Window::SwapBuffers() { glfwSwapBuffers(glfw_window.get()); }
+void Window::SwapBuffers() {
+  if (headless_ != nullptr) {
+    // Nothing to present, but flush so that frames don't pile up in the driver's command queue.
+    glFlush();
+  } else {
+    glfwSwapBuffers(glfw_window.get());
+  }
+  frame_count_++;
+}
 
 void Window::PollEvents() { glfwPollEvents(); }
 
 Window::Size Window::GetSize() const {
+  if (headless_ != nullptr) {
+    return {headless_->Width(), headless_->Height()};
+  }
   Window::Size window_size{};
   glfwGetWindowSize(glfw_window.get(), &window_size.width, &window_size.height);
   return window_size;
 }
 
+GLuint Window::Framebuffer() const { return headless_ != nullptr ? headless_->Framebuffer() : 0; }
+
+void Window::SetOnDemandRendering(const bool on_demand, const double idle_timeout) {
+  on_demand_ = on_demand;
+  idle_timeout_ = idle_timeout;
+}
+
+void Window::StartCapture(const CaptureOptions &options) {
+  capture_.reset();
+  std::array<GLint, 4> viewport{};
+  glGetIntegerv(GL_VIEWPORT, viewport.data());
+  capture_ = std::make_unique<FrameCapture>(options, viewport[2], viewport[3]);
+}
+
+void Window::StopCapture() { capture_.reset(); }
+
+CaptureStats Window::GetCaptureStats() const {
+  return capture_ != nullptr ? capture_->Stats() : CaptureStats{0, 0, 0};
+}
+
+void Window::SetPicking(std::function<void()> draw_ids,
+                        std::function<void(const PickResult &)> handle_pick,
+                        const bool pick_on_hover) {
+  if (picker_ == nullptr) {
+    picker_ = std::make_unique<Picker>();
+  }
+  draw_ids_ = std::move(draw_ids);
+  handle_pick_ = std::move(handle_pick);
+  pick_on_hover_ = pick_on_hover;
+}
+
+void Window::RequestPick(const double x, const double y) {
+  ASSERT(picker_ != nullptr);
+  picker_->Request(x, y);
+}
+
+void Window::Pick() {
+  if (picker_ == nullptr) {
+    return;
+  }
+  const Profiler::CpuScope cpu_scope("Pick");
+  picker_->Collect(handle_pick_);
+  MouseHandler &mouse_handler = window_state_->mouse_handler;
+  if (pick_on_hover_ && mouse_handler.cursor_moved && !window_state_->IsDraggingOrRotating()) {
+    picker_->Request(mouse_handler.cursor_xpos, mouse_handler.cursor_ypos);
+    mouse_handler.cursor_moved = false;
+  }
+  picker_->Render(Framebuffer(), draw_ids_);
+}
+
 const Camera &WindowState::GetCamera() const { return camera; }
 
 static void KeyCallback(GLFWwindow *glfw_window, int key, int scancode, int action,
                         int mods __attribute__((unused))) {
   WindowState &window_state =
       *reinterpret_cast<WindowState *>(glfwGetWindowUserPointer(glfw_window));
+  RequestRedraw();
   if (key == GLFW_KEY_ESCAPE && action == GLFW_PRESS) {
     glfwSetWindowShouldClose(glfw_window, GLFW_TRUE);
+  } else if (key == GLFW_KEY_F3 && action == GLFW_PRESS) {
+    Profiler &profiler = Profiler::Get();
+    profiler.SetEnabled(!profiler.Enabled());
+    profiler.Reset();
   } else if (action == GLFW_PRESS) {
     window_state.keypress_queue.push(key);
     fprintf(stderr, "Key press! %s (%d)\n", glfwGetKeyName(key, scancode), key);
@@ -97,11 +202,20 @@ static void KeyCallback(GLFWwindow *glfw_window, int key, int scancode, int acti
 
 static void WindowSizeCallback(GLFWwindow *window __attribute__((unused)), int width, int height) {
   glViewport(0, 0, width, height);
+  RequestRedraw();
 }
 
+static void WindowRefreshCallback(GLFWwindow *window __attribute__((unused))) { RequestRedraw(); }
+
 static void CursorPositionCallback(GLFWwindow *glfw_window, double xpos, double ypos) {
   WindowState &window_state =
       *reinterpret_cast<WindowState *>(glfwGetWindowUserPointer(glfw_window));
+  window_state.mouse_handler.cursor_xpos = xpos;
+  window_state.mouse_handler.cursor_ypos = ypos;
+  window_state.mouse_handler.cursor_moved = true;
+  if (window_state.IsDraggingOrRotating()) {
+    RequestRedraw();  // the camera is about to move
+  }
   if (window_state.mouse_handler.cursor_rotating) {
     window_state.camera.Rotate(
         static_cast<float>(xpos - window_state.mouse_handler.cursor_rotating_previous_xpos),
@@ -137,6 +251,7 @@ static void MouseButtonCallback(GLFWwindow *glfw_window, int button, int action,
       *reinterpret_cast<WindowState *>(glfwGetWindowUserPointer(glfw_window));
 
   // fprintf(stderr, "Mouse button pressed: %d %d\n", button, action);
+  RequestRedraw();
 
   if (button == GLFW_MOUSE_BUTTON_LEFT && action == GLFW_PRESS) {
     // emable drag state
@@ -209,6 +324,7 @@ static void ScrollCallback(GLFWwindow *glfw_window, double xoffset __attribute__
   WindowState &window_state =
       *reinterpret_cast<WindowState *>(glfwGetWindowUserPointer(glfw_window));
   window_state.camera.Scroll(static_cast<float>(yoffset));
+  RequestRedraw();
 }
 
 static void ErrorCallback(int error, const char *description) {
@@ -247,15 +363,35 @@ static GLFWwindow *OpenglSetup(WindowState *window_state) {
   glfwSetMouseButtonCallback(window, MouseButtonCallback);
   glfwSetScrollCallback(window, ScrollCallback);
   glfwSetWindowSizeCallback(window, WindowSizeCallback);
+  glfwSetWindowRefreshCallback(window, WindowRefreshCallback);
 
   // Create Context and Load OpenGL Functions
   glfwMakeContextCurrent(window);
+  InitializeGl(false);
+  glfwSwapInterval(1);
+
+  return window;
+}
 
+// Load GL functions and set the state every drawable expects, once a context is current.
+static void InitializeGl(const bool headless) {
   glewExperimental = GL_TRUE;
-  glewInit();
+  const GLenum glew_status = glewInit();
+  // A GLX build of GLEW loads the GL functions fine under EGL, then fails to find an X display for
+  // the GLX extensions, which we don't use.
+  if (headless && glew_status != GLEW_OK && glew_status != GLEW_ERROR_NO_GLX_DISPLAY) {
+    fprintf(stderr, "Failed to initialize GLEW: %s\n", glewGetErrorString(glew_status));
+    exit_thread_safe(EXIT_FAILURE);
+  }
   glEnable(GL_CULL_FACE);
   glEnable(GL_DEPTH_TEST);
   glEnable(GL_PROGRAM_POINT_SIZE);
+  glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+  // Nothing is bound in a new context, and the objects of the previous one are gone.
+  GlState::Get().Invalidate();
+  CameraUniforms::Get().ContextCreated();
+  Shader::ContextCreated();
+  Profiler::Get().ContextCreated();
 
   // Debugging
   glEnable(GL_DEBUG_OUTPUT);
@@ -264,9 +400,6 @@ static GLFWwindow *OpenglSetup(WindowState *window_state) {
   glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
 
   fprintf(stderr, "OpenGL %s\n", glGetString(GL_VERSION));
-  glfwSwapInterval(1);
-
-  return window;
 }
 
 glm::mat4 WindowState::GetViewTransformation() const {
@@ -287,7 +420,6 @@ glm::mat4 Window::GetProjectionTransformation() const {
 glm::mat4 Window::GetOrthographicProjection() const {
   // projection transformation
   Window::Size window_size = GetSize();
-  glfwGetWindowSize(glfw_window.get(), &window_size.width, &window_size.height);
   window_size.width = std::max(window_size.width, 1);
   window_size.height = std::max(window_size.height, 1);
   return glm::ortho(0.0F, static_cast<float>(window_size.width), 0.0F,
@@ -338,13 +470,43 @@ void Window::Run(
 
   std::chrono::time_point t_last = std::chrono::high_resolution_clock::now();
 
+  Profiler &profiler = Profiler::Get();
+  const bool on_demand = on_demand_ && headless_ == nullptr;
+  SetRedrawWakesEventLoop(on_demand);
+
+  // Headless frames are counted per Run, and a Close ended the previous Run only.
+  run_first_frame_ = frame_count_;
+  headless_should_close_ = false;
+
   while (!ShouldClose()) {
+    if (on_demand) {
+      // Sleep until there is input or a redraw request, or the idle timeout passes.
+      const Profiler::CpuScope cpu_scope("WaitEvents");
+      if (RedrawRequested()) {
+        bb3d::Window::PollEvents();
+      } else if (picker_ != nullptr && picker_->Pending()) {
+        glfwWaitEventsTimeout(kPickPollInterval);
+      } else {
+        glfwWaitEventsTimeout(idle_timeout_);
+      }
+    }
+
+    profiler.BeginFrame();
+
     // Send keypress events to visualization to update state.
     while (!window_state_->KeypressQueueEmpty()) {
       handle_keypress(window_state_->PopKeypressQueue());
     }
 
-    update_visualization();
+    {
+      const Profiler::CpuScope cpu_scope("update_visualization");
+      update_visualization();
+    }
+    if (on_demand && !TakeRedrawRequest()) {
+      // Picks go to their own framebuffer, so they don't need the frame redrawn.
+      Pick();
+      continue;
+    }
 
     std::chrono::time_point t_now = std::chrono::high_resolution_clock::now();
     float frame_time =
@@ -362,26 +524,89 @@ void Window::Run(
     // projection transformation
     glm::mat4 proj = GetProjectionTransformation();
 
-    draw_visualization(view, proj);
+    // Shared by every drawable's shader through the Camera uniform block.
+    const bb3d::Window::Size window_size = GetSize();
+    CameraUniforms::Get().Update(
+        view, proj,
+        glm::vec2(static_cast<float>(window_size.width), static_cast<float>(window_size.height)),
+        frame_time);
+
+    // Opaque drawables first, so that transparent ones blend over everything they are in front of.
+    draw_list_.Draw(DrawPass::kOpaque);
+    {
+      const Profiler::CpuScope cpu_scope("draw_visualization");
+      const Profiler::GpuScope gpu_scope("draw_visualization");
+      draw_visualization(view, proj);
+    }
+    draw_list_.Draw(DrawPass::kTransparent);
+    Pick();
 
     // draw axes if we're dragging or rotating
     if (window_state_->IsDraggingOrRotating()) {
       axes.Update(bb3d::AxesLines(window_state_->GetCamera()));
-      axes.Draw(view, proj, GL_LINE_STRIP);
+      axes.Draw(GL_LINE_STRIP);
     }
 
     // Draw some dummy text.
     std::string fps_string(80, '\0');
-    sprintf(fps_string.data(), "%.1f fps", 1 / frame_time);
-    const bb3d::Window::Size window_size = GetSize();
+    if (on_demand) {
+      sprintf(fps_string.data(), "on demand, frame %d", frame_count_);
+    } else {
+      sprintf(fps_string.data(), "%.1f fps", 1 / frame_time);
+    }
+
+    const float line_height = 22.0F;
+    float text_y = static_cast<float>(window_size.height) - 25.0F;
+    textbox.AddText(fps_string, 25.0F, text_y, glm::vec3(1, 1, 1));
+    if (profiler.Enabled()) {
+      for (const std::string &line : profiler.Report()) {
+        text_y -= line_height;
+        textbox.AddText(line, 25.0F, text_y, glm::vec3(1, 1, 0.6F));
+      }
+      // of the last frame, the overlay's own included
+      const GlStateStats &gl_stats = GlState::Get().FrameStats();
+      std::string gl_stats_string(128, '\0');
+      snprintf(gl_stats_string.data(), gl_stats_string.size(),
+               "%d draws, state changes: %d prog %d vao %d tex %d cap %d blend, %d skipped",
+               gl_stats.draws, gl_stats.programs, gl_stats.vertex_arrays, gl_stats.textures,
+               gl_stats.capabilities, gl_stats.blend_funcs, gl_stats.skipped);
+      text_y -= line_height;
+      textbox.AddText(gl_stats_string, 25.0F, text_y, glm::vec3(1, 1, 0.6F));
+    }
+    textbox.Flush(GetOrthographicProjection());
 
-    textbox.RenderText(GetOrthographicProjection(), fps_string, 25.0F,
-                       static_cast<float>(window_size.height) - 25.0F, glm::vec3(1, 1, 1));
+    if (capture_ != nullptr) {
+      const Profiler::CpuScope cpu_scope("FrameCapture");
+      capture_->CaptureFrame(Framebuffer());
+    }
 
     // Swap buffers and poll events
-    SwapBuffers();
-    bb3d::Window::PollEvents();
+    GlState::Get().EndFrame();
+    {
+      const Profiler::CpuScope cpu_scope("SwapBuffers");
+      SwapBuffers();
+    }
+    if (headless_ == nullptr && !on_demand) {
+      const Profiler::CpuScope cpu_scope("PollEvents");
+      bb3d::Window::PollEvents();
+    }
   }
+  SetRedrawWakesEventLoop(false);
+}
+
+void Window::Run(
+    std::function<void(key_t key)> &handle_keypress, SceneSnapshots &snapshots,
+    std::function<void(int producer, const SceneSnapshot &snapshot)> &update_visualization,
+    std::function<void(const glm::mat4 &view, const glm::mat4 &proj)> &draw_visualization) {
+  std::function<void()> consume_snapshots = [&snapshots, &update_visualization]() {
+    for (int producer = 0; producer < snapshots.NumProducers(); producer++) {
+      TripleBuffer<SceneSnapshot> &buffer = snapshots.Producer(producer);
+      if (buffer.Consume()) {
+        update_visualization(producer, buffer.Front());
+      }
+    }
+  };
+  Run(handle_keypress, consume_snapshots, draw_visualization);
 }
 
 };  //  namespace bb3d
@@ -9,7 +9,12 @@
 #include <memory>       // for unique_ptr
 #include <queue>        // for queue
 
-#include "bb3d/camera.hpp"  // for Camera
+#include "bb3d/camera.hpp"            // for Camera
+#include "bb3d/draw_list.hpp"         // for DrawList
+#include "bb3d/frame_capture.hpp"     // for FrameCapture, CaptureOptions, CaptureStats
+#include "bb3d/headless_context.hpp"  // for HeadlessContext
+#include "bb3d/picker.hpp"            // for Picker, PickResult
+#include "bb3d/scene_snapshot.hpp"    // for SceneSnapshot, SceneSnapshots
 #include "bb3d/shader/freetype.hpp"
 
 namespace bb3d {
@@ -24,6 +29,10 @@ struct MouseHandler {
   bool cursor_z_translating;
   double cursor_z_translating_previous_xpos;
   double cursor_z_translating_previous_ypos;
+  // last cursor position, for picking on hover
+  double cursor_xpos;
+  double cursor_ypos;
+  bool cursor_moved;  // since the last hover pick
 };
 
 // The state which is stored by glfwSetWindowUserPointer.
@@ -41,9 +50,21 @@ class WindowState {
   MouseHandler mouse_handler{};
 };
 
+// Settings for a Window without a display, e.g. for batch jobs and automated performance tests.
+struct HeadlessOptions {
+  int width = 1344;
+  int height = 756;
+  // Each Run returns after this many frames. With 0 it runs until Close is called.
+  int num_frames = 1;
+};
+
 class Window {
  public:
   explicit Window(char *argv0);
+  // Render offscreen into a framebuffer object through an EGL context instead of opening a window.
+  // Needs no display or GPU (Mesa's llvmpipe works). Run and the drawables behave the same, except
+  // that there is no input, so the keypress handler is never called.
+  Window(char *argv0, const HeadlessOptions &headless);
   ~Window();
   struct Size {
     int width;
@@ -61,9 +82,47 @@ class Window {
   void SwapBuffers();
   static void PollEvents();
   std::unique_ptr<WindowState> &GetWindowState() { return window_state_; };
+  [[nodiscard]] bool IsHeadless() const { return headless_ != nullptr; }
+  // The framebuffer rendered into, 0 for the default framebuffer of a window.
+  [[nodiscard]] GLuint Framebuffer() const;
+  // Frames completed by SwapBuffers so far.
+  [[nodiscard]] int FrameCount() const { return frame_count_; }
+  // With on-demand rendering, Run only draws a frame when something changed: input, a resize or
+  // expose of the window, or RequestRedraw (see redraw.hpp), which the drawables call from their
+  // Update methods. So update_visualization should only Update drawables when their data changed.
+  // Between frames Run sleeps in glfwWaitEventsTimeout, waking up at least every idle_timeout
+  // seconds to call update_visualization, so that data it polls is still picked up. Has no effect
+  // in headless mode.
+  void SetOnDemandRendering(bool on_demand, double idle_timeout = 0.5);
+  // Record every frame Run draws from now on, at the current viewport size, see FrameCapture.
+  // Replaces a capture which is already running.
+  void StartCapture(const CaptureOptions &options);
+  // Finish writing the frames captured so far.
+  void StopCapture();
+  [[nodiscard]] CaptureStats GetCaptureStats() const;
+  // Tell Run what is under the cursor, see Picker. draw_ids is called with the camera narrowed to
+  // a few pixels around the pick and an ID framebuffer bound, and should call DrawIds of each
+  // drawable which can be picked with its own nonzero object ID. handle_pick gets the result a
+  // frame or two later. Picks are drawn apart from the frame, so with on-demand rendering they
+  // don't redraw it. With pick_on_hover a pick is requested whenever the cursor moves (except
+  // while dragging the camera), otherwise only by RequestPick.
+  void SetPicking(std::function<void()> draw_ids,
+                  std::function<void(const PickResult &)> handle_pick, bool pick_on_hover = true);
+  // Pick at (x, y), in window coordinates from the top left like the cursor position. Needs
+  // SetPicking first.
+  void RequestPick(double x, double y);
+  // Drawables drawn by Run every frame, sorted by state: the opaque ones before draw_visualization,
+  // the transparent ones after it. Add returns a handle for Remove.
+  DrawList &GetDrawList() { return draw_list_; }
   void Run(std::function<void(key_t key)> &handle_keypress,
            std::function<void()> &update_visualization,
            std::function<void(const glm::mat4 &view, const glm::mat4 &proj)> &draw_visualization);
+  // Same as above, but the scene is produced on other threads. Each frame, update_visualization is
+  // called once for every producer which published a new snapshot since the previous frame. The
+  // render loop never waits on a producer.
+  void Run(std::function<void(key_t key)> &handle_keypress, SceneSnapshots &snapshots,
+           std::function<void(int producer, const SceneSnapshot &snapshot)> &update_visualization,
+           std::function<void(const glm::mat4 &view, const glm::mat4 &proj)> &draw_visualization);
   void SetCameraFocus(glm::vec3 new_focus){window_state_->camera.SetFocus(new_focus);};
   void SetCameraAzimuthDeg(float azimuth_deg){window_state_->camera.SetAzimuthDeg(azimuth_deg);};
   void SetCameraElevationDeg(float elevation_deg){window_state_->camera.SetElevationDeg(elevation_deg);};
@@ -71,9 +130,25 @@ class Window {
 
  private:
   bool ShouldClose();
+  // Hand finished picks to handle_pick_ and draw the requested one.
+  void Pick();
   std::unique_ptr<WindowState> window_state_;
   using unique_window_t = std::unique_ptr<GLFWwindow, decltype(&glfwDestroyWindow)>;
   unique_window_t glfw_window;
+  // Only in headless mode, in which case glfw_window is null.
+  std::unique_ptr<HeadlessContext> headless_;
+  int headless_num_frames_ = 0;
+  bool headless_should_close_ = false;
+  int frame_count_ = 0;
+  int run_first_frame_ = 0;  // frame_count_ when Run started
+  bool on_demand_ = false;
+  double idle_timeout_ = 0.5;
+  std::unique_ptr<FrameCapture> capture_{};
+  std::unique_ptr<Picker> picker_{};
+  std::function<void()> draw_ids_{};
+  std::function<void(const PickResult &)> handle_pick_{};
+  bool pick_on_hover_ = false;
+  DrawList draw_list_{};
 };
 
 };  // namespace bb3d
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <algorithm>  // for min, max
+#include <cstddef>    // for size_t
+#include <thread>     // for thread
+#include <vector>     // for vector
+
+namespace bb3d {
+
+// Number of threads ParallelFor uses by default: one per core.
+inline int DefaultNumThreads() {
+  return std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+}
+
+// Split [0, size) into at most num_threads contiguous ranges of at least min_range items and call
+// f(part, begin, end) for each on its own thread, parts numbered in order from 0. The calling
+// thread runs part 0 and returns once all parts are done. Returns the number of parts.
+template <typename F>
+int ParallelFor(const size_t size, const size_t min_range, const int num_threads, F f) {
+  const auto max_parts =
+      static_cast<int>(std::max<size_t>(1, size / std::max<size_t>(1, min_range)));
+  const int num_parts = std::max(1, std::min(num_threads, max_parts));
+  const auto range = [size, num_parts](int part) {
+    return size * static_cast<size_t>(part) / static_cast<size_t>(num_parts);
+  };
+  std::vector<std::thread> threads;
+  threads.reserve(static_cast<size_t>(num_parts - 1));
+  for (int part = 1; part < num_parts; part++) {
+    threads.emplace_back([&f, &range, part]() { f(part, range(part), range(part + 1)); });
+  }
+  f(0, range(0), range(1));
+  for (std::thread &thread : threads) {
+    thread.join();
+  }
+  return num_parts;
+}
+
+};  // namespace bb3d
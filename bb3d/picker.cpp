@@ -0,0 +1,227 @@
+#include "bb3d/picker.hpp"
+
+#include <GL/glew.h>  // for glReadPixels, glFenceSync, glClientWaitSync, glMapBufferRange
+
+#include <algorithm>    // for clamp, min
+#include <array>        // for array
+#include <cmath>        // for floor
+#include <cstdint>      // for uint32_t
+#include <cstdio>       // for fprintf, stderr
+#include <cstdlib>      // for EXIT_FAILURE
+#include <glm/glm.hpp>  // for mat4, vec2
+#include <limits>       // for numeric_limits
+
+#include "bb3d/assert.hpp"                  // for ASSERT, exit_thread_safe
+#include "bb3d/gl_state.hpp"                // for GlState
+#include "bb3d/profiler.hpp"                // for Profiler
+#include "bb3d/shader/camera_uniforms.hpp"  // for CameraUniforms, CameraBlock
+
+namespace bb3d {
+
+Picker::Picker(const int radius) : radius_(radius), size_(2 * radius + 1) {
+  ASSERT(radius_ >= 0);
+
+  glGenRenderbuffers(1, &id_renderbuffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, id_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RG32UI, size_, size_);
+  glGenRenderbuffers(1, &depth_renderbuffer_);
+  glBindRenderbuffer(GL_RENDERBUFFER, depth_renderbuffer_);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size_, size_);
+  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+  GLint previous_framebuffer = 0;
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+  glGenFramebuffers(1, &framebuffer_);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER,
+                            id_renderbuffer_);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER,
+                            depth_renderbuffer_);
+  const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  if (status != GL_FRAMEBUFFER_COMPLETE) {
+    fprintf(stderr, "Picker: framebuffer incomplete (0x%x)\n", status);
+    exit_thread_safe(EXIT_FAILURE);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, static_cast<GLuint>(previous_framebuffer));
+
+  // (object ID, primitive ID) per pixel
+  const auto region_bytes = static_cast<GLsizeiptr>(2 * sizeof(uint32_t)) * size_ * size_;
+  for (Readback &readback : readbacks_) {
+    glGenBuffers(1, &readback.pixel_buffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.pixel_buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, region_bytes, nullptr, GL_STREAM_READ);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+Picker::~Picker() {
+  // Picks still in flight are dropped.
+  for (Readback &readback : readbacks_) {
+    if (readback.fence != nullptr) {
+      glDeleteSync(readback.fence);
+    }
+    glDeleteBuffers(1, &readback.pixel_buffer);
+  }
+  glDeleteFramebuffers(1, &framebuffer_);
+  glDeleteRenderbuffers(1, &id_renderbuffer_);
+  glDeleteRenderbuffers(1, &depth_renderbuffer_);
+}
+
+void Picker::Request(const double x, const double y) {
+  requested_ = true;
+  request_x_ = x;
+  request_y_ = y;
+}
+
+bool Picker::Pending() const {
+  if (requested_) {
+    return true;
+  }
+  for (const Readback &readback : readbacks_) {
+    if (readback.fence != nullptr) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void Picker::Render(const GLuint framebuffer, const std::function<void()> &draw_ids) {
+  if (!requested_) {
+    return;
+  }
+  Readback *free_readback = nullptr;
+  for (Readback &readback : readbacks_) {
+    if (readback.fence == nullptr) {
+      free_readback = &readback;
+      break;
+    }
+  }
+  if (free_readback == nullptr) {
+    return;
+  }
+  const Profiler::GpuScope gpu_scope("Picker::Render");
+  requested_ = false;
+
+  std::array<GLint, 4> viewport{};
+  glGetIntegerv(GL_VIEWPORT, viewport.data());
+  const int viewport_width = viewport[2];
+  const int viewport_height = viewport[3];
+  if (viewport_width <= 0 || viewport_height <= 0) {
+    return;
+  }
+  // The cursor's pixel, from the bottom left like GL window coordinates, and the region around it,
+  // moved inside the viewport near its edges.
+  const int cursor_x = std::clamp(static_cast<int>(std::floor(request_x_)), 0, viewport_width - 1);
+  const int cursor_y =
+      std::clamp(viewport_height - 1 - static_cast<int>(std::floor(request_y_)), 0,
+                 viewport_height - 1);
+  const int width = std::min(size_, viewport_width);
+  const int height = std::min(size_, viewport_height);
+  const int x0 = std::clamp(cursor_x - radius_, 0, viewport_width - width);
+  const int y0 = std::clamp(cursor_y - radius_, 0, viewport_height - height);
+
+  // Scale and shift clip space so that the region fills the ID framebuffer. Pixels keep their size
+  // on screen, and viewport_size shrinks to match, so whatever is sized in pixels (points, levels
+  // of detail) comes out the same as in the frame.
+  const CameraBlock camera = CameraUniforms::Get().Block();
+  const glm::vec2 viewport_size(static_cast<float>(viewport_width),
+                                static_cast<float>(viewport_height));
+  const glm::vec2 region_size(static_cast<float>(width), static_cast<float>(height));
+  const glm::vec2 region_min(static_cast<float>(x0), static_cast<float>(y0));
+  // in normalized device coordinates
+  const glm::vec2 center = (2.0F * region_min + region_size) / viewport_size - glm::vec2(1.0F);
+  const float scale_x = viewport_size.x / region_size.x;
+  const float scale_y = viewport_size.y / region_size.y;
+  glm::mat4 narrow(1.0F);
+  narrow[0][0] = scale_x;
+  narrow[1][1] = scale_y;
+  narrow[3][0] = -scale_x * center.x;
+  narrow[3][1] = -scale_y * center.y;
+  CameraUniforms::Get().Update(camera.view, narrow * camera.proj, region_size, camera.frame_time);
+
+  // IDs must not be blended or antialiased. Every Draw sets blending and smoothing again, so they
+  // are not restored. Whole lines are picked by their first vertex.
+  GLint provoking_vertex = GL_LAST_VERTEX_CONVENTION;
+  glGetIntegerv(GL_PROVOKING_VERTEX, &provoking_vertex);
+  GlState::Get().SetEnabled(GL_BLEND, false);
+  GlState::Get().SetEnabled(GL_LINE_SMOOTH, false);
+  GlState::Get().SetEnabled(GL_POLYGON_SMOOTH, false);
+  glProvokingVertex(GL_FIRST_VERTEX_CONVENTION);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer_);
+  glViewport(0, 0, width, height);
+  // Object ID 0 is nothing.
+  const std::array<GLuint, 4> nothing = {0, 0, 0, 0};
+  glClearBufferuiv(GL_COLOR, 0, nothing.data());
+  glClear(GL_DEPTH_BUFFER_BIT);
+  draw_ids();
+
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, free_readback->pixel_buffer);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  // Into the pixel buffer, so this only queues the copy.
+  glReadPixels(0, 0, width, height, GL_RG_INTEGER, GL_UNSIGNED_INT, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  free_readback->fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  free_readback->sequence = next_sequence_++;
+  free_readback->x = request_x_;
+  free_readback->y = request_y_;
+  free_readback->width = width;
+  free_readback->height = height;
+  free_readback->cursor_col = cursor_x - x0;
+  free_readback->cursor_row = cursor_y - y0;
+
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  glProvokingVertex(static_cast<GLenum>(provoking_vertex));
+  CameraUniforms::Get().Update(camera.view, camera.proj, camera.viewport_size, camera.frame_time);
+}
+
+void Picker::Collect(const std::function<void(const PickResult &)> &handle_pick) {
+  // Oldest first. Fences signal in order too, so once one isn't done the newer ones aren't either.
+  while (true) {
+    Readback *oldest = nullptr;
+    for (Readback &readback : readbacks_) {
+      if (readback.fence != nullptr &&
+          (oldest == nullptr || readback.sequence < oldest->sequence)) {
+        oldest = &readback;
+      }
+    }
+    if (oldest == nullptr ||
+        glClientWaitSync(oldest->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
+    glDeleteSync(oldest->fence);
+    oldest->fence = nullptr;
+
+    const auto region_bytes = static_cast<GLsizeiptr>(2 * sizeof(uint32_t)) * oldest->width *
+                              oldest->height;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, oldest->pixel_buffer);
+    const auto *ids = static_cast<const uint32_t *>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, region_bytes, GL_MAP_READ_BIT));
+    const PickResult result = FindNearest(*oldest, ids);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    handle_pick(result);
+  }
+}
+
+PickResult Picker::FindNearest(const Readback &readback, const uint32_t *ids) const {
+  PickResult result{false, 0, 0, readback.x, readback.y};
+  int nearest = std::numeric_limits<int>::max();
+  for (int row = 0; row < readback.height; row++) {
+    for (int col = 0; col < readback.width; col++) {
+      const uint32_t *pixel = ids + 2 * (row * readback.width + col);
+      const int drow = row - readback.cursor_row;
+      const int dcol = col - readback.cursor_col;
+      const int distance = drow * drow + dcol * dcol;
+      if (pixel[0] != 0 && distance < nearest && distance <= radius_ * radius_) {
+        nearest = distance;
+        result = {true, pixel[0], pixel[1], readback.x, readback.y};
+      }
+    }
+  }
+  return result;
+}
+
+};  // namespace bb3d
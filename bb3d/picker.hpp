@@ -0,0 +1,92 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLuint, GLsync
+
+#include <array>       // for array
+#include <cstdint>     // for uint32_t
+#include <functional>  // for function
+
+namespace bb3d {
+
+struct PickResult {
+  bool hit;               // false if nothing was drawn within the pick radius
+  uint32_t object_id;     // as given to DrawIds, 0 if nothing was hit
+  uint32_t primitive_id;  // for DecodePick of the drawable which drew object_id
+  double x;               // where the pick was requested, in window coordinates
+  double y;
+};
+
+// Cell (row, col) of a Gridmesh or Cubemesh hit by a pick, as indexed in the grid given to Update.
+struct PickedCell {
+  int row;
+  int col;
+};
+
+// Vertex `vertex` of segment `segment` of a ColorLines hit by a pick. For lines and line strips
+// this is the first vertex of the line which was hit.
+struct PickedVertex {
+  int segment;
+  int vertex;
+};
+
+// Answers "what is under the cursor" without stalling the frame. The drawables which can be
+// picked draw an object ID and a primitive ID per pixel into an RG32UI framebuffer (their DrawIds
+// methods), with the projection narrowed to the few pixels around the cursor, so frustum culling
+// skips nearly everything else. That region is read back into one of a ring of pixel buffer
+// objects and only mapped once its fence has signaled, a frame or two later, like FrameCapture.
+// The result is the hit nearest to the cursor within `radius` pixels, so thin lines and points
+// can be picked without hitting them exactly.
+class Picker {
+ public:
+  explicit Picker(int radius = 4);
+  ~Picker();
+  Picker(const Picker &) = delete;
+  Picker &operator=(const Picker &) = delete;
+
+  // Pick at (x, y), in window coordinates (pixels from the top left, like the cursor position),
+  // with the next Render. A newer request replaces one which wasn't rendered yet.
+  void Request(double x, double y);
+  // If a pick was requested, call draw_ids with the camera uniforms narrowed to the region around
+  // it and the ID framebuffer bound, start reading the region back, then bind `framebuffer` again
+  // and restore the camera uniforms. The viewport has to cover the window. While all readbacks
+  // are in flight the request waits for the next Render.
+  void Render(GLuint framebuffer, const std::function<void()> &draw_ids);
+  // Call handle_pick with the results of the readbacks which are done, oldest first, without
+  // waiting for the others.
+  void Collect(const std::function<void(const PickResult &)> &handle_pick);
+  // A pick is requested or being read back.
+  [[nodiscard]] bool Pending() const;
+
+ private:
+  static constexpr int kNumPixelBuffers = 3;
+
+  struct Readback {
+    GLuint pixel_buffer = 0;
+    GLsync fence = nullptr;
+    int sequence = 0;
+    double x = 0;  // of the request
+    double y = 0;
+    // region read back and the cursor's pixel in it, from the bottom left
+    int width = 0;
+    int height = 0;
+    int cursor_col = 0;
+    int cursor_row = 0;
+  };
+
+  // The hit nearest to the cursor in a mapped readback.
+  [[nodiscard]] PickResult FindNearest(const Readback &readback, const uint32_t *ids) const;
+
+  int radius_;
+  int size_;  // of the ID framebuffer, 2 * radius + 1 pixels square
+  GLuint framebuffer_{};
+  GLuint id_renderbuffer_{};
+  GLuint depth_renderbuffer_{};
+  std::array<Readback, kNumPixelBuffers> readbacks_{};
+  int next_sequence_ = 0;
+
+  bool requested_ = false;
+  double request_x_ = 0;
+  double request_y_ = 0;
+};
+
+};  // namespace bb3d
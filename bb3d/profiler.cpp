@@ -0,0 +1,171 @@
+#include "bb3d/profiler.hpp"
+
+#include <GL/glew.h>  // for glQueryCounter, glGetQueryObjectui64v, GL_TIMESTAMP
+
+#include <algorithm>  // for min, nth_element, sort
+#include <chrono>     // for duration, steady_clock
+#include <cmath>      // for ceil
+#include <cstddef>    // for size_t, ptrdiff_t
+#include <cstdio>     // for snprintf
+
+namespace bb3d {
+
+Profiler &Profiler::Get() {
+  // Never destroyed: the GL context is gone by the time static destructors run.
+  static Profiler *instance = new Profiler();
+  return *instance;
+}
+
+void Profiler::BeginFrame() {
+  frame_ = (frame_ + 1) % kFramesInFlight;
+
+  // These queries were issued kFramesInFlight frames ago, so their results are normally available.
+  // Timestamps complete in order, so if the last one is, all of them are. If the GPU is even
+  // further behind, the frame's samples are dropped rather than waiting for them.
+  std::vector<PendingQuery> &pending = pending_[static_cast<size_t>(frame_)];
+  GLint available = GL_TRUE;
+  if (!pending.empty()) {
+    glGetQueryObjectiv(pending.back().end_query, GL_QUERY_RESULT_AVAILABLE, &available);
+  }
+  for (const PendingQuery &query : pending) {
+    if (available == GL_TRUE) {
+      GLuint64 begin_ns = 0;
+      GLuint64 end_ns = 0;
+      glGetQueryObjectui64v(query.begin_query, GL_QUERY_RESULT, &begin_ns);
+      glGetQueryObjectui64v(query.end_query, GL_QUERY_RESULT, &end_ns);
+      gpu_timers_[query.name].AddSample(1e-6 * static_cast<double>(end_ns - begin_ns));
+    }
+    free_queries_.push_back(query.begin_query);
+    free_queries_.push_back(query.end_query);
+  }
+  pending.clear();
+}
+
+void Profiler::Reset() {
+  cpu_timers_.clear();
+  gpu_timers_.clear();
+}
+
+void Profiler::ContextCreated() {
+  for (std::vector<PendingQuery> &pending : pending_) {
+    pending.clear();
+  }
+  free_queries_.clear();
+}
+
+GLuint Profiler::AcquireQuery() {
+  if (free_queries_.empty()) {
+    GLuint query = 0;
+    glGenQueries(1, &query);
+    return query;
+  }
+  const GLuint query = free_queries_.back();
+  free_queries_.pop_back();
+  return query;
+}
+
+std::vector<std::string> Profiler::Names(const std::unordered_map<std::string, Timer> &timers) {
+  std::vector<std::string> names;
+  names.reserve(timers.size());
+  for (const auto &timer : timers) {
+    names.push_back(timer.first);
+  }
+  std::sort(names.begin(), names.end());
+  return names;
+}
+
+TimerStats Profiler::Stats(const std::unordered_map<std::string, Timer> &timers,
+                           const std::string &name) {
+  const auto timer = timers.find(name);
+  if (timer == timers.end()) {
+    return TimerStats{0, 0, 0, 0};
+  }
+  return timer->second.Stats();
+}
+
+std::vector<std::string> Profiler::CpuTimers() const { return Names(cpu_timers_); }
+std::vector<std::string> Profiler::GpuTimers() const { return Names(gpu_timers_); }
+TimerStats Profiler::CpuStats(const std::string &name) const { return Stats(cpu_timers_, name); }
+TimerStats Profiler::GpuStats(const std::string &name) const { return Stats(gpu_timers_, name); }
+
+std::vector<std::string> Profiler::Report() const {
+  std::vector<std::string> lines;
+  lines.emplace_back("         min    mean     p99 ms");
+  std::string line(160, '\0');
+  const auto append = [&lines, &line](const char *clock, const std::string &name,
+                                      const TimerStats &stats) {
+    const int length = snprintf(line.data(), line.size(), "%s %7.2f %7.2f %7.2f  %s", clock,
+                                stats.min_ms, stats.mean_ms, stats.p99_ms, name.c_str());
+    lines.emplace_back(line.data(), static_cast<size_t>(std::min(length, 159)));
+  };
+  for (const std::string &name : CpuTimers()) {
+    append("cpu", name, CpuStats(name));
+  }
+  for (const std::string &name : GpuTimers()) {
+    append("gpu", name, GpuStats(name));
+  }
+  return lines;
+}
+
+void Profiler::Timer::AddSample(const double ms) {
+  if (samples_.size() < static_cast<size_t>(kWindowSize)) {
+    samples_.push_back(ms);
+    return;
+  }
+  samples_[next_] = ms;
+  next_ = (next_ + 1) % samples_.size();
+}
+
+TimerStats Profiler::Timer::Stats() const {
+  if (samples_.empty()) {
+    return TimerStats{0, 0, 0, 0};
+  }
+  std::vector<double> sorted = samples_;
+  const auto p99_index =
+      static_cast<size_t>(std::ceil(0.99 * static_cast<double>(sorted.size()))) - 1;
+  std::nth_element(sorted.begin(), sorted.begin() + static_cast<std::ptrdiff_t>(p99_index),
+                   sorted.end());
+  double min = samples_[0];
+  double sum = 0;
+  for (const double sample : samples_) {
+    min = std::min(min, sample);
+    sum += sample;
+  }
+  return TimerStats{min, sum / static_cast<double>(samples_.size()), sorted[p99_index],
+                    static_cast<int>(samples_.size())};
+}
+
+Profiler::CpuScope::CpuScope(const char *name)
+    : name_(name), active_(Profiler::Get().Enabled()), start_() {
+  if (active_) {
+    start_ = std::chrono::steady_clock::now();
+  }
+}
+
+Profiler::CpuScope::~CpuScope() {
+  if (active_) {
+    const std::chrono::duration<double, std::milli> elapsed =
+        std::chrono::steady_clock::now() - start_;
+    Profiler::Get().cpu_timers_[name_].AddSample(elapsed.count());
+  }
+}
+
+Profiler::GpuScope::GpuScope(const char *name) : name_(name) {
+  Profiler &profiler = Profiler::Get();
+  if (profiler.Enabled()) {
+    begin_query_ = profiler.AcquireQuery();
+    glQueryCounter(begin_query_, GL_TIMESTAMP);
+  }
+}
+
+Profiler::GpuScope::~GpuScope() {
+  if (begin_query_ != 0) {
+    Profiler &profiler = Profiler::Get();
+    const GLuint end_query = profiler.AcquireQuery();
+    glQueryCounter(end_query, GL_TIMESTAMP);
+    profiler.pending_[static_cast<size_t>(profiler.frame_)].push_back(
+        {name_, begin_query_, end_query});
+  }
+}
+
+};  // namespace bb3d
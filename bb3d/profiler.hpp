@@ -0,0 +1,121 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLuint
+
+#include <array>          // for array
+#include <chrono>         // for steady_clock
+#include <cstddef>        // for size_t
+#include <string>         // for string
+#include <unordered_map>  // for unordered_map
+#include <vector>         // for vector
+
+namespace bb3d {
+
+// Rolling statistics over the most recent samples of one timer.
+struct TimerStats {
+  double min_ms;
+  double mean_ms;
+  double p99_ms;
+  int num_samples;
+};
+
+// Per-frame CPU and GPU timings, keyed by scope name.
+//
+// CPU scopes are timed with steady_clock. GPU scopes bracket the GL commands issued inside them
+// with GL_TIMESTAMP queries, which are read back kFramesInFlight frames later so that profiling
+// never waits on the GPU. Each timer keeps the last kWindowSize samples.
+//
+// Window::Run times update_visualization, draw_visualization, SwapBuffers and PollEvents, and the
+// bundled drawables time their Update and Draw on the GPU as "Lines::Draw", "Cubemesh::Update" etc.
+// Profiling is off until enabled, either with SetEnabled or by pressing F3 in the window, which
+// also shows the breakdown on screen.
+class Profiler {
+ public:
+  static constexpr int kWindowSize = 240;
+  static constexpr int kFramesInFlight = 4;
+
+  // The process-wide instance. Its queries belong to the context of the last Window created, see
+  // ContextCreated.
+  static Profiler &Get();
+  // Forget the queries of the previous GL context, pending or free, which went away with it. Window
+  // calls this for every context it creates. The timers keep their samples.
+  void ContextCreated();
+
+  void SetEnabled(bool enabled) { enabled_ = enabled; }
+  [[nodiscard]] bool Enabled() const { return enabled_; }
+
+  // Called by Window::Run at the start of every frame. Collects the GPU timings of the frame issued
+  // kFramesInFlight frames ago.
+  void BeginFrame();
+  // Drop all samples.
+  void Reset();
+
+  // Names of the timers which have samples, sorted.
+  [[nodiscard]] std::vector<std::string> CpuTimers() const;
+  [[nodiscard]] std::vector<std::string> GpuTimers() const;
+  // Statistics of one timer, all zero if it has no samples.
+  [[nodiscard]] TimerStats CpuStats(const std::string &name) const;
+  [[nodiscard]] TimerStats GpuStats(const std::string &name) const;
+  // One line per timer, as drawn by the overlay.
+  [[nodiscard]] std::vector<std::string> Report() const;
+
+  // Times its own lifetime on the CPU. The name must outlive the scope, e.g. a string literal.
+  class CpuScope {
+   public:
+    explicit CpuScope(const char *name);
+    ~CpuScope();
+    CpuScope(const CpuScope &) = delete;
+    CpuScope &operator=(const CpuScope &) = delete;
+
+   private:
+    const char *name_;
+    bool active_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+  // Times the GL commands issued during its lifetime on the GPU. The name must outlive the scope.
+  class GpuScope {
+   public:
+    explicit GpuScope(const char *name);
+    ~GpuScope();
+    GpuScope(const GpuScope &) = delete;
+    GpuScope &operator=(const GpuScope &) = delete;
+
+   private:
+    const char *name_;
+    GLuint begin_query_ = 0;
+  };
+
+ private:
+  Profiler() = default;
+
+  class Timer {
+   public:
+    void AddSample(double ms);
+    [[nodiscard]] TimerStats Stats() const;
+
+   private:
+    std::vector<double> samples_{};  // ring buffer of the last kWindowSize samples
+    size_t next_ = 0;
+  };
+
+  struct PendingQuery {
+    const char *name;
+    GLuint begin_query;
+    GLuint end_query;
+  };
+
+  GLuint AcquireQuery();
+  static std::vector<std::string> Names(const std::unordered_map<std::string, Timer> &timers);
+  static TimerStats Stats(const std::unordered_map<std::string, Timer> &timers,
+                          const std::string &name);
+
+  bool enabled_ = false;
+  std::unordered_map<std::string, Timer> cpu_timers_{};
+  std::unordered_map<std::string, Timer> gpu_timers_{};
+  std::array<std::vector<PendingQuery>, kFramesInFlight> pending_{};
+  int frame_ = 0;
+  std::vector<GLuint> free_queries_{};
+};
+
+};  // namespace bb3d
@@ -0,0 +1,27 @@
+#include "bb3d/redraw.hpp"
+
+#define GLFW_INCLUDE_NONE
+#include <GLFW/glfw3.h>  // for glfwPostEmptyEvent
+
+#include <atomic>  // for atomic
+
+namespace bb3d {
+
+static std::atomic<bool> g_redraw_requested{true};
+static std::atomic<bool> g_wake_event_loop{false};
+
+void RequestRedraw() {
+  // Only the first request since the last redraw needs to wake the loop. Posting an event is a
+  // syscall, and drawables request a redraw on every Update.
+  if (!g_redraw_requested.exchange(true) && g_wake_event_loop.load()) {
+    glfwPostEmptyEvent();
+  }
+}
+
+bool RedrawRequested() { return g_redraw_requested.load(); }
+
+bool TakeRedrawRequest() { return g_redraw_requested.exchange(false); }
+
+void SetRedrawWakesEventLoop(const bool wake) { g_wake_event_loop.store(wake); }
+
+};  // namespace bb3d
@@ -0,0 +1,19 @@
+#pragma once
+
+namespace bb3d {
+
+// Tell a Window running with on-demand rendering that the scene changed and needs drawing. Safe to
+// call from any thread; it also wakes the render loop if it is waiting for events. The bundled
+// drawables call it from their Update methods, so only code which changes what is drawn some other
+// way needs to.
+void RequestRedraw();
+
+// For Window::Run: whether a redraw was requested since the last TakeRedrawRequest, which also
+// clears the request.
+bool RedrawRequested();
+bool TakeRedrawRequest();
+
+// For Window::Run: whether RequestRedraw has to wake the loop from glfwWaitEventsTimeout.
+void SetRedrawWakesEventLoop(bool wake);
+
+};  // namespace bb3d
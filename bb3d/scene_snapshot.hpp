@@ -0,0 +1,65 @@
+#pragma once
+
+#include <eigen3/Eigen/Dense>  // for Matrix, Dynamic
+#include <glm/glm.hpp>         // for vec3
+#include <memory>              // for unique_ptr
+#include <utility>             // for pair
+#include <vector>              // for vector
+
+#include "bb3d/assert.hpp"             // for ASSERT
+#include "bb3d/redraw.hpp"             // for RequestRedraw
+#include "bb3d/shader/colorlines.hpp"  // for ColoredVec3
+#include "bb3d/triple_buffer.hpp"      // for TripleBuffer
+
+namespace bb3d {
+
+// Arguments to Cubemesh::Update.
+struct CubeGrid {
+  Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> grid;
+  float min_x = 0;
+  float max_x = 0;
+  float min_y = 0;
+  float max_y = 0;
+};
+
+// CPU-side scene description which a producer thread fills in and hands to the render thread.
+// Nothing in here touches OpenGL, so it is safe to build on any thread.
+struct SceneSnapshot {
+  // arguments to ColorLines::Update
+  std::vector<std::vector<ColoredVec3> > color_lines;
+  // arguments to Gridmesh::Update
+  std::vector<Eigen::Matrix<glm::vec3, Eigen::Dynamic, Eigen::Dynamic> > grids;
+  // arguments to Cubemesh::Update
+  std::vector<CubeGrid> cube_grids;
+};
+
+// One triple-buffered snapshot slot per producer thread. Each producer only ever touches its own
+// slot, so any number of producers can publish concurrently without locks; Window::Run picks up
+// the newest complete snapshot of every producer at the top of each frame.
+class SceneSnapshots {
+ public:
+  explicit SceneSnapshots(int num_producers) : producers_() {
+    ASSERT(num_producers >= 1);
+    for (int k = 0; k < num_producers; k++) {
+      producers_.push_back(std::make_unique<TripleBuffer<SceneSnapshot> >());
+    }
+  }
+  ~SceneSnapshots() = default;
+
+  [[nodiscard]] int NumProducers() const { return static_cast<int>(producers_.size()); }
+  TripleBuffer<SceneSnapshot> &Producer(int producer) {
+    ASSERT(producer >= 0 && producer < NumProducers());
+    return *producers_[static_cast<size_t>(producer)];
+  }
+  // Publish the producer's back snapshot and wake a Window::Run which renders on demand.
+  void Publish(int producer) {
+    Producer(producer).Publish();
+    RequestRedraw();
+  }
+
+ private:
+  // TripleBuffer holds atomics and can't be moved, so keep each one behind a pointer.
+  std::vector<std::unique_ptr<TripleBuffer<SceneSnapshot> > > producers_;
+};
+
+};  // namespace bb3d
@@ -0,0 +1,57 @@
+#include "camera_uniforms.hpp"
+
+#include <GL/glew.h>  // for glBindBufferBase, glBufferSubData, GL_UNIFORM_BUFFER
+
+#include <array>    // for array
+#include <cstring>  // for memcmp
+
+#include "bb3d/assert.hpp"  // for ASSERT
+
+namespace bb3d {
+
+CameraUniforms &CameraUniforms::Get() {
+  // Never destroyed: the GL context is gone by the time static destructors run.
+  static CameraUniforms *instance = new CameraUniforms();
+  return *instance;
+}
+
+void CameraUniforms::ContextCreated() {
+  glGenBuffers(1, &ubo_);
+  glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(CameraBlock), nullptr, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  glBindBufferBase(GL_UNIFORM_BUFFER, kBindingPoint, ubo_);
+  valid_ = false;
+}
+
+void CameraUniforms::Update(const glm::mat4 &view, const glm::mat4 &proj,
+                            const glm::vec2 &viewport_size, const float frame_time) {
+  block_.view = view;
+  block_.proj = proj;
+  block_.viewport_size = viewport_size;
+  block_.frame_time = frame_time;
+  Upload();
+}
+
+void CameraUniforms::SetViewProj(const glm::mat4 &view, const glm::mat4 &proj) {
+  std::array<GLint, 4> viewport{};
+  glGetIntegerv(GL_VIEWPORT, viewport.data());
+  block_.view = view;
+  block_.proj = proj;
+  block_.viewport_size = glm::vec2(viewport[2], viewport[3]);
+  Upload();
+}
+
+void CameraUniforms::Upload() {
+  if (valid_ && memcmp(&uploaded_, &block_, sizeof(CameraBlock)) == 0) {
+    return;
+  }
+  ASSERT(ubo_ != 0);  // no Window has created a context yet
+  glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CameraBlock), &block_);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  uploaded_ = block_;
+  valid_ = true;
+}
+
+};  // namespace bb3d
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLuint
+
+#include <glm/glm.hpp>  // for mat4, vec2
+
+namespace bb3d {
+
+// Contents of the std140 uniform block which every bundled vertex shader except freetype.vs, which
+// draws screen text in pixels, declares as
+//
+//   layout (std140) uniform Camera {
+//     mat4 view;
+//     mat4 proj;
+//     vec2 viewport_size;  // pixels
+//     float frame_time;    // seconds
+//   };
+struct CameraBlock {
+  glm::mat4 view;
+  glm::mat4 proj;
+  glm::vec2 viewport_size;
+  float frame_time;
+  float padding;  // std140 rounds the block up to a multiple of vec4
+};
+static_assert(sizeof(CameraBlock) == 144, "CameraBlock must match the std140 layout");
+
+// The uniform buffer behind the Camera block, shared by all programs in the GL context. Window::Run
+// writes it once per frame, so drawables don't upload their own copies of view and proj.
+class CameraUniforms {
+ public:
+  // Uniform buffer binding point of the Camera block, assigned by Shader after linking since GLSL
+  // 4.00 has no layout(binding = ...).
+  static constexpr GLuint kBindingPoint = 0;
+
+  // The process-wide instance. Its buffer belongs to the context of the last Window created, see
+  // ContextCreated.
+  static CameraUniforms &Get();
+  // Create the buffer in the GL context which just became current and bind it to kBindingPoint.
+  // Window calls this for every context it creates, since the previous buffer went away with the
+  // previous context.
+  void ContextCreated();
+
+  void Update(const glm::mat4 &view, const glm::mat4 &proj, const glm::vec2 &viewport_size,
+              float frame_time);
+  // For the Draw(view, proj, ...) overloads of the drawables: replaces view and proj and reads the
+  // viewport size from GL_VIEWPORT, keeping the frame time.
+  void SetViewProj(const glm::mat4 &view, const glm::mat4 &proj);
+
+  [[nodiscard]] const CameraBlock &Block() const { return block_; }
+
+ private:
+  CameraUniforms() = default;
+  // Upload block_ unless it is the same as what the buffer already holds.
+  void Upload();
+
+  GLuint ubo_{};
+  CameraBlock block_{};
+  CameraBlock uploaded_{};
+  bool valid_ = false;
+};
+
+};  // namespace bb3d
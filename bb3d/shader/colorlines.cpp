@@ -2,103 +2,230 @@
 
 #include <GL/glew.h>  // for GLint, GL_ARRAY_BUFFER, glEnable, glBindBuffer, glBindVertexArray
 
-#include "bb3d/opengl_context.hpp"
+#include <algorithm>  // for upper_bound
+#include <array>      // for array
+#include <cstddef>    // for size_t, offsetof
+#include <cstdint>    // for uint16_t, uint32_t
+#include <memory>     // for make_unique
+#include <vector>     // for vector
+
+#include "bb3d/assert.hpp"                  // for ASSERT
+#include "bb3d/culling.hpp"                 // for Aabb, Frustum, SegmentChunks
+#include "bb3d/gl_state.hpp"                // for GlState
+#include "bb3d/profiler.hpp"                // for Profiler
+#include "bb3d/redraw.hpp"                  // for RequestRedraw
+#include "bb3d/shader/camera_uniforms.hpp"  // for CameraUniforms
+#include "bb3d/vertex_format.hpp"           // for PackRgba8, Quantization
 
 namespace bb3d {
 
-ColorLines::ColorLines()
-    : shader_(Window::GetBazelRlocation("bb3d/shader/colorlines.vs"),
-              Window::GetBazelRlocation("bb3d/shader/colorlines.fs")),
-      current_buffer_size_(0),
-      segment_sizes_() {
+// ColoredVec3 as uploaded with VertexFormat::kCompact.
+struct CompactColoredVertex {
+  std::array<uint16_t, 3> position;  // quantized
+  uint16_t padding;                  // keeps color 4 byte aligned
+  uint32_t color;                    // RGBA8
+};
+static_assert(sizeof(CompactColoredVertex) == 12, "CompactColoredVertex must be tightly packed");
+
+ColorLines::ColorLines(const UploadMode upload_mode, const VertexFormat vertex_format)
+    : vertex_format_(vertex_format),
+      shader_("bb3d/shader/colorlines.vs", "bb3d/shader/colorlines.fs"),
+      point_size_uniform_(shader_.GetUniform<float>("point_size")),
+      position_origin_uniform_(shader_.GetUniform<glm::vec3>("position_origin")),
+      position_scale_uniform_(shader_.GetUniform<glm::vec3>("position_scale")),
+      vertex_buffer_(upload_mode, vertex_format == VertexFormat::kCompact
+                                      ? sizeof(CompactColoredVertex)
+                                      : sizeof(ColoredVec3)),
+      segment_sizes_(),
+      segment_firsts_(),
+      flat_vertices_(),
+      flat_segment_offsets_() {
   point_size_ = 1;
 
   // set up vertex data (and buffer(s)) and configure vertex attributes
   // ------------------------------------------------------------------
   glGenVertexArrays(1, &vao_);
-  glGenBuffers(1, &vbo_);
+  SetupVertexAttributes();
+}
 
+void ColorLines::SetupVertexAttributes() {
   // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure
   // vertex attributes(s).
-  glBindVertexArray(vao_);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-  glBufferData(GL_ARRAY_BUFFER, current_buffer_size_, nullptr, GL_DYNAMIC_DRAW);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float), (GLvoid *)nullptr);  // NOLINT
+  GlState::Get().BindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_.Buffer());
+  if (vertex_format_ == VertexFormat::kCompact) {
+    glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(CompactColoredVertex),
+                          (GLvoid *)offsetof(CompactColoredVertex, position));  // NOLINT
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactColoredVertex),
+                          (GLvoid *)offsetof(CompactColoredVertex, color));  // NOLINT
+  } else {
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 7 * sizeof(float),
+                          (GLvoid *)nullptr);  // NOLINT
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 7 * sizeof(float),
+                          (GLvoid *)(3 * sizeof(float)));  // NOLINT
+  }
   glEnableVertexAttribArray(0);
-  glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 7 * sizeof(float),
-                        (GLvoid *)(3 * sizeof(float)));  // NOLINT
   glEnableVertexAttribArray(1);
 
   // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex
   // attribute's bound vertex buffer object so afterwards we can safely unbind
   glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-  // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but
-  // this rarely happens. Modifying other VAOs requires a call to glBindVertexArray anyways so we
-  // generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-  glBindVertexArray(0);
+  vertex_buffer_generation_ = vertex_buffer_.Generation();
 }
 
 void ColorLines::Draw(const glm::mat4 &view, const glm::mat4 &proj, const GLenum mode) {
+  CameraUniforms::Get().SetViewProj(view, proj);
+  Draw(mode);
+}
+
+void ColorLines::Draw(const GLenum mode) {
+  const Profiler::GpuScope gpu_scope("ColorLines::Draw");
   // draw triangle
   shader_.UseProgram();
-  glBindVertexArray(vao_);  // seeing as we only have a single VAO there's no need to bind it every
-                            // time, but we'll do so to keep things a bit more organized
-
-  // Set up transformations
-  shader_.UniformMatrix4fv("view", view);
-  shader_.UniformMatrix4fv("proj", proj);
+  GlState::Get().BindVertexArray(vao_);
 
-  shader_.Uniform1f("point_size", point_size_);
+  point_size_uniform_.Set(point_size_);
+  position_origin_uniform_.Set(quantization_.Origin());
+  position_scale_uniform_.Set(quantization_.Scale());
 
   // blend and antialias
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glEnable(GL_LINE_SMOOTH);
-  glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+  GlState::Get().SetEnabled(GL_BLEND, true);
+  GlState::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  GlState::Get().SetEnabled(GL_LINE_SMOOTH, true);
 
-  // Draw lines one segment at a time.
-  GLint offset = 0;
-  for (const GLint segment_size : segment_sizes_) {
-    glDrawArrays(mode, offset, segment_size);
-    offset += segment_size;
+  cull_stats_ = DrawSegments(mode);
+}
+
+void ColorLines::DrawIds(const uint32_t object_id, const GLenum mode) {
+  const Profiler::GpuScope gpu_scope("ColorLines::DrawIds");
+  if (pick_shader_ == nullptr) {
+    pick_shader_ =
+        std::make_unique<Shader>("bb3d/shader/colorlines.vs", "bb3d/shader/pick_vertex.fs");
+    pick_point_size_uniform_ = pick_shader_->GetUniform<float>("point_size");
+    pick_position_origin_uniform_ = pick_shader_->GetUniform<glm::vec3>("position_origin");
+    pick_position_scale_uniform_ = pick_shader_->GetUniform<glm::vec3>("position_scale");
+    pick_first_vertex_uniform_ = pick_shader_->GetUniform<int>("first_vertex");
+    pick_object_id_uniform_ = pick_shader_->GetUniform<int>("object_id");
+  }
+  pick_shader_->UseProgram();
+  GlState::Get().BindVertexArray(vao_);
+
+  // The program is shared with other ColorLines, so these are set every DrawIds.
+  pick_point_size_uniform_.Set(point_size_);
+  pick_position_origin_uniform_.Set(quantization_.Origin());
+  pick_position_scale_uniform_.Set(quantization_.Scale());
+  pick_first_vertex_uniform_.Set(first_vertex_);
+  pick_object_id_uniform_.Set(static_cast<int>(object_id));
+  DrawSegments(mode);
+}
+
+CullStats ColorLines::DrawSegments(const GLenum mode) {
+  const std::vector<GLint> *firsts = &segment_firsts_;
+  const std::vector<GLint> *sizes = &segment_sizes_;
+  CullStats cull_stats{chunks_.NumChunks(), 0};
+  if (frustum_culling_) {
+    cull_stats = chunks_.Visible(Frustum::FromCamera(), mode, &visible_firsts_, &visible_sizes_);
+    firsts = &visible_firsts_;
+    sizes = &visible_sizes_;
+  }
+  if (sizes->empty()) {
+    return cull_stats;
+  }
+
+  if (batched_draw_) {
+    // Draw all segments in one call.
+    glMultiDrawArrays(mode, firsts->data(), sizes->data(), static_cast<GLsizei>(sizes->size()));
+    GlState::Get().CountDraws(1);
+  } else {
+    // Draw lines one segment at a time.
+    for (size_t k = 0; k < sizes->size(); k++) {
+      glDrawArrays(mode, (*firsts)[k], (*sizes)[k]);
+      GlState::Get().CountDraws(1);
+    }
+  }
+  return cull_stats;
+}
+
+PickedVertex ColorLines::DecodePick(const uint32_t primitive_id) const {
+  // The primitive ID is the vertex counted from first_vertex_, see colorlines.vs.
+  const GLint vertex = first_vertex_ + static_cast<GLint>(primitive_id);
+  // The last segment starting at or before the vertex. Empty segments start where the next one
+  // does, so they are skipped.
+  const auto next = std::upper_bound(segment_firsts_.begin(), segment_firsts_.end(), vertex);
+  if (next == segment_firsts_.begin()) {
+    return {-1, -1};
   }
+  const auto segment = static_cast<size_t>(next - segment_firsts_.begin() - 1);
+  const GLint index = vertex - segment_firsts_[segment];
+  if (index >= segment_sizes_[segment]) {
+    return {-1, -1};
+  }
+  return {static_cast<int>(segment), index};
 }
 
 void ColorLines::Update(const std::vector<std::vector<ColoredVec3> > &segments) {
-  // Massage the data.
-  // TODO(greg): static assert that std::vector<ColoredVertex> is packed and just reinterpret cast
-  std::vector<float> buffer_data;
-  segment_sizes_.resize(0);
+  // Flatten into reused buffers, then upload in one go.
+  flat_vertices_.clear();
+  flat_segment_offsets_.clear();
   for (const std::vector<ColoredVec3> &segment : segments) {
-    const auto segment_size = static_cast<GLint>(segment.size());
-    segment_sizes_.push_back(segment_size);
-    for (const ColoredVec3 &vertex : segment) {
-      buffer_data.push_back(vertex.position.x);
-      buffer_data.push_back(vertex.position.y);
-      buffer_data.push_back(vertex.position.z);
-      buffer_data.push_back(vertex.color.r);
-      buffer_data.push_back(vertex.color.g);
-      buffer_data.push_back(vertex.color.b);
-      buffer_data.push_back(vertex.color.a);
-    }
+    flat_segment_offsets_.push_back(static_cast<GLint>(flat_vertices_.size()));
+    flat_vertices_.insert(flat_vertices_.end(), segment.begin(), segment.end());
+  }
+  Update(flat_vertices_, flat_segment_offsets_);
+}
+
+void ColorLines::Update(const Span<ColoredVec3> vertices, const Span<GLint> segment_offsets) {
+  const Profiler::GpuScope gpu_scope("ColorLines::Update");
+  RequestRedraw();
+  const auto num_vertices = static_cast<GLint>(vertices.size());
+
+  segment_sizes_.clear();
+  for (size_t k = 0; k < segment_offsets.size(); k++) {
+    const GLint begin = segment_offsets[k];
+    const GLint end = k + 1 < segment_offsets.size() ? segment_offsets[k + 1] : num_vertices;
+    ASSERT(0 <= begin && begin <= end && end <= num_vertices);
+    segment_sizes_.push_back(end - begin);
   }
-  // bind the buffer
-  // glBindVertexArray(vao_);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-
-  const auto buffer_size = static_cast<GLint>(sizeof(float) * buffer_data.size());
-  if (buffer_size == current_buffer_size_) {
-    // if the size of data is the same, just update the buffer
-    glBufferSubData(GL_ARRAY_BUFFER, 0, buffer_size, buffer_data.data());
+  // Vertices before the first segment are uploaded but never drawn.
+  const GLint skipped = segment_offsets.empty() ? 0 : segment_offsets[0];
+
+  GLint upload_first = 0;
+  if (vertex_format_ == VertexFormat::kCompact) {
+    Aabb bounds;
+    for (const ColoredVec3 &vertex : vertices) {
+      bounds.Extend(vertex.position);
+    }
+    quantization_ = Quantization(bounds);
+    auto *compact = static_cast<CompactColoredVertex *>(vertex_buffer_.Reserve(num_vertices));
+    for (size_t k = 0; k < vertices.size(); k++) {
+      const glm::vec3 &position = vertices[k].position;
+      compact[k] = {{quantization_.Quantize(position.x, 0), quantization_.Quantize(position.y, 1),
+                     quantization_.Quantize(position.z, 2)},
+                    0,
+                    PackRgba8(vertices[k].color)};
+    }
+    upload_first = vertex_buffer_.Commit();
+    uploaded_bytes_ = sizeof(CompactColoredVertex) * vertices.size();
   } else {
-    // if the size of data has changed, we have to reallocate GPU memory
-    glBufferData(GL_ARRAY_BUFFER, buffer_size, buffer_data.data(), GL_DYNAMIC_DRAW);
-    current_buffer_size_ = buffer_size;
+    upload_first = vertex_buffer_.Upload(vertices.data(), num_vertices);
+    uploaded_bytes_ = sizeof(ColoredVec3) * vertices.size();
   }
+  first_vertex_ = upload_first + skipped;
 
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  // glBindVertexArray(0);
+  segment_firsts_.clear();
+  GLint first = first_vertex_;
+  for (const GLint segment_size : segment_sizes_) {
+    segment_firsts_.push_back(first);
+    first += segment_size;
+  }
+  chunks_.Update(segment_firsts_, segment_sizes_, [&](GLint vertex) {
+    return vertices[static_cast<size_t>(vertex - upload_first)].position;
+  });
+
+  if (vertex_buffer_.Generation() != vertex_buffer_generation_) {
+    SetupVertexAttributes();
+  }
 }
 
 };  // namespace bb3d
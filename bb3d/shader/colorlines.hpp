@@ -2,13 +2,23 @@
 
 #include <GL/glew.h>
 
+#include <cstddef>      // for offsetof
+#include <cstdint>      // for uint32_t
+#include <memory>       // for unique_ptr
+#include <type_traits>  // for is_standard_layout_v, is_trivially_copyable_v
 #include <vector>
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
 #include <glm/glm.hpp>
 
+#include "bb3d/culling.hpp"
+#include "bb3d/draw_list.hpp"
+#include "bb3d/picker.hpp"
 #include "bb3d/shader/shader.hpp"
+#include "bb3d/span.hpp"
+#include "bb3d/streaming_buffer.hpp"
+#include "bb3d/vertex_format.hpp"
 
 namespace bb3d {
 
@@ -16,23 +26,85 @@ struct ColoredVec3 {
   glm::vec3 position;
   glm::vec4 color;
 };
+// ColoredVec3 is uploaded as is, so it has to match the vertex attributes set up in ColorLines.
+static_assert(std::is_standard_layout_v<ColoredVec3>);
+static_assert(std::is_trivially_copyable_v<ColoredVec3>);
+static_assert(sizeof(ColoredVec3) == 7 * sizeof(float), "ColoredVec3 must be tightly packed");
+static_assert(offsetof(ColoredVec3, position) == 0);
+static_assert(offsetof(ColoredVec3, color) == 3 * sizeof(float));
 
 struct ColorLines {
  public:
-  ColorLines();
+  explicit ColorLines(UploadMode upload_mode = UploadMode::kBufferSubData,
+                      VertexFormat vertex_format = VertexFormat::kFloat);
   ~ColorLines() = default;
   void Update(const std::vector<std::vector<ColoredVec3> > &segments);
+  // Upload all vertices from one contiguous array without repacking them. Segment k is
+  // vertices[segment_offsets[k]] up to the next segment's offset (or the end of vertices).
+  void Update(Span<ColoredVec3> vertices, Span<GLint> segment_offsets);
+  // Draw with the view and projection in CameraUniforms.
+  void Draw(GLenum mode);
+  // Same as above after replacing view and proj in the shared camera uniforms, for callers outside
+  // of Window::Run.
   void Draw(const glm::mat4 &view, const glm::mat4 &proj, GLenum mode);
+  // The state Draw sets, for sorting in a DrawList.
+  [[nodiscard]] DrawState State() const {
+    return {DrawPass::kTransparent, shader_.ProgramId(), 0, true};
+  }
+  // Draw object_id and the vertex index into a Picker's ID framebuffer instead of colors, with the
+  // same mode as Draw. DecodePick turns the primitive ID of a hit back into segment and vertex.
+  void DrawIds(uint32_t object_id, GLenum mode);
+  // Segment and vertex of a pick drawn by DrawIds, or {-1, -1} if the segments changed since and
+  // don't have that vertex anymore.
+  [[nodiscard]] PickedVertex DecodePick(uint32_t primitive_id) const;
   void SetPointSize(float point_size) { point_size_ = point_size; };
+  // Submit all segments with one glMultiDrawArrays (the default) instead of one glDrawArrays each.
+  void SetBatchedDraw(bool batched_draw) { batched_draw_ = batched_draw; };
+  // Skip the parts of segments which are outside of the view (the default). Segments are culled in
+  // chunks of SegmentChunks::kChunkVertices vertices.
+  void SetFrustumCulling(bool frustum_culling) { frustum_culling_ = frustum_culling; };
+  // Chunks drawn and culled by the last Draw.
+  [[nodiscard]] CullStats Culling() const { return cull_stats_; }
+  // Number of bytes the last Update sent to the GPU.
+  [[nodiscard]] size_t UploadedBytes() const { return uploaded_bytes_; }
 
  private:
+  void SetupVertexAttributes();
+  // Draw the segments, or their visible parts, with the program in use.
+  CullStats DrawSegments(GLenum mode);
+
   float point_size_ = 1;
+  bool batched_draw_ = true;
+  VertexFormat vertex_format_;
+  Quantization quantization_{};  // of the last Update, identity for kFloat
+  size_t uploaded_bytes_ = 0;
+  bool frustum_culling_ = true;
 
   Shader shader_;
+  Uniform<float> point_size_uniform_;
+  Uniform<glm::vec3> position_origin_uniform_;
+  Uniform<glm::vec3> position_scale_uniform_;
+  std::unique_ptr<Shader> pick_shader_{};  // created by the first DrawIds, with these
+  Uniform<float> pick_point_size_uniform_{};
+  Uniform<glm::vec3> pick_position_origin_uniform_{};
+  Uniform<glm::vec3> pick_position_scale_uniform_{};
+  Uniform<int> pick_first_vertex_uniform_{};
+  Uniform<int> pick_object_id_uniform_{};
   GLuint vao_{};
-  GLuint vbo_{};
-  GLint current_buffer_size_;
+  StreamingBuffer vertex_buffer_;
+  int vertex_buffer_generation_ = -1;
+  GLint first_vertex_ = 0;
   std::vector<GLint> segment_sizes_;
+  std::vector<GLint> segment_firsts_;  // absolute, including first_vertex_
+  SegmentChunks chunks_{};
+  CullStats cull_stats_{0, 0};
+  // visible parts of the segments, rebuilt by every culled Draw
+  std::vector<GLint> visible_sizes_{};
+  std::vector<GLint> visible_firsts_{};
+
+  // reused by the nested-vector Update to avoid reallocating every frame
+  std::vector<ColoredVec3> flat_vertices_;
+  std::vector<GLint> flat_segment_offsets_;
 };
 
 };  // namespace bb3d
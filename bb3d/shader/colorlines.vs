@@ -2,12 +2,22 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec4 vert_color;
 out vec4 frag_color_in;
-uniform mat4 view;
-uniform mat4 proj;
+flat out uint pick_id;  // for pick_vertex.fs: the vertex, counted from first_vertex
+layout (std140) uniform Camera {
+  mat4 view;
+  mat4 proj;
+  vec2 viewport_size;  // pixels
+  float frame_time;    // seconds
+};
 uniform float point_size;
+// VertexFormat::kCompact positions are normalized 16 bit integers, kFloat has the identity here.
+uniform vec3 position_origin;
+uniform vec3 position_scale;
+uniform int first_vertex;
 void main()
 {
-  gl_Position = proj * view * vec4(position, 1.0);
+  gl_Position = proj * view * vec4(position_origin + position_scale * position, 1.0);
   frag_color_in = vert_color;
   gl_PointSize = point_size;
+  pick_id = uint(gl_VertexID - first_vertex);
 }
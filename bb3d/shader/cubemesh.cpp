@@ -2,20 +2,110 @@
 
 #include <GL/glew.h>  // for GLuint, GL_ARRAY_BUFFER, glBindBuffer, glDisable, GL_ELEME...
 
+#include <array>               // for array
+#include <cstddef>             // for size_t, offsetof
+#include <cstdint>             // for uint16_t, uint32_t
+#include <cstring>             // for memcpy
 #include <ext/alloc_traits.h>  // for __alloc_traits<>::value_type
+#include <memory>              // for make_unique
 #include <vector>              // for vector, allocator
 
-#include "bb3d/assert.hpp"  // for ASSERT
-#include "bb3d/opengl_context.hpp"
+#include "bb3d/assert.hpp"                  // for ASSERT
+#include "bb3d/culling.hpp"                 // for Frustum, Aabb, GridTiles
+#include "bb3d/dirty_runs.hpp"              // for ForEachDirtyRun
+#include "bb3d/gl_state.hpp"                // for GlState
+#include "bb3d/profiler.hpp"                // for Profiler
+#include "bb3d/redraw.hpp"                  // for RequestRedraw
+#include "bb3d/shader/camera_uniforms.hpp"  // for CameraUniforms
+#include "bb3d/vertex_format.hpp"           // for PackRgba8, Quantization
 
 namespace bb3d {
 
-Cubemesh::Cubemesh()
-    : shader_(Window::GetBazelRlocation("bb3d/shader/cubemesh.vs"),
-              Window::GetBazelRlocation("bb3d/shader/cubemesh.fs")),
+// Unit cell mesh for kInstanced, matching the triangles which UpdateExpanded generates. x/y are
+// corner signs relative to the cell's center, z selects the height (0: this cell, 1: +y neighbor,
+// 2: +x neighbor).
+// clang-format off
+static const std::array<float, 18 * 3> kUnitCell = {
+    // flat 1
+    -1, 1, 0,    1, 1, 0,    1, -1, 0,
+    // flat 2
+    1, -1, 0,    -1, -1, 0,  -1, 1, 0,
+    // right side triangle 1
+    -1, 1, 1,    1, 1, 1,    1, 1, 0,
+    // right side triangle 2
+    1, 1, 0,     -1, 1, 0,   -1, 1, 1,
+    // top side triangle 1
+    1, 1, 0,     1, 1, 2,    1, -1, 2,
+    // top side triangle 2
+    1, -1, 2,    1, -1, 0,   1, 1, 0,
+};
+// clang-format on
+
+// kExpanded vertex with VertexFormat::kFloat.
+struct FloatCubemeshVertex {
+  glm::vec3 position;
+  glm::vec3 color;
+};
+static_assert(sizeof(FloatCubemeshVertex) == 24, "FloatCubemeshVertex must be tightly packed");
+
+// kExpanded vertex with VertexFormat::kCompact. Only x and y are quantized, they lie on the grid
+// whose bounds are known up front, while the heights of later partial updates could fall outside of
+// any bounds computed now.
+struct CompactCubemeshVertex {
+  std::array<uint16_t, 2> position;  // quantized x, y
+  float z;
+  uint32_t color;  // RGBA8
+};
+static_assert(sizeof(CompactCubemeshVertex) == 12, "CompactCubemeshVertex must be tightly packed");
+
+template <typename T>
+static void AppendBytes(const T &value, std::vector<unsigned char> &bytes) {
+  const auto *begin = reinterpret_cast<const unsigned char *>(&value);
+  bytes.insert(bytes.end(), begin, begin + sizeof(T));
+}
+
+Cubemesh::Cubemesh(const CubemeshMode mode, const VertexFormat vertex_format)
+    : mode_(mode),
+      vertex_format_(vertex_format),
+      shader_(mode == CubemeshMode::kInstanced ? "bb3d/shader/cubemesh_instanced.vs"
+                                               : "bb3d/shader/cubemesh.vs",
+              "bb3d/shader/cubemesh.fs"),
+      first_instance_uniform_(shader_.GetUniform<int>("first_instance")),
+      grid_min_uniform_(shader_.GetUniform<glm::vec2>("grid_min")),
+      cell_size_uniform_(shader_.GetUniform<glm::vec2>("cell_size")),
+      ny_uniform_(shader_.GetUniform<int>("ny")),
+      position_origin_uniform_(shader_.GetUniform<glm::vec3>("position_origin")),
+      position_scale_uniform_(shader_.GetUniform<glm::vec3>("position_scale")),
       num_indices_(0),
       vertex_buffer_size_(0),
-      index_buffer_size_(0) {
+      index_buffer_size_(0),
+      previous_grid_(),
+      region_vertices_(),
+      instance_data_() {
+  if (mode_ == CubemeshMode::kInstanced) {
+    glGenVertexArrays(1, &vao_);
+    glGenBuffers(1, &vbo_);
+    glGenBuffers(1, &cell_buffer_);
+    glGenTextures(1, &cell_texture_);
+
+    GlState::Get().BindVertexArray(vao_);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(kUnitCell), kUnitCell.data(), GL_STATIC_DRAW);
+    shader_.VertexAttribPointer("corner", 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    // Each instance record is (height, color) packed into two 32 bit words.
+    glBindBuffer(GL_TEXTURE_BUFFER, cell_buffer_);
+    glBufferData(GL_TEXTURE_BUFFER, cell_buffer_size_, nullptr, GL_DYNAMIC_DRAW);
+    GlState::Get().BindTexture(0, GL_TEXTURE_BUFFER, cell_texture_);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RG32UI, cell_buffer_);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    shader_.UseProgram();
+    shader_.Uniform1i("cells", 0);
+    return;
+  }
 
   // set up vertex data (and buffer(s)) and configure vertex attributes
   // ------------------------------------------------------------------
@@ -24,7 +114,7 @@ Cubemesh::Cubemesh()
   glGenBuffers(1, &ebo_);
   // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure
   // vertex attributes(s).
-  glBindVertexArray(vao_);
+  GlState::Get().BindVertexArray(vao_);
 
   glBindBuffer(GL_ARRAY_BUFFER, vbo_);
   glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size_, nullptr, GL_DYNAMIC_DRAW);
@@ -32,13 +122,26 @@ Cubemesh::Cubemesh()
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_size_, nullptr, GL_DYNAMIC_DRAW);
 
-  shader_.VertexAttribPointer("position", 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float),
-                              (void *)(0 * sizeof(GLfloat)));  // NOLINT
+  // The shader takes x and y from position and z from height, which is a float in both formats.
+  const auto stride = static_cast<GLsizei>(VertexStride());
+  if (vertex_format_ == VertexFormat::kCompact) {
+    shader_.VertexAttribPointer("position", 2, GL_UNSIGNED_SHORT, GL_TRUE, stride,
+                                (void *)offsetof(CompactCubemeshVertex, position));  // NOLINT
+    shader_.VertexAttribPointer("color", 4, GL_UNSIGNED_BYTE, GL_TRUE, stride,
+                                (void *)offsetof(CompactCubemeshVertex, color));  // NOLINT
+    shader_.VertexAttribPointer("height", 1, GL_FLOAT, GL_FALSE, stride,
+                                (void *)offsetof(CompactCubemeshVertex, z));  // NOLINT
+  } else {
+    shader_.VertexAttribPointer("position", 2, GL_FLOAT, GL_FALSE, stride,
+                                (void *)(0 * sizeof(GLfloat)));  // NOLINT
+    shader_.VertexAttribPointer("color", 3, GL_FLOAT, GL_FALSE, stride,
+                                (void *)(3 * sizeof(GLfloat)));  // NOLINT
+    shader_.VertexAttribPointer("height", 1, GL_FLOAT, GL_FALSE, stride,
+                                (void *)(2 * sizeof(GLfloat)));  // NOLINT
+  }
   glEnableVertexAttribArray(0);
-
-  shader_.VertexAttribPointer("color", 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float),
-                              (void *)(3 * sizeof(GLfloat)));  // NOLINT
   glEnableVertexAttribArray(1);
+  glEnableVertexAttribArray(2);
 
   // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex
   // attribute's bound vertex buffer object so afterwards we can safely unbind
@@ -47,58 +150,364 @@ Cubemesh::Cubemesh()
   // remember: do NOT unbind the EBO while a VAO is active as the bound element buffer object IS
   // stored in the VAO; keep the EBO bound.
   // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-  // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but
-  // this rarely happens. Modifying other VAOs requires a call to glBindVertexArray anyways so we
-  // generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-  glBindVertexArray(0);
 }
 
 void Cubemesh::Draw(const glm::mat4 &view, const glm::mat4 &proj) {
+  CameraUniforms::Get().SetViewProj(view, proj);
+  Draw();
+}
+
+void Cubemesh::Draw() {
+  const Profiler::GpuScope gpu_scope("Cubemesh::Draw");
   // render
   shader_.UseProgram();
-  glBindVertexArray(vao_);
-
-  // Set up transformations
-  shader_.UniformMatrix4fv("view", view);
-  shader_.UniformMatrix4fv("proj", proj);
+  GlState::Get().BindVertexArray(vao_);
 
   // disable blending and polygon antialiasing
-  glDisable(GL_BLEND);
-  glDisable(GL_POLYGON_SMOOTH);
+  GlState::Get().SetEnabled(GL_BLEND, false);
+  GlState::Get().SetEnabled(GL_POLYGON_SMOOTH, false);
+
+  if (mode_ == CubemeshMode::kInstanced) {
+    GlState::Get().BindTexture(0, GL_TEXTURE_BUFFER, cell_texture_);
+    grid_min_uniform_.Set(grid_min_);
+    cell_size_uniform_.Set(cell_size_);
+    ny_uniform_.Set(ny_);
+    const auto num_vertices = static_cast<GLsizei>(kUnitCell.size() / 3);
+    if (frustum_culling_) {
+      // GLSL 4.00 has no gl_BaseInstance, so each range is its own draw.
+      cull_stats_ = tiles_.ForEachVisibleRange(Frustum::FromCamera(), [&](int begin, int end) {
+        first_instance_uniform_.Set(begin);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, num_vertices, end - begin);
+        GlState::Get().CountDraws(1);
+      });
+    } else {
+      cull_stats_ = {tiles_.NumTiles(), 0};
+      first_instance_uniform_.Set(0);
+      glDrawArraysInstanced(GL_TRIANGLES, 0, num_vertices, (nx_ - 1) * (ny_ - 1));
+      GlState::Get().CountDraws(1);
+    }
+    return;
+  }
+
+  position_origin_uniform_.Set(quantization_.Origin());
+  position_scale_uniform_.Set(quantization_.Scale());
 
   // Draw triangles
-  glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_INT, nullptr);
+  if (frustum_culling_) {
+    // Quad k is indices [18 * k, 18 * (k + 1)).
+    visible_counts_.clear();
+    visible_offsets_.clear();
+    cull_stats_ = tiles_.ForEachVisibleRange(Frustum::FromCamera(), [&](int begin, int end) {
+      visible_counts_.push_back(18 * (end - begin));
+      visible_offsets_.push_back(
+          reinterpret_cast<const void *>(18 * sizeof(GLuint) * static_cast<size_t>(begin)));
+    });
+    if (visible_counts_.empty()) {
+      return;
+    }
+    glMultiDrawElements(GL_TRIANGLES, visible_counts_.data(), GL_UNSIGNED_INT,
+                        visible_offsets_.data(), static_cast<GLsizei>(visible_counts_.size()));
+    GlState::Get().CountDraws(1);
+  } else {
+    cull_stats_ = {tiles_.NumTiles(), 0};
+    glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_INT, nullptr);
+    GlState::Get().CountDraws(1);
+  }
+}
+
+void Cubemesh::DrawIds(const uint32_t object_id) {
+  const Profiler::GpuScope gpu_scope("Cubemesh::DrawIds");
+  if (pick_shader_ == nullptr) {
+    if (mode_ == CubemeshMode::kInstanced) {
+      pick_shader_ = std::make_unique<Shader>("bb3d/shader/cubemesh_instanced.vs",
+                                              "bb3d/shader/pick_vertex.fs");
+      pick_shader_->UseProgram();
+      pick_shader_->Uniform1i("cells", 0);
+    } else {
+      pick_shader_ =
+          std::make_unique<Shader>("bb3d/shader/cubemesh.vs", "bb3d/shader/pick_primitive.fs");
+    }
+    pick_object_id_uniform_ = pick_shader_->GetUniform<int>("object_id");
+    pick_first_instance_uniform_ = pick_shader_->GetUniform<int>("first_instance");
+    pick_grid_min_uniform_ = pick_shader_->GetUniform<glm::vec2>("grid_min");
+    pick_cell_size_uniform_ = pick_shader_->GetUniform<glm::vec2>("cell_size");
+    pick_ny_uniform_ = pick_shader_->GetUniform<int>("ny");
+    pick_position_origin_uniform_ = pick_shader_->GetUniform<glm::vec3>("position_origin");
+    pick_position_scale_uniform_ = pick_shader_->GetUniform<glm::vec3>("position_scale");
+    pick_primitives_per_pick_uniform_ = pick_shader_->GetUniform<int>("primitives_per_pick");
+    pick_first_primitive_uniform_ = pick_shader_->GetUniform<int>("first_primitive");
+  }
+  pick_shader_->UseProgram();
+  GlState::Get().BindVertexArray(vao_);
+  // The program is shared with other Cubemeshes, so the uniforms are set every DrawIds.
+  pick_object_id_uniform_.Set(static_cast<int>(object_id));
 
-  // unbind vao
-  glBindVertexArray(0);
+  if (mode_ == CubemeshMode::kInstanced) {
+    // The vertex shader writes the cell as the pick ID.
+    GlState::Get().BindTexture(0, GL_TEXTURE_BUFFER, cell_texture_);
+    pick_grid_min_uniform_.Set(grid_min_);
+    pick_cell_size_uniform_.Set(cell_size_);
+    pick_ny_uniform_.Set(ny_);
+    const auto num_vertices = static_cast<GLsizei>(kUnitCell.size() / 3);
+    const auto draw_cells = [&](int begin, int end) {
+      pick_first_instance_uniform_.Set(begin);
+      glDrawArraysInstanced(GL_TRIANGLES, 0, num_vertices, end - begin);
+      GlState::Get().CountDraws(1);
+    };
+    if (frustum_culling_) {
+      tiles_.ForEachVisibleRange(Frustum::FromCamera(), draw_cells);
+    } else {
+      draw_cells(0, (nx_ - 1) * (ny_ - 1));
+    }
+    return;
+  }
+
+  pick_position_origin_uniform_.Set(quantization_.Origin());
+  pick_position_scale_uniform_.Set(quantization_.Scale());
+  pick_primitives_per_pick_uniform_.Set(6);
+  // Quad k is triangles [6 * k, 6 * (k + 1)). gl_PrimitiveID restarts with every draw call, so
+  // each visible range is its own draw.
+  const auto draw_quads = [&](int begin, int end) {
+    pick_first_primitive_uniform_.Set(6 * begin);
+    glDrawElements(
+        GL_TRIANGLES, 18 * (end - begin), GL_UNSIGNED_INT,
+        reinterpret_cast<const void *>(18 * sizeof(GLuint) * static_cast<size_t>(begin)));
+    GlState::Get().CountDraws(1);
+  };
+  if (frustum_culling_) {
+    tiles_.ForEachVisibleRange(Frustum::FromCamera(), draw_quads);
+  } else {
+    draw_quads(0, num_indices_ / 18);
+  }
+}
+
+PickedCell Cubemesh::DecodePick(const uint32_t primitive_id) const {
+  const int index = static_cast<int>(primitive_id);
+  // Quads, and instances of kInstanced, are numbered kx * (ny - 1) + ky, see UpdateExpanded.
+  return {index / (ny_ - 1), index % (ny_ - 1)};
 }
 
 void Cubemesh::Update(
     const Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> &grid,
     const float min_x, const float max_x, const float min_y, const float max_y) {
+  const Profiler::GpuScope gpu_scope("Cubemesh::Update");
+  RequestRedraw();
+  uploaded_bytes_ = 0;
+
+  const bool same_layout = grid.rows() == nx_ && grid.cols() == ny_ && min_x == min_x_ &&
+                           max_x == max_x_ && min_y == min_y_ && max_y == max_y_;
+  if (diff_updates_ && same_layout && previous_grid_.rows() == nx_ &&
+      previous_grid_.cols() == ny_) {
+    // Each row of cells is contiguous in the buffer, upload the runs which changed.
+    const int max_gap = 16;
+    for (int kx = 0; kx < nx_; kx++) {
+      ForEachDirtyRun(
+          ny_, max_gap, [&](int ky) { return grid(kx, ky) != previous_grid_(kx, ky); },
+          [&](int ky_begin, int ky_end) {
+            UploadCells(grid, kx, ky_begin, kx, ky_begin, ky_end - ky_begin);
+            for (int ky = ky_begin; ky < ky_end; ky++) {
+              previous_grid_(kx, ky) = grid(kx, ky);
+            }
+          });
+    }
+    return;
+  }
+
+  nx_ = static_cast<int>(grid.rows());
+  ny_ = static_cast<int>(grid.cols());
+  min_x_ = min_x;
+  max_x_ = max_x;
+  min_y_ = min_y;
+  max_y_ = max_y;
+  if (mode_ == CubemeshMode::kExpanded && vertex_format_ == VertexFormat::kCompact) {
+    // Cell corners stick out half a cell past the grid bounds. z isn't quantized.
+    const float dx = 0.5F * (max_x_ - min_x_) / (static_cast<float>(nx_) - 1);
+    const float dy = 0.5F * (max_y_ - min_y_) / (static_cast<float>(ny_) - 1);
+    Aabb bounds;
+    bounds.Extend(glm::vec3(min_x_ - dx, min_y_ - dy, 0.0F));
+    bounds.Extend(glm::vec3(max_x_ + dx, max_y_ + dy, 0.0F));
+    quantization_ = Quantization(bounds);
+  }
+  if (mode_ == CubemeshMode::kInstanced) {
+    UpdateInstanced(grid);
+  } else {
+    UpdateExpanded(grid);
+  }
+  if (diff_updates_) {
+    previous_grid_ = grid;
+  }
+}
+
+void Cubemesh::UpdateRegion(
+    const int row0, const int col0,
+    const Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> &block) {
+  const Profiler::GpuScope gpu_scope("Cubemesh::UpdateRegion");
+  RequestRedraw();
+  const auto block_rows = static_cast<int>(block.rows());
+  const auto block_cols = static_cast<int>(block.cols());
+  ASSERT(row0 >= 0 && row0 + block_rows <= nx_);
+  ASSERT(col0 >= 0 && col0 + block_cols <= ny_);
+
+  uploaded_bytes_ = 0;
+  for (int kr = 0; kr < block_rows; kr++) {
+    UploadCells(block, kr, 0, row0 + kr, col0, block_cols);
+  }
+
+  if (diff_updates_ && previous_grid_.rows() == nx_ && previous_grid_.cols() == ny_) {
+    for (int kc = 0; kc < block_cols; kc++) {
+      for (int kr = 0; kr < block_rows; kr++) {
+        previous_grid_(row0 + kr, col0 + kc) = block(kr, kc);
+      }
+    }
+  }
+}
+
+void Cubemesh::SetDiffUpdates(const bool diff_updates) {
+  diff_updates_ = diff_updates;
+  if (!diff_updates_) {
+    previous_grid_.resize(0, 0);
+  }
+}
+
+// kInstanced record: (height as float bits, RGBA8 color)
+static void WriteInstanceRecord(const std::pair<float, glm::vec3> &zcol, uint32_t *record) {
+  memcpy(record, &zcol.first, sizeof(float));
+  record[1] = PackRgba8(glm::vec4(zcol.second, 1.0F));
+}
+
+void Cubemesh::UpdateInstanced(
+    const Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> &grid) {
+  ASSERT(nx_ >= 2);
+  ASSERT(ny_ >= 2);
+
+  grid_min_ = {min_x_, min_y_};
+  cell_size_ = {(max_x_ - min_x_) / static_cast<float>(nx_ - 1),
+                (max_y_ - min_y_) / static_cast<float>(ny_ - 1)};
+
+  // Record kx * ny + ky is grid point (kx, ky), like the vertex numbering of UpdateExpanded. Like
+  // its quads, the instances only cover the points before the last row and column, which only
+  // provide the heights of their neighbors' walls.
+  instance_data_.resize(2 * static_cast<size_t>(nx_) * static_cast<size_t>(ny_));
+  tiles_.Reset(nx_ - 1, ny_ - 1);
+  uint32_t *record = instance_data_.data();
+  for (int kx = 0; kx < nx_; kx++) {
+    for (int ky = 0; ky < ny_; ky++) {
+      WriteInstanceRecord(grid(kx, ky), record);
+      tiles_.ExtendPoint(kx, ky, CellBounds(kx, ky, grid(kx, ky).first));
+      record += 2;
+    }
+  }
+
+  const auto cell_buffer_size =
+      static_cast<GLint>(sizeof(instance_data_[0]) * instance_data_.size());
+  glBindBuffer(GL_TEXTURE_BUFFER, cell_buffer_);
+  if (cell_buffer_size == cell_buffer_size_) {
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, cell_buffer_size, instance_data_.data());
+  } else {
+    glBufferData(GL_TEXTURE_BUFFER, cell_buffer_size, instance_data_.data(), GL_DYNAMIC_DRAW);
+    cell_buffer_size_ = cell_buffer_size;
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  uploaded_bytes_ += static_cast<size_t>(cell_buffer_size);
+}
+
+void Cubemesh::AppendCellVertices(const int kx, const int ky,
+                                  const std::pair<float, glm::vec3> &zcol,
+                                  std::vector<unsigned char> &vertices) const {
+  const float dx = 0.5F * (max_x_ - min_x_) / (static_cast<float>(nx_) - 1);
+  const float dy = 0.5F * (max_y_ - min_y_) / (static_cast<float>(ny_) - 1);
+  const float x =
+      min_x_ + (max_x_ - min_x_) * static_cast<float>(kx) / static_cast<float>(nx_ - 1);
+  const float y =
+      min_y_ + (max_y_ - min_y_) * static_cast<float>(ky) / static_cast<float>(ny_ - 1);
+  const float z = zcol.first;
+  const glm::vec3 color = zcol.second;
+  const std::array<glm::vec2, 4> corners = {glm::vec2(x + dx, y - dy), glm::vec2(x + dx, y + dy),
+                                            glm::vec2(x - dx, y + dy), glm::vec2(x - dx, y - dy)};
+  if (vertex_format_ == VertexFormat::kCompact) {
+    const uint32_t rgba8 = PackRgba8(glm::vec4(color, 1.0F));
+    for (const glm::vec2 &corner : corners) {
+      const CompactCubemeshVertex vertex{
+          {quantization_.Quantize(corner.x, 0), quantization_.Quantize(corner.y, 1)}, z, rgba8};
+      AppendBytes(vertex, vertices);
+    }
+  } else {
+    for (const glm::vec2 &corner : corners) {
+      AppendBytes(FloatCubemeshVertex{glm::vec3(corner.x, corner.y, z), color}, vertices);
+    }
+  }
+}
+
+size_t Cubemesh::VertexStride() const {
+  return vertex_format_ == VertexFormat::kCompact ? sizeof(CompactCubemeshVertex)
+                                                  : sizeof(FloatCubemeshVertex);
+}
+
+Aabb Cubemesh::CellBounds(const int kx, const int ky, const float z) const {
+  // Same corners as AppendCellVertices, which kInstanced's vertex shader also reproduces.
+  const float dx = 0.5F * (max_x_ - min_x_) / (static_cast<float>(nx_) - 1);
+  const float dy = 0.5F * (max_y_ - min_y_) / (static_cast<float>(ny_) - 1);
+  const float x =
+      min_x_ + (max_x_ - min_x_) * static_cast<float>(kx) / static_cast<float>(nx_ - 1);
+  const float y =
+      min_y_ + (max_y_ - min_y_) * static_cast<float>(ky) / static_cast<float>(ny_ - 1);
+  Aabb bounds;
+  bounds.Extend(glm::vec3(x - dx, y - dy, z));
+  bounds.Extend(glm::vec3(x + dx, y + dy, z));
+  return bounds;
+}
+
+void Cubemesh::UploadCells(
+    const Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> &source,
+    const int source_row, const int source_col, const int kx, const int ky_begin,
+    const int num_cells) {
+  const int first_cell = kx * ny_ + ky_begin;
+  for (int k = 0; k < num_cells; k++) {
+    const int ky = ky_begin + k;
+    tiles_.ExtendPoint(kx, ky, CellBounds(kx, ky, source(source_row, source_col + k).first));
+  }
+  if (mode_ == CubemeshMode::kInstanced) {
+    instance_data_.resize(2 * static_cast<size_t>(num_cells));
+    for (int k = 0; k < num_cells; k++) {
+      WriteInstanceRecord(source(source_row, source_col + k), &instance_data_[2 * k]);
+    }
+    const auto offset = static_cast<GLintptr>(2 * sizeof(uint32_t)) * first_cell;
+    const auto size = static_cast<GLsizeiptr>(2 * sizeof(uint32_t)) * num_cells;
+    glBindBuffer(GL_TEXTURE_BUFFER, cell_buffer_);
+    glBufferSubData(GL_TEXTURE_BUFFER, offset, size, instance_data_.data());
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    uploaded_bytes_ += static_cast<size_t>(size);
+    return;
+  }
+
+  region_vertices_.resize(0);
+  for (int k = 0; k < num_cells; k++) {
+    AppendCellVertices(kx, ky_begin + k, source(source_row, source_col + k), region_vertices_);
+  }
+  const auto offset = static_cast<GLintptr>(4 * VertexStride()) * first_cell;
+  const auto size = static_cast<GLsizeiptr>(region_vertices_.size());
+  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  glBufferSubData(GL_ARRAY_BUFFER, offset, size, region_vertices_.data());
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  uploaded_bytes_ += static_cast<size_t>(size);
+}
+
+void Cubemesh::UpdateExpanded(
+    const Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> &grid) {
   const int nx = static_cast<int>(grid.rows());  // readability below
   const int ny = static_cast<int>(grid.cols());  // readability below
 
   ASSERT(nx >= 2);
   ASSERT(ny >= 2);
 
-  const float dx = 0.5F * (max_x - min_x) / (static_cast<float>(nx) - 1);
-  const float dy = 0.5F * (max_y - min_y) / (static_cast<float>(ny) - 1);
-
   // Massage the data.
-  std::vector<float> vertices;
+  std::vector<unsigned char> vertices;
+  vertices.reserve(4 * VertexStride() * static_cast<size_t>(nx) * static_cast<size_t>(ny));
+  tiles_.Reset(nx - 1, ny - 1);
   for (int kx = 0; kx < nx; kx++) {
-    const float x = min_x + (max_x - min_x) * static_cast<float>(kx) / static_cast<float>(nx - 1);
     for (int ky = 0; ky < ny; ky++) {
-      const float y = min_y + (max_y - min_y) * static_cast<float>(ky) / static_cast<float>(ny - 1);
-      const std::pair<float, glm::vec3> zcol = grid(kx, ky);
-      const float z = zcol.first;
-      const glm::vec3 color = zcol.second;
-      vertices.insert(vertices.end(), {x + dx, y - dy, z, color.r, color.g, color.b});
-      vertices.insert(vertices.end(), {x + dx, y + dy, z, color.r, color.g, color.b});
-      vertices.insert(vertices.end(), {x - dx, y + dy, z, color.r, color.g, color.b});
-      vertices.insert(vertices.end(), {x - dx, y - dy, z, color.r, color.g, color.b});
+      AppendCellVertices(kx, ky, grid(kx, ky), vertices);
+      tiles_.ExtendPoint(kx, ky, CellBounds(kx, ky, grid(kx, ky).first));
     }
   }
 
@@ -157,6 +566,9 @@ void Cubemesh::Update(
   const auto vertex_buffer_size = static_cast<GLint>(sizeof(vertices[0]) * vertices.size());
   const auto index_buffer_size = static_cast<GLint>(sizeof(indices[0]) * indices.size());
 
+  // The element buffer binding is VAO state, so bind ours rather than change whichever VAO the last
+  // Draw left bound.
+  GlState::Get().BindVertexArray(vao_);
   glBindBuffer(GL_ARRAY_BUFFER, vbo_);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
 
@@ -179,6 +591,7 @@ void Cubemesh::Update(
   }
 
   glBindBuffer(GL_ARRAY_BUFFER, 0);
+  uploaded_bytes_ += static_cast<size_t>(vertex_buffer_size + index_buffer_size);
 }
 
 Cubemesh::~Cubemesh() {
@@ -187,6 +600,9 @@ Cubemesh::~Cubemesh() {
   glDeleteVertexArrays(1, &vao_);
   glDeleteBuffers(1, &vbo_);
   glDeleteBuffers(1, &ebo_);
+  glDeleteBuffers(1, &cell_buffer_);
+  glDeleteTextures(1, &cell_texture_);
+  GlState::Get().Invalidate();
 }
 
 };  // namespace bb3d
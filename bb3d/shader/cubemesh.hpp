@@ -2,24 +2,75 @@
 
 #include <GL/glew.h>  // for GLuint, GLint
 
+#include <cstddef>             // for size_t
+#include <cstdint>             // for uint32_t
 #include <eigen3/Eigen/Dense>  // for Matrix, Dynamic, DenseCoeffsBase
-#include <glm/glm.hpp>         // for vec3, mat4
+#include <glm/glm.hpp>         // for vec2, vec3, mat4
+#include <memory>              // for unique_ptr
 #include <utility>             // for pair
+#include <vector>              // for vector
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
-#include "bb3d/shader/shader.hpp"  // for Shader
+#include "bb3d/culling.hpp"        // for Aabb, CullStats, GridTiles
+#include "bb3d/draw_list.hpp"      // for DrawState, DrawPass
+#include "bb3d/picker.hpp"         // for PickedCell
+#include "bb3d/shader/shader.hpp"  // for Shader, Uniform
+#include "bb3d/vertex_format.hpp"  // for VertexFormat, Quantization
 
 namespace bb3d {
 
+enum class CubemeshMode {
+  // Every cell is expanded on the CPU into 4 vertices and 18 indices.
+  kExpanded,
+  // Every cell is one 8 byte instance record (height and RGBA8 color) and a shared unit cell mesh
+  // is expanded in the vertex shader.
+  kInstanced,
+};
+
+// Both modes draw the same cells: one per grid point, except for the last row and column of the
+// grid, whose heights only close the walls of their neighbors. Culling tiles and picks number these
+// (nx - 1) x (ny - 1) cells the same way in both modes.
 struct Cubemesh {
-  Cubemesh();
+  // vertex_format applies to kExpanded, whose vertices are 12 instead of 24 bytes with kCompact.
+  // kInstanced records are 8 bytes per cell either way.
+  explicit Cubemesh(CubemeshMode mode = CubemeshMode::kExpanded,
+                    VertexFormat vertex_format = VertexFormat::kFloat);
   ~Cubemesh();
 
+  // Draw with the view and projection in CameraUniforms.
+  void Draw();
+  // Same as above after replacing view and proj in the shared camera uniforms, for callers outside
+  // of Window::Run.
   void Draw(const glm::mat4 &view, const glm::mat4 &proj);
+  // The state Draw sets, for sorting in a DrawList.
+  [[nodiscard]] DrawState State() const {
+    return {DrawPass::kOpaque, shader_.ProgramId(),
+            mode_ == CubemeshMode::kInstanced ? cell_texture_ : 0, false};
+  }
+  // Draw object_id and the cell index into a Picker's ID framebuffer instead of colors. DecodePick
+  // turns the primitive ID of a hit back into a cell.
+  void DrawIds(uint32_t object_id);
+  // Cell (row, col) of a pick drawn by DrawIds, grid(row, col) of the last Update.
+  [[nodiscard]] PickedCell DecodePick(uint32_t primitive_id) const;
   void Update(
       const Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> &grid,
       float min_x, float max_x, float min_y, float max_y);
+  // Re-upload only the cells covered by `block`, whose top left corner is at (row0, col0). The block
+  // has to fit inside the grid given to the last Update, whose bounds are kept.
+  void UpdateRegion(
+      int row0, int col0,
+      const Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> &block);
+  // When enabled, Update compares the grid against the previous one and only uploads the runs of
+  // cells which changed. This keeps a CPU-side copy of the grid.
+  void SetDiffUpdates(bool diff_updates);
+  // Number of bytes the last Update or UpdateRegion sent to the GPU.
+  [[nodiscard]] size_t UploadedBytes() const { return uploaded_bytes_; }
+  // Skip the tiles of cells which are outside of the view (the default). The tile bounds are
+  // computed by Update; UpdateRegion and diff updates only grow them.
+  void SetFrustumCulling(bool frustum_culling) { frustum_culling_ = frustum_culling; };
+  // Tiles of GridTiles::kTileSize x kTileSize cells drawn and culled by the last Draw.
+  [[nodiscard]] CullStats Culling() const { return cull_stats_; }
   template <int NU, int NV>
   void Update(const Eigen::Matrix<std::pair<float, glm::vec3>, NU, NV> &mat, float min_x,
               float max_x, float min_y, float max_y) {
@@ -33,13 +84,78 @@ struct Cubemesh {
   }
 
  private:
+  // Full uploads, using the layout stored by Update.
+  void UpdateExpanded(
+      const Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> &grid);
+  void UpdateInstanced(
+      const Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> &grid);
+  // Upload num_cells cells starting at (kx, ky_begin) from source(source_row, source_col...).
+  void UploadCells(
+      const Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> &source,
+      int source_row, int source_col, int kx, int ky_begin, int num_cells);
+  void AppendCellVertices(int kx, int ky, const std::pair<float, glm::vec3> &zcol,
+                          std::vector<unsigned char> &vertices) const;
+  // Bytes per kExpanded vertex.
+  [[nodiscard]] size_t VertexStride() const;
+  // Bounds of the top of cell (kx, ky) at height z.
+  [[nodiscard]] Aabb CellBounds(int kx, int ky, float z) const;
+
+  CubemeshMode mode_;
+  VertexFormat vertex_format_;
   Shader shader_;
+  Uniform<int> first_instance_uniform_;  // kInstanced
+  Uniform<glm::vec2> grid_min_uniform_;
+  Uniform<glm::vec2> cell_size_uniform_;
+  Uniform<int> ny_uniform_;
+  Uniform<glm::vec3> position_origin_uniform_;  // kExpanded
+  Uniform<glm::vec3> position_scale_uniform_;
+  std::unique_ptr<Shader> pick_shader_{};  // created by the first DrawIds, with these
+  Uniform<int> pick_object_id_uniform_{};
+  Uniform<int> pick_first_instance_uniform_{};  // kInstanced
+  Uniform<glm::vec2> pick_grid_min_uniform_{};
+  Uniform<glm::vec2> pick_cell_size_uniform_{};
+  Uniform<int> pick_ny_uniform_{};
+  Uniform<glm::vec3> pick_position_origin_uniform_{};  // kExpanded
+  Uniform<glm::vec3> pick_position_scale_uniform_{};
+  Uniform<int> pick_primitives_per_pick_uniform_{};
+  Uniform<int> pick_first_primitive_uniform_{};
   GLuint vao_{};
   GLuint vbo_{};
   GLuint ebo_{};
   int num_indices_;
   GLint vertex_buffer_size_ = 0;
   GLint index_buffer_size_ = 0;
+
+  // layout of the last full Update
+  int nx_ = 0;
+  int ny_ = 0;
+  float min_x_ = 0;
+  float max_x_ = 0;
+  float min_y_ = 0;
+  float max_y_ = 0;
+  Quantization quantization_{};  // of x and y, identity for kFloat
+  size_t uploaded_bytes_ = 0;
+
+  bool diff_updates_ = false;
+  Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> previous_grid_;
+  std::vector<unsigned char> region_vertices_;  // reused by UploadCells
+
+  // Culled by tiles of the (nx - 1) x (ny - 1) cells which are drawn, quads for kExpanded and
+  // instances for kInstanced.
+  bool frustum_culling_ = true;
+  GridTiles tiles_{};
+  CullStats cull_stats_{0, 0};
+  std::vector<GLsizei> visible_counts_{};  // reused by Draw
+  std::vector<const void *> visible_offsets_{};
+
+  // kInstanced: vbo_ holds the unit cell mesh and cell_buffer_ the per-cell instance records,
+  // which the vertex shader reads through cell_texture_ so it can also look up neighbor heights.
+  GLuint cell_buffer_{};
+  GLuint cell_texture_{};
+  GLint cell_buffer_size_ = 0;
+  glm::vec2 grid_min_{};
+  glm::vec2 cell_size_{};
+  std::vector<uint32_t> instance_data_;  // reused to avoid reallocating every frame
 };
 
 };  // namespace bb3d
@@ -1,12 +1,21 @@
 #version 400 core
-layout (location = 0) in vec3 position;
+layout (location = 0) in vec2 position;
 layout (location = 1) in vec3 color;
+layout (location = 2) in float height;
 out vec3 vs_color;
-uniform mat4 view;
-uniform mat4 proj;
+layout (std140) uniform Camera {
+  mat4 view;
+  mat4 proj;
+  vec2 viewport_size;  // pixels
+  float frame_time;    // seconds
+};
 uniform vec3 pos0;
+// VertexFormat::kCompact x/y are normalized 16 bit integers, kFloat has the identity here.
+uniform vec3 position_origin;
+uniform vec3 position_scale;
 void main()
 {
   vs_color = color;
-  gl_Position = proj * view * vec4(position, 1.0);
+  vec2 xy = position_origin.xy + position_scale.xy * position;
+  gl_Position = proj * view * vec4(xy, height, 1.0);
 }
@@ -0,0 +1,40 @@
+#version 400 core
+// One instance per grid cell except those of the last row and column, like the quads of the
+// expanded mode. The unit cell mesh is the cell's flat top plus the walls down to its +y and +x
+// neighbors; x/y of each vertex are corner signs relative to the cell's center and z picks which
+// cell's height to use (0: this one, 1: +y neighbor, 2: +x neighbor).
+layout (location = 0) in vec3 corner;
+out vec3 vs_color;
+flat out uint pick_id;  // for pick_vertex.fs: the instance
+layout (std140) uniform Camera {
+  mat4 view;
+  mat4 proj;
+  vec2 viewport_size;  // pixels
+  float frame_time;    // seconds
+};
+uniform usamplerBuffer cells;  // per cell: (height as float bits, RGBA8 color)
+uniform vec2 grid_min;         // center of cell (0, 0)
+uniform vec2 cell_size;        // distance between neighboring cell centers
+uniform int ny;
+uniform int first_instance;    // GLSL 4.00 has no gl_BaseInstance
+void main()
+{
+  int instance = first_instance + gl_InstanceID;
+  int kx = instance / (ny - 1);
+  int ky = instance - kx * (ny - 1);
+  int cell = kx * ny + ky;
+
+  // The +x and +y neighbors always exist, since the last row and column have no instances.
+  int height_cell = cell;
+  if (corner.z == 1.0) {
+    height_cell += 1;
+  } else if (corner.z == 2.0) {
+    height_cell += ny;
+  }
+  float height = uintBitsToFloat(texelFetch(cells, height_cell).x);
+
+  vec2 xy = grid_min + cell_size * (vec2(kx, ky) + 0.5 * corner.xy);
+  vs_color = unpackUnorm4x8(texelFetch(cells, cell).y).rgb;
+  gl_Position = proj * view * vec4(xy, height, 1.0);
+  pick_id = uint(instance);
+}
@@ -0,0 +1,240 @@
+#include "decimatedlines.hpp"
+
+#include <GL/glew.h>  // for GL_LINE_STRIP
+
+#include <algorithm>  // for min, max
+#include <limits>     // for numeric_limits
+#include <utility>    // for move
+
+#include "bb3d/assert.hpp"                  // for ASSERT
+#include "bb3d/profiler.hpp"                // for Profiler
+#include "bb3d/redraw.hpp"                  // for RequestRedraw
+#include "bb3d/shader/camera_uniforms.hpp"  // for CameraUniforms, CameraBlock
+
+namespace bb3d {
+
+// Fewer buckets than this per thread aren't worth starting a thread for.
+static constexpr size_t kMinBucketsPerThread = 4096;
+
+DecimatedLines::DecimatedLines(const UploadMode upload_mode)
+    : lines_(upload_mode),
+      samples_(),
+      levels_(),
+      items_(),
+      vertices_(),
+      segment_offsets_() {
+  // Decimate already skips what is outside of the view.
+  lines_.SetFrustumCulling(false);
+}
+
+void DecimatedLines::SetPixelTolerance(const float pixels) {
+  ASSERT(pixels > 0);
+  pixel_tolerance_ = pixels;
+  decimated_ = false;
+}
+
+void DecimatedLines::SetNumThreads(const int num_threads) {
+  ASSERT(num_threads > 0);
+  num_threads_ = num_threads;
+}
+
+DecimatedLines::Bucket DecimatedLines::Merge(const Bucket &left, const Bucket &right) const {
+  Bucket merged = left;
+  merged.bounds.Extend(right.bounds);
+  if (samples_[right.min_index].y < samples_[left.min_index].y) {
+    merged.min_index = right.min_index;
+  }
+  if (samples_[right.max_index].y > samples_[left.max_index].y) {
+    merged.max_index = right.max_index;
+  }
+  return merged;
+}
+
+void DecimatedLines::Update(std::vector<glm::vec3> samples) {
+  const Profiler::CpuScope cpu_scope("DecimatedLines::Update");
+  RequestRedraw();
+  ASSERT(samples.size() < std::numeric_limits<uint32_t>::max());
+  samples_ = std::move(samples);
+  levels_.resize(0);
+  decimated_ = false;
+  if (samples_.empty()) {
+    return;
+  }
+
+  const size_t num_leaves = (samples_.size() + kLeafSamples - 1) / kLeafSamples;
+  levels_.emplace_back(num_leaves);
+  const auto build_leaves = [this](int /*part*/, size_t begin, size_t end) {
+    std::vector<Bucket> &leaves = levels_[0];
+    for (size_t k = begin; k < end; k++) {
+      const auto first = static_cast<uint32_t>(k * kLeafSamples);
+      const auto end_index = static_cast<uint32_t>(
+          std::min(static_cast<size_t>(first) + kLeafSamples, samples_.size()));
+      Bucket bucket{Aabb{}, first, first};
+      for (uint32_t index = first; index < end_index; index++) {
+        const glm::vec3 &sample = samples_[index];
+        bucket.bounds.Extend(sample);
+        if (sample.y < samples_[bucket.min_index].y) {
+          bucket.min_index = index;
+        }
+        if (sample.y > samples_[bucket.max_index].y) {
+          bucket.max_index = index;
+        }
+      }
+      leaves[k] = bucket;
+    }
+  };
+  ParallelFor(num_leaves, kMinBucketsPerThread, num_threads_, build_leaves);
+
+  while (levels_.back().size() > 1) {
+    const size_t level = levels_.size();
+    levels_.emplace_back((levels_.back().size() + 1) / 2);
+    const auto merge_pairs = [this, level](int /*part*/, size_t begin, size_t end) {
+      const std::vector<Bucket> &below = levels_[level - 1];
+      std::vector<Bucket> &buckets = levels_[level];
+      for (size_t k = begin; k < end; k++) {
+        buckets[k] =
+            2 * k + 1 < below.size() ? Merge(below[2 * k], below[2 * k + 1]) : below[2 * k];
+      }
+    };
+    ParallelFor(levels_[level].size(), kMinBucketsPerThread, num_threads_, merge_pairs);
+  }
+}
+
+float DecimatedLines::PixelExtent(const Aabb &bounds) const {
+  // y is collapsed, since the minimum and maximum cover it.
+  const float y = 0.5F * (bounds.min.y + bounds.max.y);
+  glm::vec2 ndc_min(std::numeric_limits<float>::infinity());
+  glm::vec2 ndc_max(-std::numeric_limits<float>::infinity());
+  for (int corner = 0; corner < 4; corner++) {
+    const float x = (corner & 1) != 0 ? bounds.max.x : bounds.min.x;
+    const float z = (corner & 2) != 0 ? bounds.max.z : bounds.min.z;
+    const glm::vec4 clip = view_proj_ * glm::vec4(x, y, z, 1.0F);
+    if (clip.w <= 0) {
+      return std::numeric_limits<float>::infinity();
+    }
+    const glm::vec2 ndc(clip.x / clip.w, clip.y / clip.w);
+    ndc_min = glm::min(ndc_min, ndc);
+    ndc_max = glm::max(ndc_max, ndc);
+  }
+  const glm::vec2 pixels = 0.5F * (ndc_max - ndc_min) * viewport_size_;
+  return std::max(pixels.x, pixels.y);
+}
+
+void DecimatedLines::Walk(const size_t level, const size_t index, const Frustum &frustum,
+                          std::vector<Item> &items) const {
+  const Bucket &bucket = levels_[level][index];
+  const size_t width = static_cast<size_t>(kLeafSamples) << level;
+  const auto first = static_cast<uint32_t>(index * width);
+  const auto last = static_cast<uint32_t>(std::min((index + 1) * width, samples_.size()) - 1);
+
+  if (!frustum.Intersects(bucket.bounds)) {
+    if (!items.empty() && items.back().kind == Item::kCulled && items.back().last + 1 == first) {
+      items.back().last = last;
+    } else {
+      items.push_back({Item::kCulled, first, last});
+    }
+    return;
+  }
+
+  if (PixelExtent(bucket.bounds) <= pixel_tolerance_) {
+    items.push_back({Item::kMinMax, std::min(bucket.min_index, bucket.max_index),
+                     std::max(bucket.min_index, bucket.max_index)});
+    return;
+  }
+  if (level == 0) {
+    items.push_back({Item::kSamples, first, last});
+    return;
+  }
+  Walk(level - 1, 2 * index, frustum, items);
+  if (2 * index + 1 < levels_[level - 1].size()) {
+    Walk(level - 1, 2 * index + 1, frustum, items);
+  }
+}
+
+void DecimatedLines::Decimate() {
+  const Profiler::CpuScope cpu_scope("DecimatedLines::Decimate");
+  vertices_.resize(0);
+  segment_offsets_.resize(0);
+  if (!levels_.empty()) {
+    // Start from the coarsest level with a few buckets per thread, so that the threads share the
+    // walk. Each thread walks a contiguous range of buckets, so the items stay in sample order.
+    view_proj_ = proj_ * view_;
+    const Frustum frustum(view_proj_);
+    size_t start = levels_.size() - 1;
+    while (start > 0 && levels_[start].size() < 4 * static_cast<size_t>(num_threads_)) {
+      start--;
+    }
+    items_.resize(static_cast<size_t>(num_threads_));
+    const auto walk = [&](int part, size_t begin, size_t end) {
+      std::vector<Item> &items = items_[static_cast<size_t>(part)];
+      items.resize(0);
+      for (size_t k = begin; k < end; k++) {
+        Walk(start, k, frustum, items);
+      }
+    };
+    const int num_parts = ParallelFor(levels_[start].size(), 1, num_threads_, walk);
+
+    // A segment ends at the first sample of a culled run and the next one starts at its last
+    // sample, so the line leaves and enters the view where the samples do.
+    bool in_gap = true;
+    bool has_resume = false;
+    uint32_t resume = 0;
+    const auto emit = [&](uint32_t index) {
+      if (in_gap) {
+        segment_offsets_.push_back(static_cast<GLint>(vertices_.size()));
+        if (has_resume && resume < index) {
+          vertices_.push_back(samples_[resume]);
+        }
+        in_gap = false;
+      }
+      vertices_.push_back(samples_[index]);
+    };
+    for (int part = 0; part < num_parts; part++) {
+      for (const Item &item : items_[static_cast<size_t>(part)]) {
+        switch (item.kind) {
+          case Item::kCulled:
+            if (!in_gap) {
+              vertices_.push_back(samples_[item.first]);
+              in_gap = true;
+            }
+            has_resume = true;
+            resume = item.last;
+            break;
+          case Item::kMinMax:
+            emit(item.first);
+            if (item.last != item.first) {
+              emit(item.last);
+            }
+            break;
+          case Item::kSamples:
+            for (uint32_t index = item.first; index <= item.last; index++) {
+              emit(index);
+            }
+            break;
+        }
+      }
+    }
+  }
+  lines_.Update(vertices_, segment_offsets_);
+}
+
+void DecimatedLines::Draw(const glm::mat4 &view, const glm::mat4 &proj, const glm::vec4 &color) {
+  CameraUniforms::Get().SetViewProj(view, proj);
+  Draw(color);
+}
+
+void DecimatedLines::Draw(const glm::vec4 &color) {
+  const Profiler::GpuScope gpu_scope("DecimatedLines::Draw");
+  const CameraBlock &camera = CameraUniforms::Get().Block();
+  if (!decimated_ || camera.view != view_ || camera.proj != proj_ ||
+      camera.viewport_size != viewport_size_) {
+    view_ = camera.view;
+    proj_ = camera.proj;
+    viewport_size_ = camera.viewport_size;
+    Decimate();
+    decimated_ = true;
+  }
+  lines_.Draw(color, GL_LINE_STRIP);
+}
+
+};  // namespace bb3d
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLint
+
+#include <cstddef>      // for size_t
+#include <cstdint>      // for uint32_t
+#include <glm/glm.hpp>  // for vec2, vec3, vec4, mat4
+#include <vector>       // for vector
+
+#include "bb3d/culling.hpp"           // for Aabb, Frustum
+#include "bb3d/draw_list.hpp"         // for DrawState
+#include "bb3d/parallel_for.hpp"      // for DefaultNumThreads
+#include "bb3d/shader/lines.hpp"      // for Lines
+#include "bb3d/streaming_buffer.hpp"  // for UploadMode
+
+namespace bb3d {
+
+// One polyline of far more samples than the screen can show, such as hours of telemetry plotted as
+// (time, value, 0). The samples stay on the CPU in a pyramid of min/max buckets: level 0 buckets
+// hold kLeafSamples samples and each level above merges pairs of buckets. Whenever the camera
+// changes, Draw walks the pyramid and uploads only what is visible at the current zoom: buckets
+// narrower than the pixel tolerance on screen are reduced to the samples with their minimum and
+// maximum y, in order, and buckets outside of the view are skipped. Spikes therefore survive at
+// any zoom, and the number of vertices uploaded depends on the viewport rather than the data.
+//
+// Building the pyramid and walking it are split across num_threads threads.
+class DecimatedLines {
+ public:
+  static constexpr uint32_t kLeafSamples = 16;
+
+  explicit DecimatedLines(UploadMode upload_mode = UploadMode::kBufferSubData);
+
+  // Replace the polyline. `samples` is moved into the pyramid.
+  void Update(std::vector<glm::vec3> samples);
+  // Draw as a line strip with the view and projection in CameraUniforms, first decimating again if
+  // the camera or the samples changed.
+  void Draw(const glm::vec4 &color);
+  // Same as above after replacing view and proj in the shared camera uniforms, for callers outside
+  // of Window::Run.
+  void Draw(const glm::mat4 &view, const glm::mat4 &proj, const glm::vec4 &color);
+  // The state Draw sets, for sorting in a DrawList.
+  [[nodiscard]] DrawState State() const { return lines_.State(); }
+
+  // Widest bucket on screen, in pixels, which is drawn as its minimum and maximum only (default 1).
+  void SetPixelTolerance(float pixels);
+  void SetNumThreads(int num_threads);
+
+  [[nodiscard]] size_t NumSamples() const { return samples_.size(); }
+  // Vertices uploaded by the last decimation.
+  [[nodiscard]] size_t NumDrawnVertices() const { return vertices_.size(); }
+
+ private:
+  struct Bucket {
+    Aabb bounds{};
+    uint32_t min_index = 0;  // of the sample with the smallest y
+    uint32_t max_index = 0;  // of the sample with the largest y
+  };
+
+  // What the walk decided for one bucket, turned into vertices afterwards in sample order.
+  struct Item {
+    enum Kind {
+      kSamples,  // samples [first, last], too close to decimate
+      kMinMax,   // samples first and last only
+      kCulled,   // samples [first, last] are outside of the view
+    };
+    Kind kind;
+    uint32_t first;
+    uint32_t last;
+  };
+
+  [[nodiscard]] Bucket Merge(const Bucket &left, const Bucket &right) const;
+  // Decimate for view_, proj_ and viewport_size_ and upload the result.
+  void Decimate();
+  void Walk(size_t level, size_t index, const Frustum &frustum, std::vector<Item> &items) const;
+  // Size on screen, in pixels, of the extent of `bounds` along the polyline.
+  [[nodiscard]] float PixelExtent(const Aabb &bounds) const;
+
+  Lines lines_;
+  float pixel_tolerance_ = 1;
+  int num_threads_ = DefaultNumThreads();
+
+  std::vector<glm::vec3> samples_;
+  std::vector<std::vector<Bucket> > levels_;  // levels_[0] are the leaf buckets
+
+  // camera of the last decimation
+  bool decimated_ = false;
+  glm::mat4 view_{};
+  glm::mat4 proj_{};
+  glm::vec2 viewport_size_{};
+  glm::mat4 view_proj_{};
+
+  // reused by Decimate
+  std::vector<std::vector<Item> > items_;
+  std::vector<glm::vec3> vertices_;
+  std::vector<GLint> segment_offsets_;
+};
+
+};  // namespace bb3d
@@ -0,0 +1,79 @@
+#!/usr/bin/env python3
+"""Generate the C++ source of bb3d::EmbeddedShaders() from GLSL files.
+
+  embed_shaders.py <output.cpp> <shader>...
+
+Shader paths are stored relative to the workspace root of the repository they come from, also when
+bb3d is built as an external repository.
+"""
+
+import sys
+
+
+def workspace_path(path):
+    """Strip the external/<repository>/ (or ../<repository>/) prefix Bazel gives external files."""
+    parts = path.split('/')
+    if len(parts) > 2 and parts[0] in ('external', '..'):
+        return '/'.join(parts[2:])
+    return path
+
+
+def c_string_lines(text):
+    """Escape text as a sequence of C string literals, one per line of the input."""
+    lines = []
+    current = []
+    for char in text:
+        if char == '\\':
+            current.append('\\\\')
+        elif char == '"':
+            current.append('\\"')
+        elif char == '\n':
+            current.append('\\n')
+            lines.append('"' + ''.join(current) + '"')
+            current = []
+        elif char == '\t':
+            current.append('\\t')
+        elif ' ' <= char <= '~':
+            current.append(char)
+        else:
+            for byte in char.encode('utf-8'):
+                current.append('\\%03o' % byte)
+    if current or not lines:
+        lines.append('"' + ''.join(current) + '"')
+    return lines
+
+
+def main(output_path, shader_paths):
+    out = [
+        '// Generated by bb3d/shader/embed_shaders.py, do not edit.',
+        '',
+        '#include <iterator>  // for size',
+        '',
+        '#include "bb3d/shader/embedded_shaders.hpp"',
+        '',
+        'namespace bb3d {',
+        '',
+        'static constexpr EmbeddedShader kEmbeddedShaders[] = {',
+    ]
+    for path in sorted(shader_paths, key=workspace_path):
+        with open(path, encoding='utf-8') as shader_file:
+            source = shader_file.read()
+        out.append('    {"%s",' % workspace_path(path))
+        out.extend('     ' + line for line in c_string_lines(source))
+        out[-1] += '},'
+    out += [
+        '};',
+        '',
+        'Span<EmbeddedShader> EmbeddedShaders() {',
+        '  return Span<EmbeddedShader>(kEmbeddedShaders, std::size(kEmbeddedShaders));',
+        '}',
+        '',
+        '};  // namespace bb3d',
+        '',
+    ]
+    with open(output_path, 'w', encoding='utf-8') as output_file:
+        output_file.write('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main(sys.argv[1], sys.argv[2:])
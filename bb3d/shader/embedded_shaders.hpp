@@ -0,0 +1,16 @@
+#pragma once
+
+#include "bb3d/span.hpp"  // for Span
+
+namespace bb3d {
+
+struct EmbeddedShader {
+  const char *path;  // relative to the workspace root, e.g. "bb3d/shader/lines.vs"
+  const char *source;
+};
+
+// Every shader of the bb3d target, compiled into the library by the embedded_shaders genrule (see
+// embed_shaders.py).
+Span<EmbeddedShader> EmbeddedShaders();
+
+};  // namespace bb3d
@@ -1,158 +1,123 @@
 #include "freetype.hpp"
 
-#include <GL/glew.h>            // for GLchar, glBindTexture, glTexParameteri, GL_TEXTURE_2D
-#include <ft2build.h>
-#include <freetype/freetype.h>  // for FT_FaceRec_, FT_GlyphSlotRec_, FT_Done_Face, FT_Done_F...
-#include <freetype/ftimage.h>   // for FT_Bitmap, FT_Vector
-
-#include <cstdlib>      // for EXIT_FAILURE
-#include <glm/glm.hpp>  // for ivec2, vec<>::(anonymous), vec3, mat4
-#include <iostream>     // for operator<<, endl, basic_ostream, cerr, ostream
-#include <map>          // for map
-#include <string>       // for basic_string, allocator, string, operator<<, char_traits
-#include <utility>      // for pair
-
-#include "bb3d/assert.hpp"  // for exit_thread_safe
-#include "bb3d/opengl_context.hpp"
+#include <GL/glew.h>  // for glVertexAttribPointer, GL_TEXTURE_2D, glDrawArrays
+
+#include <glm/glm.hpp>  // for vec3, mat4
+#include <memory>       // for shared_ptr, make_shared
+#include <string>       // for string
+#include <utility>      // for move
+#include <vector>       // for vector
+
+#include "bb3d/gl_state.hpp"       // for GlState
+#include "bb3d/profiler.hpp"       // for Profiler
 #include "bb3d/shader/shader.hpp"  // for Shader
 
 namespace bb3d {
 
-Freetype::Freetype(int font_size)
-    : shader_(Window::GetBazelRlocation("bb3d/shader/freetype.vs"),
-              Window::GetBazelRlocation("bb3d/shader/freetype.fs")),
-      characters_() {
-  // FreeType
-  // --------
-  FT_Library ft = nullptr;
-  // All functions return a value different than 0 whenever an error occurred
-  if (FT_Init_FreeType(&ft) != 0) {
-    std::cerr << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
-    exit_thread_safe(EXIT_FAILURE);
-  }
-
-  // find path to font
-  // load font as face
-  // std::string font_path = "/usr/share/fonts/truetype/freefont/FreeMono.ttf";
-  std::string font_path = "/usr/share/fonts/truetype/ubuntu/UbuntuMono-R.ttf";
-  // std::string font_path = "/usr/share/fonts/truetype/freefont/FreeSerif.ttf";
-  FT_Face face = nullptr;
-  if (FT_New_Face(ft, font_path.c_str(), 0, &face) != 0) {
-    std::cerr << "ERROR::FREETYPE: Failed to load '" << font_path << "'." << std::endl;
-    exit_thread_safe(EXIT_FAILURE);
-  }
-  // set size to load glyphs as
-  FT_Set_Pixel_Sizes(face, 0, font_size);
-
-  // disable byte-alignment restriction
-  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-
-  // load first 128 characters of ASCII set
-  for (unsigned char c = 0; c < 128; c++) {
-    // Load character glyph
-    // NOLINTNEXTLINE(hicpp-signed-bitwise)
-    if (FT_Load_Char(face, c, FT_LOAD_RENDER) != 0) {
-      std::cerr << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
-      continue;
-    }
-    // generate texture
-    unsigned int texture = 0;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, static_cast<GLsizei>(face->glyph->bitmap.width),
-                 static_cast<GLsizei>(face->glyph->bitmap.rows), 0, GL_RED, GL_UNSIGNED_BYTE,
-                 face->glyph->bitmap.buffer);
-    // set texture options
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glGenerateMipmap(GL_TEXTURE_2D);
-    // now store character for later use
-    Character character = {texture, glm::ivec2(face->glyph->bitmap.width, face->glyph->bitmap.rows),
-                           glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
-                           static_cast<unsigned int>(face->glyph->advance.x)};
-    characters_.insert(std::pair<char, Character>(c, character));
-  }
-  glBindTexture(GL_TEXTURE_2D, 0);
+namespace {
+constexpr GLsizei kVertexStride = 7 * sizeof(float);
+};  // namespace
+
+Freetype::Freetype(int font_size, const UploadMode upload_mode)
+    : Freetype(std::make_shared<const GlyphAtlas>(font_size), upload_mode) {}
+
+Freetype::Freetype(std::shared_ptr<const GlyphAtlas> atlas, const UploadMode upload_mode)
+    : atlas_(std::move(atlas)),
+      shader_("bb3d/shader/freetype.vs", "bb3d/shader/freetype.fs"),
+      projection_uniform_(shader_.GetUniform<glm::mat4>("projection")),
+      vertex_buffer_(upload_mode, kVertexStride),
+      vertices_(),
+      quads_() {
+  // configure VAO for texture quads
+  // -------------------------------
+  glGenVertexArrays(1, &vao_);
+  SetupVertexAttributes();
+}
 
-  // destroy FreeType once we're finished
-  FT_Done_Face(face);
-  FT_Done_FreeType(ft);
+Freetype::~Freetype() {
+  glDeleteVertexArrays(1, &vao_);
+  GlState::Get().Invalidate();
+}
 
-  // configure VAO/VBO for texture quads
-  // -----------------------------------
-  glGenVertexArrays(1, &vao_);
-  glGenBuffers(1, &vbo_);
-  glBindVertexArray(vao_);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 6 * 4, nullptr, GL_DYNAMIC_DRAW);
+void Freetype::SetupVertexAttributes() {
+  GlState::Get().BindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_.Buffer());
+  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, kVertexStride, nullptr);
   glEnableVertexAttribArray(0);
-  glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(float), nullptr);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, kVertexStride,
+                        (GLvoid *)(4 * sizeof(float)));  // NOLINT
+  glEnableVertexAttribArray(1);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+
+  vertex_buffer_generation_ = vertex_buffer_.Generation();
 }
 
 // render line of text
 // -------------------
-void Freetype::RenderText(const glm::mat4& orthographic_projection, const std::string& text,
+void Freetype::RenderText(const glm::mat4 &orthographic_projection, const std::string &text,
                           float x, float y, glm::vec3 color) {
-  const float scale = 1.0F;
+  AddText(text, x, y, color);
+  Flush(orthographic_projection);
+}
+
+void Freetype::AddText(const std::string &text, float x, float y, glm::vec3 color) {
+  quads_.clear();
+  atlas_->LayoutText(text, quads_);
+
+  const float r = color.r;
+  const float g = color.g;
+  const float b = color.b;
+  for (const GlyphAtlas::GlyphQuad &quad : quads_) {
+    const float x0 = x + quad.min.x;
+    const float y0 = y + quad.min.y;
+    const float x1 = x + quad.max.x;
+    const float y1 = y + quad.max.y;
+    const float s0 = quad.tex_min.x;
+    const float t0 = quad.tex_min.y;
+    const float s1 = quad.tex_max.x;
+    const float t1 = quad.tex_max.y;
+    // clang-format off
+    vertices_.insert(vertices_.end(), {
+        x0, y1, s0, t0, r, g, b,
+        x0, y0, s0, t1, r, g, b,
+        x1, y0, s1, t1, r, g, b,
+
+        x0, y1, s0, t0, r, g, b,
+        x1, y0, s1, t1, r, g, b,
+        x1, y1, s1, t0, r, g, b});
+    // clang-format on
+  }
+}
+
+void Freetype::Flush(const glm::mat4 &orthographic_projection) {
+  const Profiler::GpuScope gpu_scope("Freetype::Flush");
+  if (vertices_.empty()) {
+    return;
+  }
+  const auto num_vertices = static_cast<GLsizei>(vertices_.size() / 7);
+  const GLint first = vertex_buffer_.Upload(vertices_.data(), num_vertices);
+  vertices_.clear();
+  if (vertex_buffer_.Generation() != vertex_buffer_generation_) {
+    SetupVertexAttributes();
+  }
 
   // activate corresponding render state
   shader_.UseProgram();
 
   // projection transformation
-  shader_.UniformMatrix4fv("projection", orthographic_projection);
+  projection_uniform_.Set(orthographic_projection);
 
-  shader_.Uniform3f("textColor", color.r, color.g, color.b);
-  glActiveTexture(GL_TEXTURE0);
-  glBindVertexArray(vao_);
+  GlState::Get().BindTexture(0, GL_TEXTURE_2D, atlas_->Texture());
+  GlState::Get().BindVertexArray(vao_);
 
   // enable blending, disable antialiasing
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glDisable(GL_POLYGON_SMOOTH);
-
-  // iterate through all characters
-  for (char c : text) {
-    Character ch = characters_[c];
-
-    float xpos = x + static_cast<float>(ch.Bearing.x) * scale;
-    float ypos = y - static_cast<float>(ch.Size.y - ch.Bearing.y) * scale;
+  GlState::Get().SetEnabled(GL_BLEND, true);
+  GlState::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  GlState::Get().SetEnabled(GL_POLYGON_SMOOTH, false);
 
-    float w = static_cast<float>(ch.Size.x) * scale;
-    float h = static_cast<float>(ch.Size.y) * scale;
-    // update VBO for each character
-    // clang-format off
-    float vertices[6][4] = { // NOLINT
-        { xpos,     ypos + h,   0.0F, 0.0F },
-        { xpos,     ypos,       0.0F, 1.0F },
-        { xpos + w, ypos,       1.0F, 1.0F },
-
-        { xpos,     ypos + h,   0.0F, 0.0F },
-        { xpos + w, ypos,       1.0F, 1.0F },
-        { xpos + w, ypos + h,   1.0F, 0.0F }
-    };
-    // clang-format on
-    // render glyph texture over quad
-    glBindTexture(GL_TEXTURE_2D, ch.TextureID);
-    // update content of VBO memory
-    glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-    glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(vertices),
-                    &(vertices[0][0]));  // be sure to use glBufferSubData and not glBufferData
-
-    glBindBuffer(GL_ARRAY_BUFFER, 0);
-    // render quad
-    glDrawArrays(GL_TRIANGLES, 0, 6);
-    // now advance cursors for next glyph (note that advance is number of 1/64 pixels)
-    // NOLINTNEXTLINE(hicpp-signed-bitwise)
-    x += static_cast<float>(ch.Advance >> 6) *
-         scale;  // bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels
-                 // by 64 to get amount of pixels))
-  }
-  glBindVertexArray(0);
-  glBindTexture(GL_TEXTURE_2D, 0);
+  // every queued glyph in one draw call
+  glDrawArrays(GL_TRIANGLES, first, num_vertices);
+  GlState::Get().CountDraws(1);
 }
 
 };  // namespace bb3d
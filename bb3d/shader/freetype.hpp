@@ -1,36 +1,51 @@
 #pragma once
 
-#include <GL/glew.h>  // for GLchar, GLuint
+#include <GL/glew.h>  // for GLuint
 
-#include <glm/glm.hpp>  // for vec3
-#include <map>          // for map
+#include <glm/glm.hpp>  // for vec3, mat4
+#include <memory>       // for shared_ptr
 #include <string>       // for string
+#include <vector>       // for vector
 
-#include "bb3d/shader/shader.hpp"  // for GLFWwindow, Shader
+#include "bb3d/shader/glyph_atlas.hpp"  // for GlyphAtlas
+#include "bb3d/shader/shader.hpp"       // for GLFWwindow, Shader, Uniform
+#include "bb3d/streaming_buffer.hpp"    // for StreamingBuffer, UploadMode
 
 namespace bb3d {
 
+// Text rendered from a GlyphAtlas holding the first 128 ASCII glyphs. Quads are queued
+// with AddText and drawn by Flush with one draw call, so a whole frame of text can go out at once.
 class Freetype {
  public:
-  explicit Freetype(int font_size);
-  ~Freetype() = default;
-  void RenderText(const glm::mat4& orthographic_projection, const std::string& text, float x,
+  explicit Freetype(int font_size, UploadMode upload_mode = UploadMode::kBufferSubData);
+  // Draw with an atlas shared with other text drawables, e.g. Labels.
+  explicit Freetype(std::shared_ptr<const GlyphAtlas> atlas,
+                    UploadMode upload_mode = UploadMode::kBufferSubData);
+  ~Freetype();
+  Freetype(const Freetype &) = delete;
+  Freetype &operator=(const Freetype &) = delete;
+
+  // AddText followed by Flush.
+  void RenderText(const glm::mat4 &orthographic_projection, const std::string &text, float x,
                   float y, glm::vec3 color);
+  // Queue a line of text with its baseline starting at (x, y), in pixels.
+  void AddText(const std::string &text, float x, float y, glm::vec3 color);
+  // Draw everything queued since the last Flush.
+  void Flush(const glm::mat4 &orthographic_projection);
+
+  [[nodiscard]] const std::shared_ptr<const GlyphAtlas> &Atlas() const { return atlas_; }
 
  private:
+  void SetupVertexAttributes();
+
+  std::shared_ptr<const GlyphAtlas> atlas_;
   Shader shader_;
+  Uniform<glm::mat4> projection_uniform_;
   GLuint vao_{};
-  GLuint vbo_{};
-
-  // Holds all state information relevant to a character as loaded using FreeType
-  struct Character {
-    unsigned int TextureID;  // ID handle of the glyph texture
-    glm::ivec2 Size;         // Size of glyph
-    glm::ivec2 Bearing;      // Offset from baseline to left/top of glyph
-    unsigned int Advance;    // Horizontal offset to advance to next glyph
-  };
-
-  std::map<GLchar, Character> characters_;
+  StreamingBuffer vertex_buffer_;
+  int vertex_buffer_generation_ = -1;
+  std::vector<float> vertices_;               // x, y, s, t, r, g, b per vertex, queued by AddText
+  std::vector<GlyphAtlas::GlyphQuad> quads_;  // reused by AddText
 };
 
 };  // namespace bb3d
@@ -1,11 +1,16 @@
 #version 400 core
 layout (location = 0) in vec4 vertex; // <vec2 pos, vec2 tex>
+layout (location = 1) in vec3 color;
 out vec2 TexCoords;
+out vec3 TextColor;
 
+// Not the Camera block: screen text is drawn with the orthographic projection passed to
+// Freetype::Flush, in window pixels, rather than with the camera's view and proj.
 uniform mat4 projection;
 
 void main()
 {
   gl_Position = projection * vec4(vertex.xy, 0.0, 1.0);
   TexCoords = vertex.zw;
+  TextColor = color;
 }
@@ -0,0 +1,164 @@
+#include "glyph_atlas.hpp"
+
+#include <GL/glew.h>            // for glTexParameteri, GL_TEXTURE_2D, glTexImage2D, glGenTextures
+#include <ft2build.h>
+#include <freetype/freetype.h>  // for FT_FaceRec_, FT_GlyphSlotRec_, FT_Done_Face, FT_Done_F...
+#include <freetype/ftimage.h>   // for FT_Bitmap, FT_Vector
+
+#include <algorithm>    // for max
+#include <array>        // for array
+#include <cstddef>      // for size_t, ptrdiff_t
+#include <cstdlib>      // for EXIT_FAILURE
+#include <cstring>      // for memcpy
+#include <glm/glm.hpp>  // for ivec2, vec2
+#include <iostream>     // for operator<<, endl, basic_ostream, cerr, ostream
+#include <string>       // for basic_string, allocator, string, operator<<, char_traits
+#include <vector>       // for vector
+
+#include "bb3d/assert.hpp"    // for exit_thread_safe
+#include "bb3d/gl_state.hpp"  // for GlState
+
+namespace bb3d {
+
+namespace {
+constexpr int kAtlasWidth = 1024;
+constexpr int kGlyphPadding = 1;  // empty texels between glyphs so linear filtering doesn't bleed
+
+// A glyph bitmap copied out of FreeType's glyph slot, which is reused by every FT_Load_Char.
+struct GlyphBitmap {
+  int width = 0;
+  int rows = 0;
+  std::vector<unsigned char> pixels;
+};
+};  // namespace
+
+GlyphAtlas::GlyphAtlas(int font_size) {
+  // FreeType
+  // --------
+  FT_Library ft = nullptr;
+  // All functions return a value different than 0 whenever an error occurred
+  if (FT_Init_FreeType(&ft) != 0) {
+    std::cerr << "ERROR::FREETYPE: Could not init FreeType Library" << std::endl;
+    exit_thread_safe(EXIT_FAILURE);
+  }
+
+  // find path to font
+  // load font as face
+  // std::string font_path = "/usr/share/fonts/truetype/freefont/FreeMono.ttf";
+  std::string font_path = "/usr/share/fonts/truetype/ubuntu/UbuntuMono-R.ttf";
+  // std::string font_path = "/usr/share/fonts/truetype/freefont/FreeSerif.ttf";
+  FT_Face face = nullptr;
+  if (FT_New_Face(ft, font_path.c_str(), 0, &face) != 0) {
+    std::cerr << "ERROR::FREETYPE: Failed to load '" << font_path << "'." << std::endl;
+    exit_thread_safe(EXIT_FAILURE);
+  }
+  // set size to load glyphs as
+  FT_Set_Pixel_Sizes(face, 0, font_size);
+
+  // Load the first 128 characters of the ASCII set and pack them into shelves: left to right, and
+  // a new shelf below the tallest glyph of the current one when a glyph doesn't fit.
+  std::array<GlyphBitmap, 128> bitmaps{};
+  std::array<glm::ivec2, 128> origins{};
+  int shelf_x = kGlyphPadding;
+  int shelf_y = kGlyphPadding;
+  int shelf_height = 0;
+  for (unsigned char c = 0; c < 128; c++) {
+    // Load character glyph
+    // NOLINTNEXTLINE(hicpp-signed-bitwise)
+    if (FT_Load_Char(face, c, FT_LOAD_RENDER) != 0) {
+      std::cerr << "ERROR::FREETYTPE: Failed to load Glyph" << std::endl;
+      continue;
+    }
+    const FT_Bitmap &bitmap = face->glyph->bitmap;
+    GlyphBitmap &glyph = bitmaps[c];
+    glyph.width = static_cast<int>(bitmap.width);
+    glyph.rows = static_cast<int>(bitmap.rows);
+    glyph.pixels.resize(static_cast<size_t>(glyph.width) * static_cast<size_t>(glyph.rows));
+    for (int row = 0; row < glyph.rows; row++) {
+      memcpy(glyph.pixels.data() + static_cast<ptrdiff_t>(row * glyph.width),
+             bitmap.buffer + static_cast<ptrdiff_t>(row) * bitmap.pitch,
+             static_cast<size_t>(glyph.width));
+    }
+
+    if (shelf_x + glyph.width + kGlyphPadding > kAtlasWidth) {
+      shelf_x = kGlyphPadding;
+      shelf_y += shelf_height + kGlyphPadding;
+      shelf_height = 0;
+    }
+    origins[c] = glm::ivec2(shelf_x, shelf_y);
+    shelf_x += glyph.width + kGlyphPadding;
+    shelf_height = std::max(shelf_height, glyph.rows);
+
+    characters_[c] = {glm::vec2(0, 0), glm::vec2(0, 0), glm::ivec2(glyph.width, glyph.rows),
+                      glm::ivec2(face->glyph->bitmap_left, face->glyph->bitmap_top),
+                      static_cast<unsigned int>(face->glyph->advance.x)};
+  }
+  const int atlas_height = shelf_y + shelf_height + kGlyphPadding;
+
+  // destroy FreeType once we're finished
+  FT_Done_Face(face);
+  FT_Done_FreeType(ft);
+
+  // Blit the glyphs into the atlas.
+  std::vector<unsigned char> atlas(static_cast<size_t>(kAtlasWidth) *
+                                   static_cast<size_t>(atlas_height));
+  for (size_t c = 0; c < bitmaps.size(); c++) {
+    const GlyphBitmap &glyph = bitmaps[c];
+    const glm::ivec2 origin = origins[c];
+    for (int row = 0; row < glyph.rows; row++) {
+      const size_t offset = static_cast<size_t>((origin.y + row) * kAtlasWidth + origin.x);
+      memcpy(&atlas[offset], glyph.pixels.data() + static_cast<ptrdiff_t>(row * glyph.width),
+             static_cast<size_t>(glyph.width));
+    }
+    const glm::vec2 atlas_size(kAtlasWidth, atlas_height);
+    characters_[c].TexMin = glm::vec2(origin) / atlas_size;
+    characters_[c].TexMax = glm::vec2(origin + glm::ivec2(glyph.width, glyph.rows)) / atlas_size;
+  }
+
+  // disable byte-alignment restriction
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  glGenTextures(1, &texture_);
+  GlState::Get().BindTexture(0, GL_TEXTURE_2D, texture_);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RED, kAtlasWidth, atlas_height, 0, GL_RED, GL_UNSIGNED_BYTE,
+               atlas.data());
+  // set texture options, glyphs are drawn at their native size so there are no mipmaps
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+}
+
+GlyphAtlas::~GlyphAtlas() {
+  glDeleteTextures(1, &texture_);
+  GlState::Get().Invalidate();
+}
+
+void GlyphAtlas::LayoutText(const std::string &text, std::vector<GlyphQuad> &quads) const {
+  const float scale = 1.0F;
+
+  // iterate through all characters
+  float x = 0;
+  for (const char c : text) {
+    const auto index = static_cast<unsigned char>(c);
+    if (index >= characters_.size()) {
+      continue;
+    }
+    const Character &ch = characters_[index];
+
+    const float xpos = x + static_cast<float>(ch.Bearing.x) * scale;
+    const float ypos = -static_cast<float>(ch.Size.y - ch.Bearing.y) * scale;
+
+    const float w = static_cast<float>(ch.Size.x) * scale;
+    const float h = static_cast<float>(ch.Size.y) * scale;
+    quads.push_back({glm::vec2(xpos, ypos), glm::vec2(xpos + w, ypos + h), ch.TexMin, ch.TexMax});
+
+    // now advance cursors for next glyph (note that advance is number of 1/64 pixels)
+    // NOLINTNEXTLINE(hicpp-signed-bitwise)
+    x += static_cast<float>(ch.Advance >> 6) *
+         scale;  // bitshift by 6 to get value in pixels (2^6 = 64 (divide amount of 1/64th pixels
+                 // by 64 to get amount of pixels))
+  }
+}
+
+};  // namespace bb3d
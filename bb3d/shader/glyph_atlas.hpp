@@ -0,0 +1,46 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLuint
+
+#include <array>        // for array
+#include <glm/glm.hpp>  // for vec2, ivec2
+#include <string>       // for string
+#include <vector>       // for vector
+
+namespace bb3d {
+
+// The first 128 ASCII glyphs of a font, rasterized by FreeType at one pixel size and packed into a
+// single GL_RED texture. Freetype and Labels lay their text out with it, and can share one atlas.
+class GlyphAtlas {
+ public:
+  explicit GlyphAtlas(int font_size);
+  ~GlyphAtlas();
+  GlyphAtlas(const GlyphAtlas &) = delete;
+  GlyphAtlas &operator=(const GlyphAtlas &) = delete;
+
+  // One glyph of a line of text, in pixels relative to the start of the line's baseline.
+  struct GlyphQuad {
+    glm::vec2 min;      // bottom left corner
+    glm::vec2 max;      // top right corner
+    glm::vec2 tex_min;  // atlas texture coordinates at the top left corner
+    glm::vec2 tex_max;  // atlas texture coordinates at the bottom right corner
+  };
+  // Append the quads of `text` to `quads`.
+  void LayoutText(const std::string &text, std::vector<GlyphQuad> &quads) const;
+  [[nodiscard]] GLuint Texture() const { return texture_; }
+
+ private:
+  // Holds all state information relevant to a character as loaded using FreeType
+  struct Character {
+    glm::vec2 TexMin;      // Atlas texture coordinates of the glyph's top left corner
+    glm::vec2 TexMax;      // Atlas texture coordinates of the glyph's bottom right corner
+    glm::ivec2 Size;       // Size of glyph
+    glm::ivec2 Bearing;    // Offset from baseline to left/top of glyph
+    unsigned int Advance;  // Horizontal offset to advance to next glyph
+  };
+
+  GLuint texture_{};
+  std::array<Character, 128> characters_{};
+};
+
+};  // namespace bb3d
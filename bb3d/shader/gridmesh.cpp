@@ -3,50 +3,63 @@
 #include <GL/glew.h>    // for GLuint, glTexParameteri, GL_TEXTURE_2D, GL_ARRAY_BUFFER
 #include <SOIL/SOIL.h>  // for SOIL_free_image_data, SOIL_last_result, SOIL_load_image
 
+#include <cstddef>             // for size_t
 #include <cstdio>              // for fprintf, stderr
 #include <cstdlib>             // for exit, EXIT_FAILURE
 #include <ext/alloc_traits.h>  // for __alloc_traits<>::value_type
+#include <memory>              // for make_unique
 #include <vector>              // for vector
 
-#include "bb3d/assert.hpp"  // for ASSERT
-#include "bb3d/opengl_context.hpp"
+#include "bb3d/assert.hpp"                  // for ASSERT
+#include "bb3d/culling.hpp"                 // for Frustum, Aabb, GridTiles
+#include "bb3d/dirty_runs.hpp"              // for ForEachDirtyRun
+#include "bb3d/gl_state.hpp"                // for GlState
+#include "bb3d/profiler.hpp"                // for Profiler
+#include "bb3d/redraw.hpp"                  // for RequestRedraw
+#include "bb3d/shader/camera_uniforms.hpp"  // for CameraUniforms
 
 namespace bb3d {
 
 Gridmesh::Gridmesh(const std::string &image_path)
-    : shader_(Window::GetBazelRlocation("bb3d/shader/gridmesh.vs"),
-              Window::GetBazelRlocation("bb3d/shader/gridmesh.fs")),
+    : shader_("bb3d/shader/gridmesh.vs", "bb3d/shader/gridmesh.fs"),
+      heightmap_mode_uniform_(shader_.GetUniform<int>("heightmap_mode")),
+      rows_uniform_(shader_.GetUniform<int>("rows")),
+      cols_uniform_(shader_.GetUniform<int>("cols")),
+      grid_min_uniform_(shader_.GetUniform<glm::vec2>("grid_min")),
+      grid_max_uniform_(shader_.GetUniform<glm::vec2>("grid_max")),
       num_indices_(0),
-      vertex_buffer_size_(0),
-      index_buffer_size_(0) {
+      previous_grid_() {
 
   // set up vertex data (and buffer(s)) and configure vertex attributes
   // ------------------------------------------------------------------
   glGenVertexArrays(1, &vao_);
-  glGenBuffers(1, &vbo_);
+  glGenBuffers(1, &position_vbo_);
+  glGenBuffers(1, &texcoord_vbo_);
   glGenBuffers(1, &ebo_);
   // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure
   // vertex attributes(s).
-  glBindVertexArray(vao_);
+  GlState::Get().BindVertexArray(vao_);
 
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-  glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size_, nullptr, GL_DYNAMIC_DRAW);
-
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_size_, nullptr, GL_DYNAMIC_DRAW);
-
-  shader_.VertexAttribPointer("position", 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
-                              (void *)(0 * sizeof(GLfloat)));  // NOLINT
+  // Positions and texture coordinates live in separate buffers so that the texture coordinates
+  // don't have to be re-uploaded along with the positions.
+  glBindBuffer(GL_ARRAY_BUFFER, position_vbo_);
+  glBufferData(GL_ARRAY_BUFFER, position_buffer_size_, nullptr, GL_DYNAMIC_DRAW);
+  shader_.VertexAttribPointer("position", 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
   glEnableVertexAttribArray(0);
 
-  shader_.VertexAttribPointer("texture_coordinate", 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float),
-                              (void *)(3 * sizeof(GLfloat)));  // NOLINT
+  glBindBuffer(GL_ARRAY_BUFFER, texcoord_vbo_);
+  glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+  shader_.VertexAttribPointer("texture_coordinate", 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float),
+                              nullptr);
   glEnableVertexAttribArray(1);
 
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+
   // load and create a texture
   // -------------------------
   glGenTextures(1, &texture_);
-  glBindTexture(GL_TEXTURE_2D, texture_);
+  GlState::Get().BindTexture(0, GL_TEXTURE_2D, texture_);
 
   // set texture wrapping parameters
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
@@ -69,9 +82,18 @@ Gridmesh::Gridmesh(const std::string &image_path)
   glGenerateMipmap(GL_TEXTURE_2D);
   SOIL_free_image_data(image);
 
-  // set image texture
+  // heights for heightmap mode, read with texelFetch
+  glGenTextures(1, &heights_texture_);
+  GlState::Get().BindTexture(0, GL_TEXTURE_2D, heights_texture_);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  // set image and height textures
   shader_.UseProgram();
   shader_.Uniform1i("image_texture", 0);
+  shader_.Uniform1i("heights", 1);
 
   // note that this is allowed, the call to glVertexAttribPointer registered VBO as the vertex
   // attribute's bound vertex buffer object so afterwards we can safely unbind
@@ -80,62 +102,306 @@ Gridmesh::Gridmesh(const std::string &image_path)
   // remember: do NOT unbind the EBO while a VAO is active as the bound element buffer object IS
   // stored in the VAO; keep the EBO bound.
   // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
-
-  // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but
-  // this rarely happens. Modifying other VAOs requires a call to glBindVertexArray anyways so we
-  // generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-  glBindVertexArray(0);
 }
 
 void Gridmesh::Draw(const glm::mat4 &view, const glm::mat4 &proj) {
+  CameraUniforms::Get().SetViewProj(view, proj);
+  Draw();
+}
+
+void Gridmesh::Draw() {
+  const Profiler::GpuScope gpu_scope("Gridmesh::Draw");
   // bind textures
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, texture_);
+  GlState::Get().BindTexture(0, GL_TEXTURE_2D, texture_);
+  if (heightmap_mode_) {
+    GlState::Get().BindTexture(1, GL_TEXTURE_2D, heights_texture_);
+  }
 
   // render
   shader_.UseProgram();
-  glBindVertexArray(vao_);
-
-  // Set up transformations
-  shader_.UniformMatrix4fv("view", view);
-  shader_.UniformMatrix4fv("proj", proj);
+  GlState::Get().BindVertexArray(vao_);
+
+  // The program may be shared with other Gridmeshes, so these are set every Draw.
+  heightmap_mode_uniform_.Set(heightmap_mode_ ? 1 : 0);
+  if (heightmap_mode_) {
+    rows_uniform_.Set(heights_rows_);
+    cols_uniform_.Set(heights_cols_);
+    grid_min_uniform_.Set(heightmap_min_);
+    grid_max_uniform_.Set(heightmap_max_);
+  }
 
   // disable blending and polygon antialiasing
-  glDisable(GL_BLEND);
-  glDisable(GL_POLYGON_SMOOTH);
+  GlState::Get().SetEnabled(GL_BLEND, false);
+  GlState::Get().SetEnabled(GL_POLYGON_SMOOTH, false);
 
   // Draw triangles
-  glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_INT, nullptr);
+  if (frustum_culling_) {
+    // Quad k is indices [6 * k, 6 * (k + 1)).
+    visible_counts_.clear();
+    visible_offsets_.clear();
+    cull_stats_ = tiles_.ForEachVisibleRange(Frustum::FromCamera(), [&](int begin, int end) {
+      visible_counts_.push_back(6 * (end - begin));
+      visible_offsets_.push_back(
+          reinterpret_cast<const void *>(6 * sizeof(GLuint) * static_cast<size_t>(begin)));
+    });
+    if (visible_counts_.empty()) {
+      return;
+    }
+    glMultiDrawElements(GL_TRIANGLES, visible_counts_.data(), GL_UNSIGNED_INT,
+                        visible_offsets_.data(), static_cast<GLsizei>(visible_counts_.size()));
+    GlState::Get().CountDraws(1);
+  } else {
+    cull_stats_ = {tiles_.NumTiles(), 0};
+    glDrawElements(GL_TRIANGLES, num_indices_, GL_UNSIGNED_INT, nullptr);
+    GlState::Get().CountDraws(1);
+  }
+}
+
+void Gridmesh::DrawIds(const uint32_t object_id) {
+  const Profiler::GpuScope gpu_scope("Gridmesh::DrawIds");
+  if (pick_shader_ == nullptr) {
+    pick_shader_ =
+        std::make_unique<Shader>("bb3d/shader/gridmesh.vs", "bb3d/shader/pick_primitive.fs");
+    pick_shader_->UseProgram();
+    pick_shader_->Uniform1i("heights", 1);
+    pick_heightmap_mode_uniform_ = pick_shader_->GetUniform<int>("heightmap_mode");
+    pick_rows_uniform_ = pick_shader_->GetUniform<int>("rows");
+    pick_cols_uniform_ = pick_shader_->GetUniform<int>("cols");
+    pick_grid_min_uniform_ = pick_shader_->GetUniform<glm::vec2>("grid_min");
+    pick_grid_max_uniform_ = pick_shader_->GetUniform<glm::vec2>("grid_max");
+    pick_object_id_uniform_ = pick_shader_->GetUniform<int>("object_id");
+    pick_primitives_per_pick_uniform_ = pick_shader_->GetUniform<int>("primitives_per_pick");
+    pick_first_primitive_uniform_ = pick_shader_->GetUniform<int>("first_primitive");
+  }
+  if (heightmap_mode_) {
+    GlState::Get().BindTexture(1, GL_TEXTURE_2D, heights_texture_);
+  }
 
-  // unbind vao
-  glBindVertexArray(0);
+  pick_shader_->UseProgram();
+  GlState::Get().BindVertexArray(vao_);
+
+  // The program is shared with other Gridmeshes, so these are set every DrawIds.
+  pick_heightmap_mode_uniform_.Set(heightmap_mode_ ? 1 : 0);
+  if (heightmap_mode_) {
+    pick_rows_uniform_.Set(heights_rows_);
+    pick_cols_uniform_.Set(heights_cols_);
+    pick_grid_min_uniform_.Set(heightmap_min_);
+    pick_grid_max_uniform_.Set(heightmap_max_);
+  }
+  pick_object_id_uniform_.Set(static_cast<int>(object_id));
+  pick_primitives_per_pick_uniform_.Set(2);
+
+  // Quad k is triangles 2 * k and 2 * k + 1. gl_PrimitiveID restarts with every draw call, so each
+  // visible range is its own draw.
+  const auto draw_quads = [&](int begin, int end) {
+    pick_first_primitive_uniform_.Set(2 * begin);
+    glDrawElements(GL_TRIANGLES, 6 * (end - begin), GL_UNSIGNED_INT,
+                   reinterpret_cast<const void *>(6 * sizeof(GLuint) * static_cast<size_t>(begin)));
+    GlState::Get().CountDraws(1);
+  };
+  if (frustum_culling_) {
+    tiles_.ForEachVisibleRange(Frustum::FromCamera(), draw_quads);
+  } else {
+    draw_quads(0, num_indices_ / 6);
+  }
+}
+
+PickedCell Gridmesh::DecodePick(const uint32_t primitive_id) const {
+  // Quads are numbered ku * (cols - 1) + kv, see UpdateTopology.
+  const int quad = static_cast<int>(primitive_id);
+  return {quad / (topology_cols_ - 1), quad % (topology_cols_ - 1)};
 }
 
 void Gridmesh::Update(const Eigen::Matrix<glm::vec3, Eigen::Dynamic, Eigen::Dynamic> &grid) {
+  const Profiler::GpuScope gpu_scope("Gridmesh::Update");
+  RequestRedraw();
   const int rows = static_cast<int>(grid.rows());  // readability below
   const int cols = static_cast<int>(grid.cols());  // readability below
 
   ASSERT(rows >= 2);
   ASSERT(cols >= 2);
 
-  // Massage the data.
-  std::vector<float> vertices;
-  for (int ku = 0; ku < rows; ku++) {
+  uploaded_bytes_ = 0;
+  if (rows != topology_rows_ || cols != topology_cols_) {
+    UpdateTopology(rows, cols);
+  }
+  // The tile bounds were computed from the heightmap, so they can't be grown by a diff update.
+  const bool was_heightmap_mode = heightmap_mode_;
+  SetHeightmapMode(false);
+
+  // Vertices are numbered in the matrix's own (column-major) storage order, so the positions can
+  // be uploaded straight from it.
+  static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be tightly packed");
+  const auto position_buffer_size =
+      static_cast<GLint>(sizeof(glm::vec3) * static_cast<size_t>(grid.size()));
+
+  glBindBuffer(GL_ARRAY_BUFFER, position_vbo_);
+  if (diff_updates_ && !was_heightmap_mode && previous_grid_.rows() == rows &&
+      previous_grid_.cols() == cols && position_buffer_size == position_buffer_size_) {
+    // Each column of the grid is contiguous in the buffer, upload the runs which changed.
+    const int max_gap = 64;
+    for (int kv = 0; kv < cols; kv++) {
+      ForEachDirtyRun(
+          rows, max_gap, [&](int ku) { return grid(ku, kv) != previous_grid_(ku, kv); },
+          [&](int ku_begin, int ku_end) {
+            const auto offset = static_cast<GLintptr>(sizeof(glm::vec3)) * (ku_begin + kv * rows);
+            const auto size = static_cast<GLsizeiptr>(sizeof(glm::vec3)) * (ku_end - ku_begin);
+            glBufferSubData(GL_ARRAY_BUFFER, offset, size, &grid(ku_begin, kv));
+            for (int ku = ku_begin; ku < ku_end; ku++) {
+              previous_grid_(ku, kv) = grid(ku, kv);
+              ExtendBounds(ku, kv, grid(ku, kv));
+            }
+            uploaded_bytes_ += static_cast<size_t>(size);
+          });
+    }
+  } else {
+    if (position_buffer_size == position_buffer_size_) {
+      glBufferSubData(GL_ARRAY_BUFFER, 0, position_buffer_size, grid.data());
+    } else {
+      glBufferData(GL_ARRAY_BUFFER, position_buffer_size, grid.data(), GL_DYNAMIC_DRAW);
+      position_buffer_size_ = position_buffer_size;
+    }
+    uploaded_bytes_ += static_cast<size_t>(position_buffer_size);
+    if (diff_updates_) {
+      previous_grid_ = grid;
+    }
+    tiles_.Reset(rows - 1, cols - 1);
     for (int kv = 0; kv < cols; kv++) {
+      for (int ku = 0; ku < rows; ku++) {
+        ExtendBounds(ku, kv, grid(ku, kv));
+      }
+    }
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void Gridmesh::UpdateHeightmap(const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> &heights,
+                               const float min_x, const float max_x, const float min_y,
+                               const float max_y) {
+  const Profiler::GpuScope gpu_scope("Gridmesh::UpdateHeightmap");
+  RequestRedraw();
+  const int rows = static_cast<int>(heights.rows());  // readability below
+  const int cols = static_cast<int>(heights.cols());  // readability below
+
+  ASSERT(rows >= 2);
+  ASSERT(cols >= 2);
+
+  uploaded_bytes_ = 0;
+  if (rows != topology_rows_ || cols != topology_cols_) {
+    UpdateTopology(rows, cols);
+  }
+  SetHeightmapMode(true);
+
+  // Texel (ku, kv) is height (ku, kv). Eigen's column-major storage is already in that order.
+  GlState::Get().BindTexture(0, GL_TEXTURE_2D, heights_texture_);
+  if (rows == heights_rows_ && cols == heights_cols_) {
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, rows, cols, GL_RED, GL_FLOAT, heights.data());
+  } else {
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, rows, cols, 0, GL_RED, GL_FLOAT, heights.data());
+    heights_rows_ = rows;
+    heights_cols_ = cols;
+  }
+  uploaded_bytes_ += sizeof(float) * static_cast<size_t>(heights.size());
+
+  heightmap_min_ = glm::vec2(min_x, min_y);
+  heightmap_max_ = glm::vec2(max_x, max_y);
+
+  // Grid point positions as placed by the vertex shader.
+  tiles_.Reset(rows - 1, cols - 1);
+  for (int kv = 0; kv < cols; kv++) {
+    const float t = static_cast<float>(kv) / static_cast<float>(cols - 1);
+    for (int ku = 0; ku < rows; ku++) {
+      const float s = static_cast<float>(ku) / static_cast<float>(rows - 1);
+      ExtendBounds(ku, kv, glm::vec3(min_x + s * (max_x - min_x), min_y + t * (max_y - min_y),
+                                     heights(ku, kv)));
+    }
+  }
+}
+
+void Gridmesh::ExtendBounds(const int ku, const int kv, const glm::vec3 &position) {
+  Aabb bounds;
+  bounds.Extend(position);
+  tiles_.ExtendPoint(ku, kv, bounds);
+}
+
+void Gridmesh::SetHeightmapMode(const bool heightmap_mode) {
+  if (heightmap_mode == heightmap_mode_) {
+    return;
+  }
+  heightmap_mode_ = heightmap_mode;
+
+  // In heightmap mode nothing is read from the vertex buffers, which may not even cover the grid.
+  GlState::Get().BindVertexArray(vao_);
+  if (heightmap_mode_) {
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(1);
+  } else {
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+  }
+}
+
+void Gridmesh::UpdateRegion(
+    const int row0, const int col0,
+    const Eigen::Matrix<glm::vec3, Eigen::Dynamic, Eigen::Dynamic> &block) {
+  const Profiler::GpuScope gpu_scope("Gridmesh::UpdateRegion");
+  RequestRedraw();
+  const int rows = topology_rows_;
+  const auto block_rows = static_cast<int>(block.rows());
+  const auto block_cols = static_cast<int>(block.cols());
+  ASSERT(!heightmap_mode_);
+  ASSERT(row0 >= 0 && row0 + block_rows <= topology_rows_);
+  ASSERT(col0 >= 0 && col0 + block_cols <= topology_cols_);
+
+  // One contiguous range per grid column.
+  uploaded_bytes_ = 0;
+  glBindBuffer(GL_ARRAY_BUFFER, position_vbo_);
+  for (int kv = 0; kv < block_cols; kv++) {
+    const auto offset = static_cast<GLintptr>(sizeof(glm::vec3)) * (row0 + (col0 + kv) * rows);
+    const auto size = static_cast<GLsizeiptr>(sizeof(glm::vec3)) * block_rows;
+    glBufferSubData(GL_ARRAY_BUFFER, offset, size, &block(0, kv));
+    uploaded_bytes_ += static_cast<size_t>(size);
+    for (int ku = 0; ku < block_rows; ku++) {
+      ExtendBounds(row0 + ku, col0 + kv, block(ku, kv));
+    }
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  if (diff_updates_ && previous_grid_.rows() == topology_rows_ &&
+      previous_grid_.cols() == topology_cols_) {
+    for (int kv = 0; kv < block_cols; kv++) {
+      for (int ku = 0; ku < block_rows; ku++) {
+        previous_grid_(row0 + ku, col0 + kv) = block(ku, kv);
+      }
+    }
+  }
+}
+
+void Gridmesh::SetDiffUpdates(const bool diff_updates) {
+  diff_updates_ = diff_updates;
+  if (!diff_updates_) {
+    previous_grid_.resize(0, 0);
+  }
+}
+
+void Gridmesh::UpdateTopology(const int rows, const int cols) {
+  // vertex (ku, kv) is number ku + kv * rows
+  std::vector<float> texture_coordinates;
+  for (int kv = 0; kv < cols; kv++) {
+    for (int ku = 0; ku < rows; ku++) {
       const float s = static_cast<float>(ku) / static_cast<float>(rows - 1);
       const float t = static_cast<float>(kv) / static_cast<float>(cols - 1);
-      const glm::vec3 &pos = grid(ku, kv);
-      vertices.insert(vertices.end(), {pos.x, pos.y, pos.z, s, t});
+      texture_coordinates.insert(texture_coordinates.end(), {s, t});
     }
   }
 
   std::vector<GLuint> indices;
   for (int ku = 0; ku < rows - 1; ku++) {
     for (int kv = 0; kv < cols - 1; kv++) {
-      int me = ku * cols + kv;
-      int right = me + 1;
-      int down = (ku + 1) * cols + kv;
-      int corner = down + 1;
+      const auto me = static_cast<GLuint>(ku + kv * rows);
+      const auto right = me + static_cast<GLuint>(rows);
+      const GLuint down = me + 1;
+      const GLuint corner = right + 1;
       // triangle 1
       indices.push_back(me);
       indices.push_back(right);
@@ -147,40 +413,33 @@ void Gridmesh::Update(const Eigen::Matrix<glm::vec3, Eigen::Dynamic, Eigen::Dyna
     }
   }
 
-  const auto num_indices = static_cast<GLint>(indices.size());
-  const auto vertex_buffer_size = static_cast<GLint>(sizeof(vertices[0]) * vertices.size());
+  const auto texcoord_buffer_size =
+      static_cast<GLint>(sizeof(texture_coordinates[0]) * texture_coordinates.size());
   const auto index_buffer_size = static_cast<GLint>(sizeof(indices[0]) * indices.size());
 
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  // The element array binding is VAO state.
+  GlState::Get().BindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, texcoord_vbo_);
+  glBufferData(GL_ARRAY_BUFFER, texcoord_buffer_size, texture_coordinates.data(), GL_STATIC_DRAW);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_);
-
-  if (index_buffer_size == index_buffer_size_) {
-    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, index_buffer_size, indices.data());
-  } else {
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_size, indices.data(), GL_DYNAMIC_DRAW);
-    index_buffer_size_ = index_buffer_size;
-  }
-
-  if (vertex_buffer_size == vertex_buffer_size_) {
-    glBufferSubData(GL_ARRAY_BUFFER, 0, vertex_buffer_size, vertices.data());
-  } else {
-    glBufferData(GL_ARRAY_BUFFER, vertex_buffer_size, vertices.data(), GL_DYNAMIC_DRAW);
-    vertex_buffer_size_ = vertex_buffer_size;
-  }
-
-  if (num_indices != num_indices_) {
-    num_indices_ = num_indices;
-  }
-
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, index_buffer_size, indices.data(), GL_STATIC_DRAW);
   glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  num_indices_ = static_cast<int>(indices.size());
+  topology_rows_ = rows;
+  topology_cols_ = cols;
+  uploaded_bytes_ += static_cast<size_t>(texcoord_buffer_size + index_buffer_size);
 }
 
 Gridmesh::~Gridmesh() {
   // de-allocate all resources once they've outlived their purpose:
   // ------------------------------------------------------------------------
   glDeleteVertexArrays(1, &vao_);
-  glDeleteBuffers(1, &vbo_);
+  glDeleteBuffers(1, &position_vbo_);
+  glDeleteBuffers(1, &texcoord_vbo_);
   glDeleteBuffers(1, &ebo_);
+  glDeleteTextures(1, &heights_texture_);
+  GlState::Get().Invalidate();
 }
 
 };  // namespace bb3d
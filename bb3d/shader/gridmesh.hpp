@@ -2,14 +2,21 @@
 
 #include <GL/glew.h>  // for GLuint, GLint
 
+#include <cstddef>             // for size_t
+#include <cstdint>             // for uint32_t
 #include <eigen3/Eigen/Dense>  // for Matrix, Dynamic, DenseCoeffsBase
+#include <memory>              // for unique_ptr
 #include <string>              // for string
+#include <vector>              // for vector
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
 #include <glm/glm.hpp>  // for mat4, vec3, dvec3
 
-#include "bb3d/shader/shader.hpp"  // for Shader
+#include "bb3d/culling.hpp"        // for CullStats, GridTiles
+#include "bb3d/draw_list.hpp"      // for DrawState, DrawPass
+#include "bb3d/picker.hpp"         // for PickedCell
+#include "bb3d/shader/shader.hpp"  // for Shader, Uniform
 
 namespace bb3d {
 
@@ -18,7 +25,40 @@ struct Gridmesh {
   ~Gridmesh();
 
   void Update(const Eigen::Matrix<glm::vec3, Eigen::Dynamic, Eigen::Dynamic> &grid);
+  // Heightmap mode for regular grids: only the heights are uploaded, as a float texture, and the
+  // vertex shader places grid point (ku, kv) evenly between the bounds, (min_x, min_y) for (0, 0)
+  // and (max_x, max_y) for (rows - 1, cols - 1). The next Update switches back.
+  void UpdateHeightmap(const Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> &heights,
+                       float min_x, float max_x, float min_y, float max_y);
+  // Re-upload only the vertices covered by `block`, whose top left corner is at (row0, col0). The
+  // block has to fit inside the grid given to the last Update.
+  void UpdateRegion(int row0, int col0,
+                    const Eigen::Matrix<glm::vec3, Eigen::Dynamic, Eigen::Dynamic> &block);
+  // When enabled, Update compares the grid against the previous one and only uploads the runs of
+  // vertices which changed. This keeps a CPU-side copy of the grid.
+  void SetDiffUpdates(bool diff_updates);
+  // Draw with the view and projection in CameraUniforms.
+  void Draw();
+  // Same as above after replacing view and proj in the shared camera uniforms, for callers outside
+  // of Window::Run.
   void Draw(const glm::mat4 &view, const glm::mat4 &proj);
+  // The state Draw sets, for sorting in a DrawList.
+  [[nodiscard]] DrawState State() const {
+    return {DrawPass::kOpaque, shader_.ProgramId(), texture_, false};
+  }
+  // Draw object_id and the quad index into a Picker's ID framebuffer instead of the texture.
+  // DecodePick turns the primitive ID of a hit back into a cell.
+  void DrawIds(uint32_t object_id);
+  // Quad (row, col) of a pick drawn by DrawIds, between grid points (row, col) and
+  // (row + 1, col + 1).
+  [[nodiscard]] PickedCell DecodePick(uint32_t primitive_id) const;
+  // Number of bytes the last Update or UpdateRegion sent to the GPU.
+  [[nodiscard]] size_t UploadedBytes() const { return uploaded_bytes_; }
+  // Skip the tiles of quads which are outside of the view (the default). The tile bounds are
+  // computed by Update and UpdateHeightmap; UpdateRegion and diff updates only grow them.
+  void SetFrustumCulling(bool frustum_culling) { frustum_culling_ = frustum_culling; };
+  // Tiles of GridTiles::kTileSize x kTileSize quads drawn and culled by the last Draw.
+  [[nodiscard]] CullStats Culling() const { return cull_stats_; }
   template <int NU, int NV>
   void Update(const Eigen::Matrix<glm::dvec3, NU, NV> &mat) {
     Eigen::Matrix<glm::vec3, Eigen::Dynamic, Eigen::Dynamic> dynamic_mat(NU, NV);
@@ -31,14 +71,53 @@ struct Gridmesh {
   }
 
  private:
+  void UpdateTopology(int rows, int cols);
+  void SetHeightmapMode(bool heightmap_mode);
+  void ExtendBounds(int ku, int kv, const glm::vec3 &position);
+
   Shader shader_;
+  Uniform<int> heightmap_mode_uniform_;
+  Uniform<int> rows_uniform_;
+  Uniform<int> cols_uniform_;
+  Uniform<glm::vec2> grid_min_uniform_;
+  Uniform<glm::vec2> grid_max_uniform_;
+  std::unique_ptr<Shader> pick_shader_{};  // created by the first DrawIds, with these
+  Uniform<int> pick_heightmap_mode_uniform_{};
+  Uniform<int> pick_rows_uniform_{};
+  Uniform<int> pick_cols_uniform_{};
+  Uniform<glm::vec2> pick_grid_min_uniform_{};
+  Uniform<glm::vec2> pick_grid_max_uniform_{};
+  Uniform<int> pick_object_id_uniform_{};
+  Uniform<int> pick_primitives_per_pick_uniform_{};
+  Uniform<int> pick_first_primitive_uniform_{};
   GLuint vao_{};
-  GLuint vbo_{};
-  GLuint ebo_{};
+  GLuint position_vbo_{};  // streamed on every Update
+  GLuint texcoord_vbo_{};  // only depends on the grid shape
+  GLuint ebo_{};           // only depends on the grid shape
   GLuint texture_{};
+  GLuint heights_texture_{};  // R32F, rows x cols
   int num_indices_;
-  GLint vertex_buffer_size_ = 0;
-  GLint index_buffer_size_ = 0;
+  GLint position_buffer_size_ = 0;
+  // shape which the texture coordinates and indices were generated for
+  int topology_rows_ = 0;
+  int topology_cols_ = 0;
+  size_t uploaded_bytes_ = 0;
+
+  bool heightmap_mode_ = false;
+  int heights_rows_ = 0;  // shape of heights_texture_
+  int heights_cols_ = 0;
+  glm::vec2 heightmap_min_{};  // bounds given to the last UpdateHeightmap
+  glm::vec2 heightmap_max_{};
+
+  bool diff_updates_ = false;
+  Eigen::Matrix<glm::vec3, Eigen::Dynamic, Eigen::Dynamic> previous_grid_;
+
+  // Culled by tiles of the (rows - 1) x (cols - 1) quads.
+  bool frustum_culling_ = true;
+  GridTiles tiles_{};
+  CullStats cull_stats_{0, 0};
+  std::vector<GLsizei> visible_counts_{};  // reused by Draw
+  std::vector<const void *> visible_offsets_{};
 };
 
 };  // namespace bb3d
@@ -2,10 +2,32 @@
 layout (location = 0) in vec3 position;
 layout (location = 1) in vec2 texture_coordinate;
 out vec2 texture_coordinate_;
-uniform mat4 view;
-uniform mat4 proj;
+layout (std140) uniform Camera {
+  mat4 view;
+  mat4 proj;
+  vec2 viewport_size;  // pixels
+  float frame_time;    // seconds
+};
+
+// Heightmap mode: the attributes are disabled and the vertex is rebuilt from gl_VertexID, which is
+// ku + kv * rows for grid point (ku, kv), and its height in the R32F texture.
+uniform bool heightmap_mode;
+uniform sampler2D heights;
+uniform int rows;
+uniform int cols;
+uniform vec2 grid_min;
+uniform vec2 grid_max;
+
 void main()
 {
-  texture_coordinate_ = texture_coordinate;
-  gl_Position = proj * view * vec4(position, 1.0);
+  if (heightmap_mode) {
+    ivec2 k = ivec2(gl_VertexID % rows, gl_VertexID / rows);
+    vec2 st = vec2(k) / vec2(rows - 1, cols - 1);
+    float z = texelFetch(heights, k, 0).r;
+    texture_coordinate_ = st;
+    gl_Position = proj * view * vec4(mix(grid_min, grid_max, st), z, 1.0);
+  } else {
+    texture_coordinate_ = texture_coordinate;
+    gl_Position = proj * view * vec4(position, 1.0);
+  }
 }
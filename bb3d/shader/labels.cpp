@@ -0,0 +1,181 @@
+#include "labels.hpp"
+
+#include <GL/glew.h>  // for glGetIntegerv, glMultiDrawArrays, GL_TRIANGLES, GL_VIEWPORT
+
+#include <algorithm>    // for min, max
+#include <array>        // for array
+#include <cstddef>      // for size_t
+#include <glm/glm.hpp>  // for vec2, vec3, vec4, mat4
+#include <limits>       // for numeric_limits
+#include <memory>       // for shared_ptr, make_shared
+#include <string>       // for string
+#include <utility>      // for move
+#include <vector>       // for vector
+
+#include "bb3d/gl_state.hpp"                // for GlState
+#include "bb3d/profiler.hpp"                // for Profiler
+#include "bb3d/redraw.hpp"                  // for RequestRedraw
+#include "bb3d/shader/camera_uniforms.hpp"  // for CameraUniforms
+
+namespace bb3d {
+
+namespace {
+constexpr int kFloatsPerVertex = 10;
+constexpr GLsizei kVertexStride = kFloatsPerVertex * sizeof(float);
+};  // namespace
+
+Labels::Labels(const int font_size, const UploadMode upload_mode)
+    : Labels(std::make_shared<const GlyphAtlas>(font_size), upload_mode) {}
+
+Labels::Labels(std::shared_ptr<const GlyphAtlas> atlas, const UploadMode upload_mode)
+    : atlas_(std::move(atlas)),
+      shader_("bb3d/shader/labels.vs", "bb3d/shader/freetype.fs"),
+      vertex_buffer_(upload_mode, kVertexStride),
+      extents_(),
+      vertices_(),
+      quads_(),
+      draw_firsts_(),
+      draw_counts_() {
+  glGenVertexArrays(1, &vao_);
+  SetupVertexAttributes();
+}
+
+Labels::~Labels() {
+  glDeleteVertexArrays(1, &vao_);
+  GlState::Get().Invalidate();
+}
+
+void Labels::SetupVertexAttributes() {
+  GlState::Get().BindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_.Buffer());
+  // anchor, pixel offset, texture coordinate, color
+  const std::array<GLint, 4> sizes = {3, 2, 2, 3};
+  size_t offset = 0;
+  for (GLuint k = 0; k < sizes.size(); k++) {
+    glVertexAttribPointer(k, sizes[k], GL_FLOAT, GL_FALSE, kVertexStride,
+                          (GLvoid *)(offset * sizeof(float)));  // NOLINT
+    glEnableVertexAttribArray(k);
+    offset += static_cast<size_t>(sizes[k]);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  vertex_buffer_generation_ = vertex_buffer_.Generation();
+}
+
+void Labels::Update(const std::vector<Label> &labels) {
+  const Profiler::GpuScope gpu_scope("Labels::Update");
+  RequestRedraw();
+  vertices_.clear();
+  extents_.clear();
+  for (const Label &label : labels) {
+    quads_.clear();
+    atlas_->LayoutText(label.text, quads_);
+
+    LabelExtent extent = {label.anchor, glm::vec2(std::numeric_limits<float>::max()),
+                          glm::vec2(std::numeric_limits<float>::lowest()),
+                          static_cast<GLint>(vertices_.size() / kFloatsPerVertex),
+                          static_cast<GLint>(6 * quads_.size())};
+    const float ax = label.anchor.x;
+    const float ay = label.anchor.y;
+    const float az = label.anchor.z;
+    const float r = label.color.r;
+    const float g = label.color.g;
+    const float b = label.color.b;
+    for (const GlyphAtlas::GlyphQuad &quad : quads_) {
+      const glm::vec2 min = label.offset + quad.min;
+      const glm::vec2 max = label.offset + quad.max;
+      extent.min = glm::min(extent.min, min);
+      extent.max = glm::max(extent.max, max);
+      const float s0 = quad.tex_min.x;
+      const float t0 = quad.tex_min.y;
+      const float s1 = quad.tex_max.x;
+      const float t1 = quad.tex_max.y;
+      // clang-format off
+      vertices_.insert(vertices_.end(), {
+          ax, ay, az, min.x, max.y, s0, t0, r, g, b,
+          ax, ay, az, min.x, min.y, s0, t1, r, g, b,
+          ax, ay, az, max.x, min.y, s1, t1, r, g, b,
+
+          ax, ay, az, min.x, max.y, s0, t0, r, g, b,
+          ax, ay, az, max.x, min.y, s1, t1, r, g, b,
+          ax, ay, az, max.x, max.y, s1, t0, r, g, b});
+      // clang-format on
+    }
+    if (extent.count > 0) {
+      extents_.push_back(extent);
+    }
+  }
+
+  num_vertices_ = static_cast<GLint>(vertices_.size() / kFloatsPerVertex);
+  first_vertex_ = vertex_buffer_.Upload(vertices_.data(), num_vertices_);
+  if (vertex_buffer_.Generation() != vertex_buffer_generation_) {
+    SetupVertexAttributes();
+  }
+}
+
+void Labels::Draw(const glm::mat4 &view, const glm::mat4 &proj) {
+  CameraUniforms::Get().SetViewProj(view, proj);
+  Draw();
+}
+
+void Labels::Draw() {
+  const Profiler::GpuScope gpu_scope("Labels::Draw");
+  const CameraBlock &camera = CameraUniforms::Get().Block();
+  const glm::vec2 viewport_size = camera.viewport_size;
+
+  // Labels are contiguous in the buffer, so visible neighbours merge into one range.
+  draw_firsts_.clear();
+  draw_counts_.clear();
+  num_drawn_ = 0;
+  if (!culling_) {
+    if (num_vertices_ > 0) {
+      draw_firsts_.push_back(first_vertex_);
+      draw_counts_.push_back(num_vertices_);
+    }
+    num_drawn_ = static_cast<int>(extents_.size());
+  } else {
+    const glm::mat4 proj_view = camera.proj * camera.view;
+    for (const LabelExtent &extent : extents_) {
+      const glm::vec4 clip = proj_view * glm::vec4(extent.anchor, 1.0F);
+      if (clip.w <= 0) {
+        continue;  // behind the camera
+      }
+      // anchor in pixels from the bottom left corner of the viewport
+      const glm::vec2 anchor =
+          (glm::vec2(clip.x, clip.y) / clip.w + glm::vec2(1, 1)) * 0.5F * viewport_size;
+      const glm::vec2 min = anchor + extent.min;
+      const glm::vec2 max = anchor + extent.max;
+      if (max.x < 0 || max.y < 0 || min.x > viewport_size.x || min.y > viewport_size.y) {
+        continue;  // off screen
+      }
+
+      const GLint first = first_vertex_ + extent.first;
+      if (!draw_firsts_.empty() && draw_firsts_.back() + draw_counts_.back() == first) {
+        draw_counts_.back() += extent.count;
+      } else {
+        draw_firsts_.push_back(first);
+        draw_counts_.push_back(extent.count);
+      }
+      num_drawn_++;
+    }
+  }
+  if (draw_firsts_.empty()) {
+    return;
+  }
+
+  shader_.UseProgram();
+
+  GlState::Get().BindTexture(0, GL_TEXTURE_2D, atlas_->Texture());
+  GlState::Get().BindVertexArray(vao_);
+
+  // enable blending, disable antialiasing
+  GlState::Get().SetEnabled(GL_BLEND, true);
+  GlState::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  GlState::Get().SetEnabled(GL_POLYGON_SMOOTH, false);
+
+  glMultiDrawArrays(GL_TRIANGLES, draw_firsts_.data(), draw_counts_.data(),
+                    static_cast<GLsizei>(draw_firsts_.size()));
+  GlState::Get().CountDraws(1);
+}
+
+};  // namespace bb3d
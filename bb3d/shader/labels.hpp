@@ -0,0 +1,83 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLint, GLuint
+
+#include <glm/glm.hpp>  // for mat4, vec2, vec3
+#include <memory>       // for shared_ptr
+#include <string>       // for string
+#include <vector>       // for vector
+
+#include "bb3d/draw_list.hpp"           // for DrawState, DrawPass
+#include "bb3d/shader/glyph_atlas.hpp"  // for GlyphAtlas
+#include "bb3d/shader/shader.hpp"       // for Shader
+#include "bb3d/streaming_buffer.hpp"    // for StreamingBuffer, UploadMode
+
+namespace bb3d {
+
+struct Label {
+  glm::vec3 anchor;  // world position the label is attached to
+  std::string text;
+  glm::vec3 color{1, 1, 1};
+  glm::vec2 offset{0, 0};  // from the anchor to the start of the baseline, in pixels
+};
+
+// Text attached to points in the world. The vertex shader projects each anchor and places the
+// glyphs around it in screen space, so labels always face the camera and keep their pixel size.
+// All labels are drawn with one draw call.
+class Labels {
+ public:
+  explicit Labels(int font_size, UploadMode upload_mode = UploadMode::kBufferSubData);
+  // Draw with an atlas shared with other text drawables, e.g. Freetype::Atlas().
+  explicit Labels(std::shared_ptr<const GlyphAtlas> atlas,
+                  UploadMode upload_mode = UploadMode::kBufferSubData);
+  ~Labels();
+  Labels(const Labels &) = delete;
+  Labels &operator=(const Labels &) = delete;
+
+  void Update(const std::vector<Label> &labels);
+  // Draw with the view, projection and viewport size in CameraUniforms.
+  void Draw();
+  // Same as above after replacing view and proj in the shared camera uniforms, for callers outside
+  // of Window::Run.
+  void Draw(const glm::mat4 &view, const glm::mat4 &proj);
+  // The state Draw sets, for sorting in a DrawList.
+  [[nodiscard]] DrawState State() const {
+    return {DrawPass::kTransparent, shader_.ProgramId(), atlas_->Texture(), true};
+  }
+  // Skip labels whose anchor is behind the camera or which are entirely off screen. This costs a
+  // projection per label on the CPU every Draw.
+  void SetCulling(bool culling) { culling_ = culling; }
+  // Number of labels drawn by the last Draw.
+  [[nodiscard]] int NumDrawn() const { return num_drawn_; }
+
+ private:
+  void SetupVertexAttributes();
+
+  // Where a label's vertices are and how far it extends from its anchor, for culling.
+  struct LabelExtent {
+    glm::vec3 anchor;
+    glm::vec2 min;  // pixels
+    glm::vec2 max;  // pixels
+    GLint first;    // relative to first_vertex_
+    GLint count;
+  };
+
+  std::shared_ptr<const GlyphAtlas> atlas_;
+  Shader shader_;
+  GLuint vao_{};
+  StreamingBuffer vertex_buffer_;
+  int vertex_buffer_generation_ = -1;
+  GLint first_vertex_ = 0;
+  GLint num_vertices_ = 0;
+  bool culling_ = false;
+  int num_drawn_ = 0;
+  std::vector<LabelExtent> extents_;
+
+  // reused to avoid reallocating every frame
+  std::vector<float> vertices_;  // anchor, pixel offset, texture coordinate, color per vertex
+  std::vector<GlyphAtlas::GlyphQuad> quads_;
+  std::vector<GLint> draw_firsts_;
+  std::vector<GLint> draw_counts_;
+};
+
+};  // namespace bb3d
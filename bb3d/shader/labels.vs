@@ -0,0 +1,22 @@
+#version 400 core
+layout (location = 0) in vec3 anchor;
+layout (location = 1) in vec2 pixel_offset;
+layout (location = 2) in vec2 texture_coordinate;
+layout (location = 3) in vec3 color;
+out vec2 TexCoords;
+out vec3 TextColor;
+layout (std140) uniform Camera {
+  mat4 view;
+  mat4 proj;
+  vec2 viewport_size;  // pixels
+  float frame_time;    // seconds
+};
+void main()
+{
+  // Offset in normalized device coordinates, scaled by w to survive the perspective divide.
+  vec4 clip = proj * view * vec4(anchor, 1.0);
+  clip.xy += 2.0 * pixel_offset / viewport_size * clip.w;
+  gl_Position = clip;
+  TexCoords = texture_coordinate;
+  TextColor = color;
+}
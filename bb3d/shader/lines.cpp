@@ -2,27 +2,38 @@
 
 #include <GL/glew.h>  // for GLint, GL_ARRAY_BUFFER, glEnable, glBindBuffer, glBindVertexArray
 
-#include "bb3d/opengl_context.hpp"
+#include <cstddef>  // for size_t
+#include <vector>   // for vector
+
+#include "bb3d/assert.hpp"                  // for ASSERT
+#include "bb3d/culling.hpp"                 // for Frustum, SegmentChunks
+#include "bb3d/gl_state.hpp"                // for GlState
+#include "bb3d/profiler.hpp"                // for Profiler
+#include "bb3d/redraw.hpp"                  // for RequestRedraw
+#include "bb3d/shader/camera_uniforms.hpp"  // for CameraUniforms
 
 namespace bb3d {
 
-Lines::Lines()
-    : shader_(Window::GetBazelRlocation("bb3d/shader/lines.vs"),
-              Window::GetBazelRlocation("bb3d/shader/lines.fs")),
+Lines::Lines(const UploadMode upload_mode)
+    : shader_("bb3d/shader/lines.vs", "bb3d/shader/lines.fs"),
+      color_uniform_(shader_.GetUniform<glm::vec4>("color")),
+      point_size_uniform_(shader_.GetUniform<float>("point_size")),
+      vertex_buffer_(upload_mode, 3 * sizeof(float)),
       segment_sizes_(),
-      current_buffer_size_() {
-  current_buffer_size_ = 0;
-
+      segment_firsts_(),
+      flat_vertices_(),
+      flat_segment_offsets_() {
   // set up vertex data (and buffer(s)) and configure vertex attributes
   // ------------------------------------------------------------------
   glGenVertexArrays(1, &vao_);
-  glGenBuffers(1, &vbo_);
+  SetupVertexAttributes();
+}
 
+void Lines::SetupVertexAttributes() {
   // bind the Vertex Array Object first, then bind and set vertex buffer(s), and then configure
   // vertex attributes(s).
-  glBindVertexArray(vao_);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
-  glBufferData(GL_ARRAY_BUFFER, current_buffer_size_, nullptr, GL_DYNAMIC_DRAW);
+  GlState::Get().BindVertexArray(vao_);
+  glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_.Buffer());
 
   GLint posAttrib = 0;  // layout = 0 above
   glVertexAttribPointer(posAttrib, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), nullptr);
@@ -32,71 +43,97 @@ Lines::Lines()
   // attribute's bound vertex buffer object so afterwards we can safely unbind
   glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-  // You can unbind the VAO afterwards so other VAO calls won't accidentally modify this VAO, but
-  // this rarely happens. Modifying other VAOs requires a call to glBindVertexArray anyways so we
-  // generally don't unbind VAOs (nor VBOs) when it's not directly necessary.
-  glBindVertexArray(0);
+  vertex_buffer_generation_ = vertex_buffer_.Generation();
 }
 
 void Lines::Draw(const glm::mat4 &view, const glm::mat4 &proj, const glm::vec4 &color,
                  const GLenum mode) {
+  CameraUniforms::Get().SetViewProj(view, proj);
+  Draw(color, mode);
+}
+
+void Lines::Draw(const glm::vec4 &color, const GLenum mode) {
+  const Profiler::GpuScope gpu_scope("Lines::Draw");
   // draw triangle
   shader_.UseProgram();
-  glBindVertexArray(vao_);  // seeing as we only have a single VAO there's no need to bind it every
-                            // time, but we'll do so to keep things a bit more organized
+  GlState::Get().BindVertexArray(vao_);
 
-  // Set up transformations
-  shader_.UniformMatrix4fv("view", view);
-  shader_.UniformMatrix4fv("proj", proj);
-
-  shader_.Uniform4f("color", color.r, color.g, color.b, color.a);
-  shader_.Uniform1f("point_size", point_size_);
+  color_uniform_.Set(color);
+  point_size_uniform_.Set(point_size_);
 
   // blend and antialias
-  glEnable(GL_BLEND);
-  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-  glEnable(GL_LINE_SMOOTH);
-  glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
+  GlState::Get().SetEnabled(GL_BLEND, true);
+  GlState::Get().BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  GlState::Get().SetEnabled(GL_LINE_SMOOTH, true);
+
+  const std::vector<GLint> *firsts = &segment_firsts_;
+  const std::vector<GLint> *sizes = &segment_sizes_;
+  if (frustum_culling_) {
+    cull_stats_ = chunks_.Visible(Frustum::FromCamera(), mode, &visible_firsts_, &visible_sizes_);
+    firsts = &visible_firsts_;
+    sizes = &visible_sizes_;
+  } else {
+    cull_stats_ = {chunks_.NumChunks(), 0};
+  }
+  if (sizes->empty()) {
+    return;
+  }
 
-  // Draw lines one segment at a time.
-  GLint offset = 0;
-  for (const GLint segment_size : segment_sizes_) {
-    glDrawArrays(mode, offset, segment_size);
-    offset += segment_size;
+  if (batched_draw_) {
+    // Draw all segments in one call.
+    glMultiDrawArrays(mode, firsts->data(), sizes->data(), static_cast<GLsizei>(sizes->size()));
+    GlState::Get().CountDraws(1);
+  } else {
+    // Draw lines one segment at a time.
+    for (size_t k = 0; k < sizes->size(); k++) {
+      glDrawArrays(mode, (*firsts)[k], (*sizes)[k]);
+      GlState::Get().CountDraws(1);
+    }
   }
 }
 
 void Lines::Update(const std::vector<std::vector<glm::vec3> > &segments) {
-  // Massage the data.
-  // TODO(greg): static assert that std::vector<glm::vec3> is packed and just reinterpret cast
-  std::vector<float> buffer_data;
-  segment_sizes_.resize(0);
+  // Flatten into reused buffers, then upload in one go.
+  flat_vertices_.clear();
+  flat_segment_offsets_.clear();
   for (const std::vector<glm::vec3> &segment : segments) {
-    const auto segment_size = static_cast<GLint>(segment.size());
-    segment_sizes_.push_back(segment_size);
-    for (const glm::vec3 &vertex : segment) {
-      buffer_data.push_back(vertex.x);
-      buffer_data.push_back(vertex.y);
-      buffer_data.push_back(vertex.z);
-    }
+    flat_segment_offsets_.push_back(static_cast<GLint>(flat_vertices_.size()));
+    flat_vertices_.insert(flat_vertices_.end(), segment.begin(), segment.end());
+  }
+  Update(flat_vertices_, flat_segment_offsets_);
+}
+
+void Lines::Update(const Span<glm::vec3> vertices, const Span<GLint> segment_offsets) {
+  const Profiler::GpuScope gpu_scope("Lines::Update");
+  RequestRedraw();
+  const auto num_vertices = static_cast<GLint>(vertices.size());
+
+  segment_sizes_.clear();
+  for (size_t k = 0; k < segment_offsets.size(); k++) {
+    const GLint begin = segment_offsets[k];
+    const GLint end = k + 1 < segment_offsets.size() ? segment_offsets[k + 1] : num_vertices;
+    ASSERT(0 <= begin && begin <= end && end <= num_vertices);
+    segment_sizes_.push_back(end - begin);
   }
+  // Vertices before the first segment are uploaded but never drawn.
+  const GLint skipped = segment_offsets.empty() ? 0 : segment_offsets[0];
 
-  // bind the buffer
-  // glBindVertexArray(vao_);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo_);
+  const GLint upload_first = vertex_buffer_.Upload(vertices.data(), num_vertices);
+  first_vertex_ = upload_first + skipped;
 
-  const auto buffer_size = static_cast<GLint>(sizeof(float) * buffer_data.size());
-  if (buffer_size == current_buffer_size_) {
-    // if the size of data is the same, just update the buffer
-    glBufferSubData(GL_ARRAY_BUFFER, 0, buffer_size, buffer_data.data());
-  } else {
-    // if the size of data has changed, we have to reallocate GPU memory
-    glBufferData(GL_ARRAY_BUFFER, buffer_size, buffer_data.data(), GL_DYNAMIC_DRAW);
-    current_buffer_size_ = buffer_size;
+  segment_firsts_.clear();
+  GLint first = first_vertex_;
+  for (const GLint segment_size : segment_sizes_) {
+    segment_firsts_.push_back(first);
+    first += segment_size;
   }
+  chunks_.Update(segment_firsts_, segment_sizes_, [&](GLint vertex) {
+    return vertices[static_cast<size_t>(vertex - upload_first)];
+  });
 
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  // glBindVertexArray(0);
+  if (vertex_buffer_.Generation() != vertex_buffer_generation_) {
+    SetupVertexAttributes();
+  }
 }
 
 };  // namespace bb3d
@@ -8,26 +8,68 @@
 
 #include <glm/glm.hpp>
 
+#include "bb3d/culling.hpp"
+#include "bb3d/draw_list.hpp"
 #include "bb3d/shader/shader.hpp"
+#include "bb3d/span.hpp"
+#include "bb3d/streaming_buffer.hpp"
 
 namespace bb3d {
 
+// glm::vec3 is uploaded as is.
+static_assert(sizeof(glm::vec3) == 3 * sizeof(float), "glm::vec3 must be tightly packed");
+
 class Lines {
  public:
-  Lines();
+  explicit Lines(UploadMode upload_mode = UploadMode::kBufferSubData);
   ~Lines() = default;
   void Update(const std::vector<std::vector<glm::vec3> > &segments);
+  // Upload all vertices from one contiguous array without repacking them. Segment k is
+  // vertices[segment_offsets[k]] up to the next segment's offset (or the end of vertices).
+  void Update(Span<glm::vec3> vertices, Span<GLint> segment_offsets);
+  // Draw with the view and projection in CameraUniforms.
+  void Draw(const glm::vec4 &color, GLenum mode);
+  // Same as above after replacing view and proj in the shared camera uniforms, for callers outside
+  // of Window::Run.
   void Draw(const glm::mat4 &view, const glm::mat4 &proj, const glm::vec4 &color, GLenum mode);
+  // The state Draw sets, for sorting in a DrawList.
+  [[nodiscard]] DrawState State() const {
+    return {DrawPass::kTransparent, shader_.ProgramId(), 0, true};
+  }
   void SetPointSize(float point_size) { point_size_ = point_size; };
+  // Submit all segments with one glMultiDrawArrays (the default) instead of one glDrawArrays each.
+  void SetBatchedDraw(bool batched_draw) { batched_draw_ = batched_draw; };
+  // Skip the parts of segments which are outside of the view (the default). Segments are culled in
+  // chunks of SegmentChunks::kChunkVertices vertices.
+  void SetFrustumCulling(bool frustum_culling) { frustum_culling_ = frustum_culling; };
+  // Chunks drawn and culled by the last Draw.
+  [[nodiscard]] CullStats Culling() const { return cull_stats_; }
 
  private:
+  void SetupVertexAttributes();
+
   float point_size_ = 1;
+  bool batched_draw_ = true;
+  bool frustum_culling_ = true;
 
   Shader shader_;
+  Uniform<glm::vec4> color_uniform_;
+  Uniform<float> point_size_uniform_;
   GLuint vao_{};
-  GLuint vbo_{};
+  StreamingBuffer vertex_buffer_;
+  int vertex_buffer_generation_ = -1;
+  GLint first_vertex_ = 0;
   std::vector<GLint> segment_sizes_;
-  GLint current_buffer_size_;
+  std::vector<GLint> segment_firsts_;  // absolute, including first_vertex_
+  SegmentChunks chunks_{};
+  CullStats cull_stats_{0, 0};
+  // visible parts of the segments, rebuilt by every culled Draw
+  std::vector<GLint> visible_sizes_{};
+  std::vector<GLint> visible_firsts_{};
+
+  // reused by the nested-vector Update to avoid reallocating every frame
+  std::vector<glm::vec3> flat_vertices_;
+  std::vector<GLint> flat_segment_offsets_;
 };
 
 };  // namespace bb3d
@@ -1,7 +1,11 @@
 #version 400 core
 layout (location = 0) in vec3 position;
-uniform mat4 view;
-uniform mat4 proj;
+layout (std140) uniform Camera {
+  mat4 view;
+  mat4 proj;
+  vec2 viewport_size;  // pixels
+  float frame_time;    // seconds
+};
 uniform float point_size;
 void main()
 {
@@ -0,0 +1,12 @@
+#version 400 core
+// ID pass of a Picker for meshes whose picked index is a run of primitives_per_pick triangles,
+// e.g. the 2 triangles of a quad. gl_PrimitiveID restarts at 0 with every draw call, so each draw
+// sets first_primitive.
+uniform int object_id;
+uniform int first_primitive;
+uniform int primitives_per_pick;
+out uvec2 ids;
+void main()
+{
+  ids = uvec2(uint(object_id), uint((first_primitive + gl_PrimitiveID) / primitives_per_pick));
+}
@@ -0,0 +1,10 @@
+#version 400 core
+// ID pass of a Picker for vertex shaders which write the picked index themselves, e.g. the vertex
+// or the instance. pick_id is flat, so lines take the ID of their first vertex.
+flat in uint pick_id;
+uniform int object_id;
+out uvec2 ids;
+void main()
+{
+  ids = uvec2(uint(object_id), pick_id);
+}
@@ -0,0 +1,734 @@
+#include "pointcloud.hpp"
+
+#include <GL/glew.h>  // for glBufferData, glDrawArrays, glVertexAttribPointer, GL_POINTS
+
+#include <algorithm>  // for min, max, partition, push_heap, pop_heap, sort, fill
+#include <cstddef>    // for offsetof, ptrdiff_t, size_t
+#include <cstdio>     // for fopen, fread, fwrite, fclose, fseek, ftell, snprintf, fprintf, remove
+#include <cstdlib>    // for EXIT_FAILURE
+#include <limits>     // for numeric_limits
+#include <memory>     // for make_shared, shared_ptr
+#include <mutex>      // for lock_guard, unique_lock
+#include <utility>    // for move, swap
+
+#include "bb3d/assert.hpp"                  // for ASSERT, exit_thread_safe
+#include "bb3d/gl_state.hpp"                // for GlState
+#include "bb3d/profiler.hpp"                // for Profiler
+#include "bb3d/redraw.hpp"                  // for RequestRedraw
+#include "bb3d/shader/camera_uniforms.hpp"  // for CameraUniforms, CameraBlock
+
+namespace bb3d {
+
+namespace {
+
+// Points read from a spilled partition at a time.
+constexpr size_t kStreamChunkPoints = size_t{1} << 20;
+
+// The smallest cube around `bounds`, padded a little, so that the root's octants are cubes too.
+Aabb EnclosingCube(const Aabb &bounds) {
+  const glm::vec3 center = 0.5F * (bounds.min + bounds.max);
+  const glm::vec3 extent = bounds.max - bounds.min;
+  const float half_size = 0.5F * std::max(std::max(extent.x, extent.y), extent.z) + 1e-3F;
+  Aabb cube;
+  cube.Extend(center - glm::vec3(half_size));
+  cube.Extend(center + glm::vec3(half_size));
+  return cube;
+}
+
+// Octant of `cube` containing `position`, bit 0 of the octant is +x, bit 1 +y and bit 2 +z.
+int OctantOf(const Aabb &cube, const glm::vec3 &position) {
+  const glm::vec3 center = 0.5F * (cube.min + cube.max);
+  return (position.x < center.x ? 0 : 1) | (position.y < center.y ? 0 : 2) |
+         (position.z < center.z ? 0 : 4);
+}
+
+Aabb OctantCube(const Aabb &cube, const int octant) {
+  const glm::vec3 half_size = 0.5F * (cube.max - cube.min);
+  const glm::vec3 offset(static_cast<float>(octant & 1), static_cast<float>((octant >> 1) & 1),
+                         static_cast<float>((octant >> 2) & 1));
+  Aabb octant_cube;
+  octant_cube.Extend(cube.min + offset * half_size);
+  octant_cube.Extend(cube.min + (offset + glm::vec3(1.0F)) * half_size);
+  return octant_cube;
+}
+
+// Cells of the kSamplingGrid^3 grid over a node's cube.
+class SamplingGrid {
+ public:
+  explicit SamplingGrid(const Aabb &cube)
+      : min_(cube.min),
+        scale_(glm::vec3(static_cast<float>(PointCloud::kSamplingGrid)) / (cube.max - cube.min)) {}
+
+  [[nodiscard]] size_t Cell(const glm::vec3 &position) const {
+    const auto cell_of = [&](int axis) {
+      const auto cell = static_cast<int>((position[axis] - min_[axis]) * scale_[axis]);
+      return static_cast<size_t>(std::min(std::max(cell, 0), PointCloud::kSamplingGrid - 1));
+    };
+    constexpr auto kGrid = static_cast<size_t>(PointCloud::kSamplingGrid);
+    return (cell_of(0) * kGrid + cell_of(1)) * kGrid + cell_of(2);
+  }
+
+ private:
+  glm::vec3 min_;
+  glm::vec3 scale_;
+};
+
+// Start sampling a new node with the cell stamps of a build thread.
+void NextStamp(std::vector<uint32_t> &cell_stamps, uint32_t &stamp) {
+  if (++stamp == 0) {
+    std::fill(cell_stamps.begin(), cell_stamps.end(), 0);
+    stamp = 1;
+  }
+}
+
+// Append points to `file`, which was opened from `path`.
+void WritePoints(FILE *file, const std::string &path, const PointCloudPoint *points,
+                 const size_t num_points) {
+  if (file == nullptr || fwrite(points, sizeof(PointCloudPoint), num_points, file) != num_points) {
+    fprintf(stderr, "Point cloud: can't write '%s'\n", path.c_str());
+    exit_thread_safe(EXIT_FAILURE);
+  }
+}
+
+// All points of a node or partition file.
+std::vector<PointCloudPoint> ReadPoints(const std::string &path) {
+  FILE *file = fopen(path.c_str(), "rb");
+  long size = -1;  // NOLINT(google-runtime-int)
+  if (file != nullptr && fseek(file, 0, SEEK_END) == 0) {
+    size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+  }
+  const size_t num_points = size > 0 ? static_cast<size_t>(size) / sizeof(PointCloudPoint) : 0;
+  std::vector<PointCloudPoint> points(num_points);
+  if (size < 0 ||
+      fread(points.data(), sizeof(PointCloudPoint), points.size(), file) != points.size()) {
+    fprintf(stderr, "Point cloud: can't read '%s'\n", path.c_str());
+    exit_thread_safe(EXIT_FAILURE);
+  }
+  fclose(file);
+  return points;
+}
+
+};  // namespace
+
+PointCloud::PointCloud(const PointCloudOptions &options)
+    : options_(options),
+      shader_("bb3d/shader/pointcloud.vs", "bb3d/shader/pointcloud.fs"),
+      point_size_uniform_(shader_.GetUniform<float>("point_size")) {
+  ASSERT(options_.num_build_threads > 0);
+  ASSERT(options_.build_memory_points > kMaxLeafPoints);
+
+  // The attributes are pointed at each node's buffer as it is drawn.
+  glGenVertexArrays(1, &vao_);
+  GlState::Get().BindVertexArray(vao_);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+
+  if (!options_.cache_dir.empty()) {
+    loader_ = std::thread(&PointCloud::LoaderThread, this);
+  }
+}
+
+PointCloud::~PointCloud() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  work_available_.notify_all();
+  if (ingester_.joinable()) {
+    ingester_.join();
+  }
+  for (std::thread &builder : builders_) {
+    builder.join();
+  }
+  if (loader_.joinable()) {
+    loader_.join();
+  }
+
+  for (const Node &node : nodes_) {
+    if (node.buffer != 0) {
+      glDeleteBuffers(1, &node.buffer);
+    }
+  }
+  glDeleteVertexArrays(1, &vao_);
+  GlState::Get().Invalidate();
+}
+
+void PointCloud::AddPoints(const Span<PointCloudPoint> points) {
+  QueueBatch(std::vector<PointCloudPoint>(points.begin(), points.end()));
+}
+
+void PointCloud::Build(std::vector<PointCloudPoint> points) {
+  QueueBatch(std::move(points));
+  FinishPoints();
+}
+
+void PointCloud::QueueBatch(std::vector<PointCloudPoint> points) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    ASSERT(!started_);
+    StartIngesting();
+    if (points.empty()) {
+      return;
+    }
+    // Let the ingest thread catch up, so that the batches waiting for it stay within
+    // build_memory_points.
+    work_available_.wait(lock, [this, &points]() {
+      return stopping_ || queued_points_ == 0 ||
+             queued_points_ + points.size() <= options_.build_memory_points;
+    });
+    queued_points_ += points.size();
+    ingest_batches_.push_back(std::move(points));
+  }
+  work_available_.notify_all();
+}
+
+void PointCloud::FinishPoints() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    ASSERT(!started_);
+    started_ = true;
+    StartIngesting();
+  }
+  work_available_.notify_all();
+  for (int k = 0; k < options_.num_build_threads; k++) {
+    builders_.emplace_back(&PointCloud::BuildThread, this);
+  }
+}
+
+void PointCloud::StartIngesting() {
+  if (!ingester_.joinable()) {
+    ingesting_ = true;
+    ingester_ = std::thread(&PointCloud::IngestThread, this);
+  }
+}
+
+void PointCloud::IngestThread() {
+  const bool spill = !options_.cache_dir.empty();
+  const std::string path = IngestPath();
+  FILE *file = spill ? fopen(path.c_str(), "wb") : nullptr;
+  std::vector<PointCloudPoint> points;  // all of them, without a cache
+  size_t num_points = 0;
+  Aabb bounds;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_available_.wait(lock,
+                         [this]() { return stopping_ || !ingest_batches_.empty() || started_; });
+    if (stopping_ || ingest_batches_.empty()) {
+      break;
+    }
+    std::vector<PointCloudPoint> batch = std::move(ingest_batches_.front());
+    ingest_batches_.pop_front();
+    lock.unlock();
+
+    const size_t batch_size = batch.size();
+    for (const PointCloudPoint &point : batch) {
+      bounds.Extend(point.position);
+    }
+    if (spill) {
+      WritePoints(file, path, batch.data(), batch_size);
+    } else if (points.empty()) {
+      points = std::move(batch);
+    } else {
+      points.insert(points.end(), batch.begin(), batch.end());
+    }
+    num_points += batch_size;
+
+    lock.lock();
+    queued_points_ -= batch_size;
+    work_available_.notify_all();
+  }
+  const bool stopping = stopping_;
+  lock.unlock();
+
+  if (file != nullptr && fclose(file) != 0) {
+    fprintf(stderr, "Point cloud: can't write '%s'\n", path.c_str());
+    exit_thread_safe(EXIT_FAILURE);
+  }
+  if (stopping) {
+    return;
+  }
+
+  BuildTask root{nullptr, 0, num_points, {}, EnclosingCube(bounds), -1, 0, 0};
+  if (spill) {
+    root.file = path;
+  } else {
+    root.points = std::make_shared<std::vector<PointCloudPoint> >(std::move(points));
+  }
+  {
+    std::lock_guard<std::mutex> guard(mutex_);
+    ingesting_ = false;
+    if (num_points > 0) {
+      build_tasks_.push_back(std::move(root));
+    }
+  }
+  work_available_.notify_all();
+}
+
+void PointCloud::BuildThread() {
+  // Last sampling stamp of every grid cell, so the grid doesn't have to be cleared for every node.
+  std::vector<uint32_t> cell_stamps(static_cast<size_t>(kSamplingGrid) * kSamplingGrid *
+                                    kSamplingGrid);
+  uint32_t stamp = 0;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    // Tasks are taken breadth first, so the coarse levels are drawable early.
+    work_available_.wait(lock, [this]() {
+      return stopping_ || !build_tasks_.empty() || (active_builders_ == 0 && !ingesting_);
+    });
+    if (stopping_ || build_tasks_.empty()) {
+      break;
+    }
+    BuildTask task = std::move(build_tasks_.front());
+    build_tasks_.pop_front();
+    active_builders_++;
+    lock.unlock();
+    if (task.points != nullptr) {
+      BuildNode(task, cell_stamps, stamp);
+    } else if (task.end > options_.build_memory_points && task.depth < kMaxDepth) {
+      StreamNode(task, cell_stamps, stamp);
+    } else {
+      // Small enough to build the rest of this subtree in memory.
+      task.points = std::make_shared<std::vector<PointCloudPoint> >(ReadPoints(task.file));
+      std::remove(task.file.c_str());
+      BuildNode(task, cell_stamps, stamp);
+    }
+    // The last task of a subtree frees its points.
+    task.points.reset();
+    lock.lock();
+    active_builders_--;
+    work_available_.notify_all();
+  }
+}
+
+void PointCloud::BuildNode(const BuildTask &task, std::vector<uint32_t> &cell_stamps,
+                           uint32_t &stamp) {
+  // The task's range is only touched by this thread.
+  PointCloudPoint *const points = task.points->data();
+
+  Aabb bounds;
+  for (size_t k = task.begin; k < task.end; k++) {
+    bounds.Extend(points[k].position);
+  }
+
+  // Move one point per sampling cell to the front of the range, these are the node's own.
+  size_t kept_end = task.end;
+  if (task.end - task.begin > kMaxLeafPoints && task.depth < kMaxDepth) {
+    NextStamp(cell_stamps, stamp);
+    const SamplingGrid grid(task.cube);
+    kept_end = task.begin;
+    for (size_t k = task.begin; k < task.end; k++) {
+      const size_t cell = grid.Cell(points[k].position);
+      if (cell_stamps[cell] != stamp) {
+        cell_stamps[cell] = stamp;
+        std::swap(points[k], points[kept_end++]);
+      }
+    }
+  }
+
+  int index = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    index = num_built_++;
+  }
+
+  BuiltNode node{index, task.parent, task.octant, bounds, kept_end - task.begin, {}};
+  if (options_.cache_dir.empty()) {
+    node.points.assign(points + task.begin, points + kept_end);
+  } else {
+    WriteNode(index, points + task.begin, node.num_points);
+  }
+
+  // Split the rest between the octants, see OctantOf.
+  const glm::vec3 center = 0.5F * (task.cube.min + task.cube.max);
+  const auto split = [&](size_t begin, size_t end, int axis) {
+    return static_cast<size_t>(
+        std::partition(points + begin, points + end,
+                       [&](const PointCloudPoint &point) {
+                         return point.position[axis] < center[axis];
+                       }) -
+        points);
+  };
+  std::array<size_t, 9> splits{};
+  splits[0] = kept_end;
+  splits[8] = task.end;
+  splits[4] = split(splits[0], splits[8], 2);
+  splits[2] = split(splits[0], splits[4], 1);
+  splits[6] = split(splits[4], splits[8], 1);
+  for (size_t k = 1; k < 8; k += 2) {
+    splits[k] = split(splits[k - 1], splits[k + 1], 0);
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    // Published before its children, so the render thread always sees parents first.
+    built_.push_back(std::move(node));
+    for (int octant = 0; octant < 8; octant++) {
+      const size_t begin = splits[static_cast<size_t>(octant)];
+      const size_t end = splits[static_cast<size_t>(octant) + 1];
+      if (begin == end) {
+        continue;
+      }
+      build_tasks_.push_back(
+          {task.points, begin, end, {}, OctantCube(task.cube, octant), index, octant,
+           task.depth + 1});
+    }
+  }
+  work_available_.notify_all();
+  RequestRedraw();
+}
+
+void PointCloud::StreamNode(const BuildTask &task, std::vector<uint32_t> &cell_stamps,
+                            uint32_t &stamp) {
+  int index = 0;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stopping_) {
+      return;
+    }
+    index = num_built_++;
+  }
+
+  // One pass over the partition: the first point of every sampling cell is kept by the node and
+  // the rest are appended to the partition files of the octants.
+  NextStamp(cell_stamps, stamp);
+  const SamplingGrid grid(task.cube);
+  std::vector<PointCloudPoint> kept;
+  std::array<std::vector<PointCloudPoint>, 8> octant_points{};
+  std::array<FILE *, 8> octant_files{};
+  std::array<size_t, 8> octant_sizes{};
+  const auto flush = [&](int octant) {
+    const auto o = static_cast<size_t>(octant);
+    if (octant_points[o].empty()) {
+      return;
+    }
+    const std::string path = PartitionPath(index, octant);
+    if (octant_files[o] == nullptr) {
+      octant_files[o] = fopen(path.c_str(), "wb");
+    }
+    WritePoints(octant_files[o], path, octant_points[o].data(), octant_points[o].size());
+    octant_sizes[o] += octant_points[o].size();
+    octant_points[o].clear();
+  };
+
+  Aabb bounds;
+  bool stopping = false;
+  FILE *input = fopen(task.file.c_str(), "rb");
+  std::vector<PointCloudPoint> chunk(std::min(kStreamChunkPoints, task.end));
+  for (size_t done = 0; done < task.end && !stopping;) {
+    const size_t num_points = std::min(chunk.size(), task.end - done);
+    if (input == nullptr ||
+        fread(chunk.data(), sizeof(PointCloudPoint), num_points, input) != num_points) {
+      fprintf(stderr, "Point cloud: can't read '%s'\n", task.file.c_str());
+      exit_thread_safe(EXIT_FAILURE);
+    }
+    for (size_t k = 0; k < num_points; k++) {
+      const PointCloudPoint &point = chunk[k];
+      bounds.Extend(point.position);
+      const size_t cell = grid.Cell(point.position);
+      if (cell_stamps[cell] != stamp) {
+        cell_stamps[cell] = stamp;
+        kept.push_back(point);
+        continue;
+      }
+      const int octant = OctantOf(task.cube, point.position);
+      octant_points[static_cast<size_t>(octant)].push_back(point);
+      if (octant_points[static_cast<size_t>(octant)].size() >= kStreamChunkPoints / 8) {
+        flush(octant);
+      }
+    }
+    done += num_points;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping = stopping_;
+  }
+  fclose(input);
+  for (int octant = 0; octant < 8; octant++) {
+    if (!stopping) {
+      flush(octant);
+    }
+    FILE *file = octant_files[static_cast<size_t>(octant)];
+    if (file != nullptr && fclose(file) != 0) {
+      fprintf(stderr, "Point cloud: can't write '%s'\n", PartitionPath(index, octant).c_str());
+      exit_thread_safe(EXIT_FAILURE);
+    }
+  }
+  if (stopping) {
+    return;
+  }
+  std::remove(task.file.c_str());
+  WriteNode(index, kept.data(), kept.size());
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    built_.push_back({index, task.parent, task.octant, bounds, kept.size(), {}});
+    for (int octant = 0; octant < 8; octant++) {
+      const size_t num_points = octant_sizes[static_cast<size_t>(octant)];
+      if (num_points == 0) {
+        continue;
+      }
+      build_tasks_.push_back({nullptr, 0, num_points, PartitionPath(index, octant),
+                              OctantCube(task.cube, octant), index, octant, task.depth + 1});
+    }
+  }
+  work_available_.notify_all();
+  RequestRedraw();
+}
+
+void PointCloud::WriteNode(const int index, const PointCloudPoint *points,
+                           const size_t num_points) const {
+  const std::string path = NodePath(index);
+  FILE *file = fopen(path.c_str(), "wb");
+  WritePoints(file, path, points, num_points);
+  if (fclose(file) != 0) {
+    fprintf(stderr, "Point cloud: can't write node '%s'\n", path.c_str());
+    exit_thread_safe(EXIT_FAILURE);
+  }
+}
+
+std::string PointCloud::NodePath(const int index) const {
+  char name[32];
+  snprintf(name, sizeof(name), "/node_%06d.bin", index);
+  return options_.cache_dir + name;
+}
+
+std::string PointCloud::PartitionPath(const int index, const int octant) const {
+  char name[40];
+  snprintf(name, sizeof(name), "/partition_%06d_%d.bin", index, octant);
+  return options_.cache_dir + name;
+}
+
+std::string PointCloud::IngestPath() const { return options_.cache_dir + "/points.bin"; }
+
+void PointCloud::LoaderThread() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    work_available_.wait(lock, [this]() { return stopping_ || !load_requests_.empty(); });
+    if (stopping_) {
+      return;
+    }
+    const int index = load_requests_.front();
+    load_requests_.pop_front();
+    lock.unlock();
+
+    std::vector<PointCloudPoint> points = ReadPoints(NodePath(index));
+
+    lock.lock();
+    loaded_.emplace_back(index, std::move(points));
+    RequestRedraw();
+  }
+}
+
+void PointCloud::Collect() {
+  std::vector<BuiltNode> built;
+  std::vector<std::pair<int, std::vector<PointCloudPoint> > > loaded;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    built.swap(built_);
+    loaded.swap(loaded_);
+  }
+
+  for (BuiltNode &built_node : built) {
+    const auto index = static_cast<size_t>(built_node.index);
+    if (index >= nodes_.size()) {
+      nodes_.resize(index + 1);
+    }
+    Node &node = nodes_[index];
+    node.bounds = built_node.bounds;
+    node.num_points = built_node.num_points;
+    node.points = std::move(built_node.points);
+    if (built_node.parent >= 0) {
+      nodes_[static_cast<size_t>(built_node.parent)]
+          .children[static_cast<size_t>(built_node.octant)] = built_node.index;
+    }
+  }
+
+  for (std::pair<int, std::vector<PointCloudPoint> > &loaded_node : loaded) {
+    Node &node = nodes_[static_cast<size_t>(loaded_node.first)];
+    node.loading = false;
+    // Loaded for a view which has moved on since and has already been freed again otherwise.
+    if (node.buffer == 0) {
+      node.points = std::move(loaded_node.second);
+    }
+  }
+}
+
+// Approximate diameter of a box on screen, in pixels.
+static float ScreenSize(const Aabb &bounds, const CameraBlock &camera) {
+  const glm::vec3 center = 0.5F * (bounds.min + bounds.max);
+  const float radius = 0.5F * glm::length(bounds.max - bounds.min);
+  const float pixels_per_unit = camera.proj[1][1] * camera.viewport_size.y;
+  if (camera.proj[3][3] == 1.0F) {
+    // orthographic
+    return radius * pixels_per_unit;
+  }
+  const float distance = -(camera.view * glm::vec4(center, 1.0F)).z;
+  if (distance <= radius) {
+    return std::numeric_limits<float>::infinity();
+  }
+  return radius / distance * pixels_per_unit;
+}
+
+void PointCloud::Draw(const glm::mat4 &view, const glm::mat4 &proj) {
+  CameraUniforms::Get().SetViewProj(view, proj);
+  Draw();
+}
+
+void PointCloud::Draw() {
+  const Profiler::GpuScope gpu_scope("PointCloud::Draw");
+  Collect();
+  frame_++;
+
+  // Pick nodes largest on screen first. A node's children are only considered once it is drawn,
+  // so holes are never left where a node isn't uploaded yet.
+  const CameraBlock &camera = CameraUniforms::Get().Block();
+  const Frustum frustum(camera.proj * camera.view);
+  draw_list_.resize(0);
+  wanted_.resize(0);
+  queue_.resize(0);
+  drawn_points_ = 0;
+  if (!nodes_.empty() && nodes_[0].num_points > 0 && frustum.Intersects(nodes_[0].bounds)) {
+    queue_.emplace_back(std::numeric_limits<float>::infinity(), 0);
+  }
+  while (!queue_.empty()) {
+    std::pop_heap(queue_.begin(), queue_.end());
+    const int index = queue_.back().second;
+    queue_.pop_back();
+    Node &node = nodes_[static_cast<size_t>(index)];
+    if (drawn_points_ + node.num_points > options_.point_budget) {
+      break;
+    }
+    if (node.buffer == 0) {
+      wanted_.push_back(index);
+      continue;
+    }
+    draw_list_.push_back(index);
+    drawn_points_ += node.num_points;
+    node.last_drawn_frame = frame_;
+    for (const int child_index : node.children) {
+      if (child_index < 0) {
+        continue;
+      }
+      const Node &child = nodes_[static_cast<size_t>(child_index)];
+      if (!frustum.Intersects(child.bounds)) {
+        continue;
+      }
+      const float size = ScreenSize(child.bounds, camera);
+      if (size >= options_.min_node_pixels) {
+        queue_.emplace_back(size, child_index);
+        std::push_heap(queue_.begin(), queue_.end());
+      }
+    }
+  }
+
+  shader_.UseProgram();
+  GlState::Get().BindVertexArray(vao_);
+  point_size_uniform_.Set(point_size_);
+  GlState::Get().SetEnabled(GL_BLEND, false);
+  for (const int index : draw_list_) {
+    const Node &node = nodes_[static_cast<size_t>(index)];
+    glBindBuffer(GL_ARRAY_BUFFER, node.buffer);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PointCloudPoint),
+                          (GLvoid *)offsetof(PointCloudPoint, position));  // NOLINT
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(PointCloudPoint),
+                          (GLvoid *)offsetof(PointCloudPoint, color));  // NOLINT
+    glDrawArrays(GL_POINTS, 0, static_cast<GLsizei>(node.num_points));
+    GlState::Get().CountDraws(1);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  UpdateResidency();
+}
+
+void PointCloud::UpdateResidency() {
+  // Requests which the loader hasn't started on are replaced by what this frame wants.
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const int index : load_requests_) {
+      nodes_[static_cast<size_t>(index)].loading = false;
+    }
+    load_requests_.clear();
+  }
+
+  size_t uploaded_points = 0;
+  requests_.resize(0);
+  for (const int index : wanted_) {
+    Node &node = nodes_[static_cast<size_t>(index)];
+    if (!node.points.empty()) {
+      if (uploaded_points > 0 &&
+          uploaded_points + node.num_points > options_.upload_points_per_frame) {
+        continue;
+      }
+      uploaded_points += node.num_points;
+      Upload(index);
+    } else if (!node.loading && !options_.cache_dir.empty()) {
+      node.loading = true;
+      requests_.push_back(index);
+    }
+  }
+  // The next frame can draw more, or upload the rest.
+  if (uploaded_points > 0) {
+    RequestRedraw();
+  }
+  if (!requests_.empty()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      load_requests_.insert(load_requests_.end(), requests_.begin(), requests_.end());
+    }
+    work_available_.notify_all();
+  }
+
+  if (resident_points_ <= options_.gpu_point_budget) {
+    return;
+  }
+  // Free the buffers drawn least recently, but never those of this frame.
+  std::sort(resident_.begin(), resident_.end(), [this](int a, int b) {
+    return nodes_[static_cast<size_t>(a)].last_drawn_frame <
+           nodes_[static_cast<size_t>(b)].last_drawn_frame;
+  });
+  size_t evicted = 0;
+  while (evicted < resident_.size() && resident_points_ > options_.gpu_point_budget) {
+    Node &node = nodes_[static_cast<size_t>(resident_[evicted])];
+    if (node.last_drawn_frame == frame_) {
+      break;
+    }
+    glDeleteBuffers(1, &node.buffer);
+    node.buffer = 0;
+    resident_points_ -= node.num_points;
+    evicted++;
+  }
+  resident_.erase(resident_.begin(), resident_.begin() + static_cast<ptrdiff_t>(evicted));
+}
+
+void PointCloud::Upload(const int index) {
+  Node &node = nodes_[static_cast<size_t>(index)];
+  glGenBuffers(1, &node.buffer);
+  glBindBuffer(GL_ARRAY_BUFFER, node.buffer);
+  glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(sizeof(PointCloudPoint) * node.num_points),
+               node.points.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  resident_.push_back(index);
+  resident_points_ += node.num_points;
+  // With a cache the points are read back from disk when the buffer is needed again.
+  if (!options_.cache_dir.empty()) {
+    std::vector<PointCloudPoint>().swap(node.points);
+  }
+}
+
+PointCloudStats PointCloud::Stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  const bool building = ingesting_ || !build_tasks_.empty() || active_builders_ > 0;
+  return {num_built_,
+          static_cast<int>(resident_.size()),
+          static_cast<int>(draw_list_.size()),
+          drawn_points_,
+          resident_points_,
+          building};
+}
+
+};  // namespace bb3d
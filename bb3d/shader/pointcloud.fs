@@ -0,0 +1,7 @@
+#version 400 core
+in vec4 frag_color_in;
+out vec4 frag_color_out;
+void main()
+{
+  frag_color_out = frag_color_in;
+}
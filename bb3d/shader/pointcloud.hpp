@@ -0,0 +1,210 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLuint
+
+#include <array>               // for array
+#include <condition_variable>  // for condition_variable
+#include <cstddef>             // for size_t, offsetof
+#include <cstdint>             // for uint32_t, uint64_t
+#include <deque>               // for deque
+#include <glm/glm.hpp>         // for vec3, vec4, mat4
+#include <memory>              // for shared_ptr
+#include <mutex>               // for mutex
+#include <string>              // for string
+#include <thread>              // for thread
+#include <type_traits>         // for is_trivially_copyable_v
+#include <utility>             // for pair
+#include <vector>              // for vector
+
+#include "bb3d/culling.hpp"        // for Aabb
+#include "bb3d/draw_list.hpp"      // for DrawState, DrawPass
+#include "bb3d/shader/shader.hpp"  // for Shader, Uniform
+#include "bb3d/span.hpp"           // for Span
+#include "bb3d/vertex_format.hpp"  // for PackRgba8
+
+namespace bb3d {
+
+struct PointCloudPoint {
+  glm::vec3 position{};
+  uint32_t color = 0;  // RGBA8, red in the lowest byte, see PackRgba8
+};
+// PointCloudPoint is uploaded and written to the node cache as is.
+static_assert(std::is_trivially_copyable_v<PointCloudPoint>);
+static_assert(sizeof(PointCloudPoint) == 4 * sizeof(float),
+              "PointCloudPoint must be tightly packed");
+static_assert(offsetof(PointCloudPoint, color) == 3 * sizeof(float));
+
+struct PointCloudOptions {
+  // Points drawn per frame at most. Nodes are picked largest on screen first until it is used up.
+  size_t point_budget = 5000000;
+  // Points kept in GPU buffers. The nodes drawn least recently are freed beyond this.
+  size_t gpu_point_budget = 20000000;
+  // Points uploaded per frame at most, so that loading never stalls a frame for long.
+  size_t upload_points_per_frame = 1000000;
+  // Nodes smaller than this on screen are not drawn (except the root), nor are their children.
+  float min_node_pixels = 100;
+  // When set, the points are spilled to this (existing) directory as they are added and the octree
+  // is built from there, so the cloud doesn't have to fit in memory. Nodes are written there too
+  // and read back by a loader thread when they are needed, so once the octree is built only the
+  // nodes being drawn are in memory. Otherwise the whole cloud is kept in memory until it is built,
+  // and all nodes stay in memory with only their GPU buffers coming and going.
+  std::string cache_dir{};
+  int num_build_threads = 2;
+  // With a cache_dir, spilled partitions of more points than this are split into their octants by
+  // streaming them from disk, and smaller ones are loaded and built in memory, so each build thread
+  // holds at most this many points. It also bounds the points AddPoints queues for spilling.
+  size_t build_memory_points = 16000000;
+};
+
+struct PointCloudStats {
+  int num_nodes;       // built so far
+  int resident_nodes;  // with a GPU buffer
+  int drawn_nodes;     // by the last Draw
+  size_t drawn_points;
+  size_t resident_points;
+  bool building;
+};
+
+// Level-of-detail point cloud for lidar maps far larger than the point budget. The points are
+// sorted into an octree on background threads: each node keeps a subsample of the points in its
+// cube, one per cell of a kSamplingGrid^3 grid, and passes the rest down to its children, so a node
+// and its ancestors together hold every point of its cube once. Draw walks the octree from the
+// root, largest nodes on screen first, and draws nodes until the point budget is used up, so the
+// frame time depends on the budget rather than on the size of the cloud.
+//
+// Each node has its own GPU buffer of 16 byte points. Nodes are uploaded when Draw first wants
+// them, a limited number of points per frame, and until a node is uploaded its parent is drawn
+// instead.
+class PointCloud {
+ public:
+  static constexpr int kSamplingGrid = 128;
+  // Nodes with fewer points than this aren't subdivided.
+  static constexpr size_t kMaxLeafPoints = 65536;
+  static constexpr int kMaxDepth = 20;
+
+  explicit PointCloud(const PointCloudOptions &options = PointCloudOptions{});
+  // Stops building and loading. Nodes written to the cache are left there.
+  ~PointCloud();
+  PointCloud(const PointCloud &) = delete;
+  PointCloud &operator=(const PointCloud &) = delete;
+
+  // Add a batch of points. The batch is copied and handed to an ingest thread, which takes the
+  // bounds and spills the points to cache_dir if there is one, so a cloud larger than memory can be
+  // added a batch at a time. Blocks while more than build_memory_points points wait for spilling.
+  void AddPoints(Span<PointCloudPoint> points);
+  // Start building the octree from the points added so far. Nodes become drawable as they are
+  // built, coarsest first. Points can't be added afterwards. Can only be called once.
+  void FinishPoints();
+  // AddPoints and FinishPoints, moving `points` instead of copying them.
+  void Build(std::vector<PointCloudPoint> points);
+  // Draw with the view and projection in CameraUniforms.
+  void Draw();
+  // Same as above after replacing view and proj in the shared camera uniforms, for callers outside
+  // of Window::Run.
+  void Draw(const glm::mat4 &view, const glm::mat4 &proj);
+  // The state Draw sets, for sorting in a DrawList.
+  [[nodiscard]] DrawState State() const {
+    return {DrawPass::kOpaque, shader_.ProgramId(), 0, false};
+  }
+  void SetPointSize(float point_size) { point_size_ = point_size; };
+
+  [[nodiscard]] PointCloudStats Stats() const;
+
+ private:
+  // Octree node as seen by Draw, only touched by the render thread.
+  struct Node {
+    Aabb bounds{};
+    size_t num_points = 0;
+    std::array<int, 8> children{-1, -1, -1, -1, -1, -1, -1, -1};
+    std::vector<PointCloudPoint> points{};  // empty while it is only in the cache
+    bool loading = false;
+    GLuint buffer = 0;
+    uint64_t last_drawn_frame = 0;
+  };
+
+  // A node handed from the build threads to the render thread.
+  struct BuiltNode {
+    int index;
+    int parent;  // -1 for the root
+    int octant;
+    Aabb bounds;
+    size_t num_points;
+    std::vector<PointCloudPoint> points;  // empty when written to the cache
+  };
+
+  // The points of one node and its subtree: a range of a vector shared by the tasks of the subtree,
+  // or a partition spilled to the cache.
+  struct BuildTask {
+    std::shared_ptr<std::vector<PointCloudPoint> > points;  // null while in `file`
+    size_t begin;
+    size_t end;  // the number of points in `file`
+    std::string file;
+    Aabb cube;
+    int parent;
+    int octant;
+    int depth;
+  };
+
+  void QueueBatch(std::vector<PointCloudPoint> points);
+  // Called with mutex_ held.
+  void StartIngesting();
+  // Takes the bounds of the added points and spills them, then queues the root.
+  void IngestThread();
+  void BuildThread();
+  // cell_stamps holds the stamp of the last node which sampled each grid cell.
+  void BuildNode(const BuildTask &task, std::vector<uint32_t> &cell_stamps, uint32_t &stamp);
+  // Build a node from a spilled partition too large for memory in one pass over its file, spilling
+  // the points it doesn't keep to the partitions of its children.
+  void StreamNode(const BuildTask &task, std::vector<uint32_t> &cell_stamps, uint32_t &stamp);
+  void WriteNode(int index, const PointCloudPoint *points, size_t num_points) const;
+  void LoaderThread();
+  [[nodiscard]] std::string NodePath(int index) const;
+  // Points of node `index` for its child in `octant`, while building.
+  [[nodiscard]] std::string PartitionPath(int index, int octant) const;
+  // The added points, while building.
+  [[nodiscard]] std::string IngestPath() const;
+
+  // Take the nodes built and loaded since the last frame.
+  void Collect();
+  // Upload or load the nodes Draw wanted but couldn't draw, and free buffers over the budget.
+  void UpdateResidency();
+  void Upload(int index);
+
+  PointCloudOptions options_;
+  Shader shader_;
+  Uniform<float> point_size_uniform_;
+  GLuint vao_{};
+  float point_size_ = 1;
+
+  // render thread
+  std::vector<Node> nodes_{};
+  std::vector<int> draw_list_{};
+  std::vector<int> wanted_{};  // by the last Draw, most important first
+  std::vector<int> requests_{};  // reused by UpdateResidency
+  std::vector<std::pair<float, int> > queue_{};
+  std::vector<int> resident_{};
+  uint64_t frame_ = 0;
+  size_t resident_points_ = 0;
+  size_t drawn_points_ = 0;
+
+  // shared with the build and loader threads
+  mutable std::mutex mutex_{};
+  std::condition_variable work_available_{};
+  bool stopping_ = false;
+  bool started_ = false;    // by FinishPoints
+  bool ingesting_ = false;  // until the root is queued
+  std::deque<std::vector<PointCloudPoint> > ingest_batches_{};
+  size_t queued_points_ = 0;  // in ingest_batches_
+  int active_builders_ = 0;
+  int num_built_ = 0;
+  std::deque<BuildTask> build_tasks_{};
+  std::vector<BuiltNode> built_{};
+  std::deque<int> load_requests_{};
+  std::vector<std::pair<int, std::vector<PointCloudPoint> > > loaded_{};
+
+  std::thread ingester_{};
+  std::vector<std::thread> builders_{};
+  std::thread loader_{};
+};
+
+};  // namespace bb3d
@@ -0,0 +1,17 @@
+#version 400 core
+layout (location = 0) in vec3 position;
+layout (location = 1) in vec4 vert_color;  // RGBA8, normalized
+out vec4 frag_color_in;
+layout (std140) uniform Camera {
+  mat4 view;
+  mat4 proj;
+  vec2 viewport_size;  // pixels
+  float frame_time;    // seconds
+};
+uniform float point_size;
+void main()
+{
+  gl_Position = proj * view * vec4(position, 1.0);
+  frag_color_in = vert_color;
+  gl_PointSize = point_size;
+}
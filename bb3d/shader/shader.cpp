@@ -1,16 +1,30 @@
 #include "shader.hpp"
 
 #include <GL/glew.h>  // for glGetUniformLocation, GLuint, GL_FALSE, glAttachShader
+#include <sys/stat.h>  // for mkdir
 
-#include <cstdlib>               // for exit, NULL, EXIT_FAILURE
+#include <algorithm>             // for max
+#include <array>                 // for array
+#include <cstddef>               // for size_t
+#include <cstdint>               // for uint64_t
+#include <cstdio>                // for rename, snprintf
+#include <cstdlib>               // for exit, getenv, NULL, EXIT_FAILURE
+#include <cstring>               // for memcmp, memcpy
 #include <fstream>               // for operator<<, endl, basic_ostream, ostream, ifstream, basi...
 #include <glm/glm.hpp>           // for mat2, mat3, mat4, vec2, vec3, vec4
 #include <glm/gtc/type_ptr.hpp>  // for value_ptr
 #include <iostream>              // for cerr
+#include <iterator>              // for istreambuf_iterator
+#include <memory>                // for shared_ptr, weak_ptr, make_shared
 #include <sstream>
-#include <string>  // for string, operator<<, allocator, operator!=, char_traits
+#include <string>                // for string, operator<<, allocator, operator!=, char_traits
+#include <unordered_map>         // for unordered_map
+#include <vector>                // for vector
 
-#include "bb3d/assert.hpp"
+#include "bb3d/assert.hpp"                   // for ASSERT, exit_thread_safe
+#include "bb3d/gl_state.hpp"                 // for GlState
+#include "bb3d/shader/camera_uniforms.hpp"   // for CameraUniforms
+#include "bb3d/shader/embedded_shaders.hpp"  // for EmbeddedShader, EmbeddedShaders
 
 namespace bb3d {
 
@@ -26,6 +40,21 @@ static inline std::string ReadFile(const std::string &path) {
   return shader_stream.str();
 }
 
+// Shaders are compiled into the library, see embed_shaders.py. For shader development, setting
+// $BB3D_SHADER_DIR (e.g. to the workspace root) makes the embedded ones load from
+// $BB3D_SHADER_DIR/<path> instead, so edits show up without rebuilding. Paths which aren't embedded
+// are read from disk as they are.
+static std::string LoadSource(const std::string &path) {
+  static const char *const shader_dir = std::getenv("BB3D_SHADER_DIR");
+  for (const EmbeddedShader &shader : EmbeddedShaders()) {
+    if (path == shader.path) {
+      return shader_dir != nullptr ? ReadFile(std::string(shader_dir) + "/" + path)
+                                   : std::string(shader.source);
+    }
+  }
+  return ReadFile(path);
+}
+
 static void CheckCompileErrors(GLuint shader, const std::string &type) {
   GLint success = 0;
   std::string infoLog(1024, '\0');
@@ -50,109 +79,394 @@ static void CheckCompileErrors(GLuint shader, const std::string &type) {
   }
 }
 
-// constructor generates the shader on the fly
+static GLuint CompileShader(GLenum type, const std::string &code, const std::string &type_name) {
+  const GLuint shader = glCreateShader(type);
+  const char *code_str = code.c_str();
+  glShaderSource(shader, 1, &code_str, nullptr);
+  glCompileShader(shader);
+  CheckCompileErrors(shader, type_name);
+  return shader;
+}
+
+// 64-bit FNV-1a, which unlike std::hash is the same in every run, for on-disk cache keys.
+static uint64_t Fnv1a(const std::string &data, uint64_t hash = 14695981039346656037ULL) {
+  for (const char c : data) {
+    hash ^= static_cast<unsigned char>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+static std::string &ProgramBinaryCacheDirectory() {
+  static std::string directory = []() {
+    const char *env = std::getenv("BB3D_PROGRAM_CACHE_DIR");
+    return env == nullptr ? std::string() : std::string(env);
+  }();
+  return directory;
+}
+
+// Bumped by ContextCreated, to tell programs of earlier contexts apart.
+static int &ContextGeneration() {
+  static int generation = 0;
+  return generation;
+}
+
+static Shader::ProgramCacheStats &MutableProgramCacheStats() {
+  static Shader::ProgramCacheStats stats;
+  return stats;
+}
+
+// Path of the cached binary for these sources, or an empty string if there is no cache.
+static std::string ProgramBinaryPath(uint64_t sources_hash) {
+  const std::string &directory = ProgramBinaryCacheDirectory();
+  if (directory.empty() || GLEW_ARB_get_program_binary == 0) {
+    return std::string();
+  }
+  GLint num_formats = 0;
+  glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+  if (num_formats == 0) {
+    return std::string();
+  }
+
+  // Binaries are only valid for the driver which produced them.
+  uint64_t hash = sources_hash;
+  for (const GLenum name : {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+    hash = Fnv1a(reinterpret_cast<const char *>(glGetString(name)), hash);  // NOLINT
+  }
+  std::array<char, 17> hex{};
+  snprintf(hex.data(), hex.size(), "%016llx", static_cast<unsigned long long>(hash));  // NOLINT
+  return directory + "/" + hex.data() + ".bin";
+}
+
+static bool LoadProgramBinary(GLuint program, const std::string &path) {
+  std::ifstream file(path, std::ifstream::binary);
+  if (!file) {
+    return false;
+  }
+  GLenum format = 0;
+  file.read(reinterpret_cast<char *>(&format), sizeof(format));  // NOLINT
+  const std::vector<char> binary((std::istreambuf_iterator<char>(file)),
+                                 std::istreambuf_iterator<char>());
+  if (!file.eof() || binary.empty()) {
+    return false;
+  }
+  glProgramBinary(program, format, binary.data(), static_cast<GLsizei>(binary.size()));
+  // This fails when the driver was updated in a way which doesn't show in its version string.
+  GLint success = 0;
+  glGetProgramiv(program, GL_LINK_STATUS, &success);
+  return success != 0;
+}
+
+static void SaveProgramBinary(GLuint program, const std::string &path) {
+  GLint length = 0;
+  glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0) {
+    return;
+  }
+  std::vector<char> binary(static_cast<size_t>(length));
+  GLenum format = 0;
+  glGetProgramBinary(program, length, nullptr, &format, binary.data());
+
+  // Write to a temporary file first so that other processes never load half a binary.
+  mkdir(ProgramBinaryCacheDirectory().c_str(), 0755);  // NOLINT
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream file(tmp_path, std::ofstream::binary);
+    file.write(reinterpret_cast<const char *>(&format), sizeof(format));  // NOLINT
+    file.write(binary.data(), static_cast<std::streamsize>(binary.size()));
+    if (!file) {
+      std::cerr << "Shader unable to write program binary '" << tmp_path << "'." << std::endl;
+      return;
+    }
+  }
+  std::rename(tmp_path.c_str(), path.c_str());
+}
+
+void Shader::SetProgramBinaryCacheDirectory(const std::string &directory) {
+  ProgramBinaryCacheDirectory() = directory;
+}
+
+Shader::ProgramCacheStats Shader::GetProgramCacheStats() { return MutableProgramCacheStats(); }
+
+std::unordered_map<uint64_t, std::weak_ptr<Shader::Program> > &Shader::LivePrograms() {
+  static std::unordered_map<uint64_t, std::weak_ptr<Program> > live_programs;
+  return live_programs;
+}
+
+void Shader::ContextCreated() {
+  LivePrograms().clear();
+  ContextGeneration()++;
+}
+
+Shader::Program::~Program() {
+  // A program of an earlier context went away with it, and its id may name another program now.
+  if (context_generation != ContextGeneration()) {
+    return;
+  }
+  glDeleteProgram(id);
+  // The id may be reused by the next program.
+  GlState::Get().Invalidate();
+}
+
+// constructor generates the shader on the fly, unless an identical one is alive
 // ------------------------------------------------------------------------
 Shader::Shader(const std::string &vshader_path, const std::string &fshader_path,
-               const std::string &gshader_path) : program_id_{} {
-  // vertex shader
-  const GLuint vertex = glCreateShader(GL_VERTEX_SHADER);
-  std::string vshader_code = ReadFile(vshader_path);
-  const char *vshader_code_str = vshader_code.c_str();
-  glShaderSource(vertex, 1, &vshader_code_str, nullptr);
-  glCompileShader(vertex);
-  CheckCompileErrors(vertex, "VERTEX");
-
-  // fragment Shader
-  GLuint fragment = glCreateShader(GL_FRAGMENT_SHADER);
-  std::string fshader_code = ReadFile(fshader_path);
-  ;
-  const char *fshader_code_str = fshader_code.c_str();
-  glShaderSource(fragment, 1, &fshader_code_str, nullptr);
-  glCompileShader(fragment);
-  CheckCompileErrors(fragment, "FRAGMENT");
+               const std::string &gshader_path)
+    : program_() {
+  const std::string vshader_code = LoadSource(vshader_path);
+  const std::string fshader_code = LoadSource(fshader_path);
+  const std::string gshader_code = gshader_path.empty() ? std::string() : LoadSource(gshader_path);
+  // NUL separated, so that moving code between stages changes the key
+  std::string sources = vshader_code + '\0' + fshader_code + '\0' + gshader_code;
+  const uint64_t sources_hash = Fnv1a(sources);
 
+  std::unordered_map<uint64_t, std::weak_ptr<Program> > &live_programs = LivePrograms();
+  const auto live = live_programs.find(sources_hash);
+  if (live != live_programs.end()) {
+    std::shared_ptr<Program> program = live->second.lock();
+    if (program != nullptr && program->sources == sources) {
+      program_ = std::move(program);
+      MutableProgramCacheStats().shared++;
+      return;
+    }
+  }
+
+  program_ = std::make_shared<Program>();
+  program_->sources = std::move(sources);
+  program_->id = glCreateProgram();
+  program_->context_generation = ContextGeneration();
+  live_programs[sources_hash] = program_;
+
+  const std::string binary_path = ProgramBinaryPath(sources_hash);
+  if (!binary_path.empty() && LoadProgramBinary(program_->id, binary_path)) {
+    MutableProgramCacheStats().loaded_from_disk++;
+    Introspect();
+    return;
+  }
+
+  const GLuint vertex = CompileShader(GL_VERTEX_SHADER, vshader_code, "VERTEX");
+  const GLuint fragment = CompileShader(GL_FRAGMENT_SHADER, fshader_code, "FRAGMENT");
   // if geometry shader is given, compile geometry shader
   GLuint geometry = 0;
   if (!gshader_path.empty()) {
-    const std::string gshader_code = ReadFile(gshader_path);
-    const char *gshader_code_str = gshader_code.c_str();
-    geometry = glCreateShader(GL_GEOMETRY_SHADER);
-    glShaderSource(geometry, 1, &gshader_code_str, nullptr);
-    glCompileShader(geometry);
-    CheckCompileErrors(geometry, "GEOMETRY");
+    geometry = CompileShader(GL_GEOMETRY_SHADER, gshader_code, "GEOMETRY");
   }
 
   // shader Program
-  program_id_ = glCreateProgram();
-  glAttachShader(program_id_, vertex);
-  glAttachShader(program_id_, fragment);
+  glAttachShader(program_->id, vertex);
+  glAttachShader(program_->id, fragment);
   if (!gshader_path.empty()) {
-    glAttachShader(program_id_, geometry);
+    glAttachShader(program_->id, geometry);
+  }
+  if (!binary_path.empty()) {
+    glProgramParameteri(program_->id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   }
-  glLinkProgram(program_id_);
-  CheckCompileErrors(program_id_, "PROGRAM");
+  glLinkProgram(program_->id);
+  CheckCompileErrors(program_->id, "PROGRAM");
 
   // delete the shaders as they're linked into our program now and no longer necessery
+  glDetachShader(program_->id, vertex);
+  glDetachShader(program_->id, fragment);
   glDeleteShader(vertex);
   glDeleteShader(fragment);
   if (!gshader_path.empty()) {
+    glDetachShader(program_->id, geometry);
     glDeleteShader(geometry);
   }
+  MutableProgramCacheStats().compiled++;
+
+  if (!binary_path.empty()) {
+    SaveProgramBinary(program_->id, binary_path);
+  }
+  Introspect();
 }
 
-Shader::~Shader() { glDeleteProgram(program_id_); }
+// Resolve every active uniform and attribute once, so nothing is looked up by name per frame.
+void Shader::Introspect() {
+  const GLuint camera_block = glGetUniformBlockIndex(program_->id, "Camera");
+  if (camera_block != GL_INVALID_INDEX) {
+    glUniformBlockBinding(program_->id, camera_block, CameraUniforms::kBindingPoint);
+  }
+
+  GLint max_name_length = 0;
+  glGetProgramiv(program_->id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_name_length);
+  GLint max_attrib_name_length = 0;
+  glGetProgramiv(program_->id, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &max_attrib_name_length);
+  std::string name(static_cast<size_t>(std::max(max_name_length, max_attrib_name_length)), '\0');
+
+  GLint num_uniforms = 0;
+  glGetProgramiv(program_->id, GL_ACTIVE_UNIFORMS, &num_uniforms);
+  for (GLuint k = 0; k < static_cast<GLuint>(num_uniforms); k++) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveUniform(program_->id, k, static_cast<GLsizei>(name.size()), &length, &size, &type,
+                       name.data());
+    const std::string uniform_name(name.data(), static_cast<size_t>(length));
+    const GLint location = glGetUniformLocation(program_->id, uniform_name.c_str());
+    if (location < 0) {
+      continue;  // in a uniform block
+    }
+    const int slot = static_cast<int>(program_->uniforms.size());
+    program_->uniforms.push_back({location, type, false, {}});
+    program_->uniform_slots[uniform_name] = slot;
+    // Arrays are reported as "name[0]", and can be set through "name" too.
+    const size_t bracket = uniform_name.find("[0]");
+    if (bracket != std::string::npos) {
+      program_->uniform_slots[uniform_name.substr(0, bracket)] = slot;
+    }
+  }
+
+  GLint num_attribs = 0;
+  glGetProgramiv(program_->id, GL_ACTIVE_ATTRIBUTES, &num_attribs);
+  for (GLuint k = 0; k < static_cast<GLuint>(num_attribs); k++) {
+    GLsizei length = 0;
+    GLint size = 0;
+    GLenum type = 0;
+    glGetActiveAttrib(program_->id, k, static_cast<GLsizei>(name.size()), &length, &size, &type,
+                      name.data());
+    const std::string attrib_name(name.data(), static_cast<size_t>(length));
+    program_->attrib_locations[attrib_name] = glGetAttribLocation(program_->id, attrib_name.c_str());
+  }
+}
 
 // activate the shader
 // ------------------------------------------------------------------------
-void Shader::UseProgram() const { glUseProgram(program_id_); }
+void Shader::UseProgram() const { GlState::Get().UseProgram(program_->id); }
 
 void Shader::VertexAttribPointer(const char *name, GLint size, GLenum type, GLboolean normalized,
                                  GLsizei stride, const void *pointer) const {
-  glVertexAttribPointer(glGetAttribLocation(program_id_, name), size, type, normalized, stride,
+  glVertexAttribPointer(static_cast<GLuint>(AttribLocation(name)), size, type, normalized, stride,
                         pointer);
 }
 
-// utility uniform functions
+GLint Shader::AttribLocation(const std::string &name) const {
+  const auto it = program_->attrib_locations.find(name);
+  return it == program_->attrib_locations.end() ? -1 : it->second;
+}
+
+int Shader::FindUniform(const std::string &name, const GLenum type) const {
+  const auto it = program_->uniform_slots.find(name);
+  if (it == program_->uniform_slots.end()) {
+    return -1;
+  }
+  const GLenum active_type = program_->uniforms[static_cast<size_t>(it->second)].type;
+  if (type == GL_INT) {
+    // ints also set bools and samplers
+    ASSERT(active_type != GL_FLOAT && active_type != GL_FLOAT_VEC2 &&
+           active_type != GL_FLOAT_VEC3 && active_type != GL_FLOAT_VEC4 &&
+           active_type != GL_FLOAT_MAT2 && active_type != GL_FLOAT_MAT3 &&
+           active_type != GL_FLOAT_MAT4);
+  } else {
+    ASSERT(active_type == type);
+  }
+  return it->second;
+}
+
+bool Shader::UpdateSlot(const int slot, const void *value, const size_t size) const {
+  UniformSlot &uniform = program_->uniforms[static_cast<size_t>(slot)];
+  if (uniform.valid && memcmp(uniform.value.data(), value, size) == 0) {
+    return false;
+  }
+  memcpy(uniform.value.data(), value, size);
+  uniform.valid = true;
+  return true;
+}
+
+GLenum Shader::GlslType(const int * /*unused*/) { return GL_INT; }
+GLenum Shader::GlslType(const float * /*unused*/) { return GL_FLOAT; }
+GLenum Shader::GlslType(const glm::vec2 * /*unused*/) { return GL_FLOAT_VEC2; }
+GLenum Shader::GlslType(const glm::vec3 * /*unused*/) { return GL_FLOAT_VEC3; }
+GLenum Shader::GlslType(const glm::vec4 * /*unused*/) { return GL_FLOAT_VEC4; }
+GLenum Shader::GlslType(const glm::mat2 * /*unused*/) { return GL_FLOAT_MAT2; }
+GLenum Shader::GlslType(const glm::mat3 * /*unused*/) { return GL_FLOAT_MAT3; }
+GLenum Shader::GlslType(const glm::mat4 * /*unused*/) { return GL_FLOAT_MAT4; }
+
+void Shader::SetUniform(const int slot, const int value) const {
+  if (slot >= 0 && UpdateSlot(slot, &value, sizeof(value))) {
+    glUniform1i(program_->uniforms[static_cast<size_t>(slot)].location, value);
+  }
+}
+void Shader::SetUniform(const int slot, const float value) const {
+  if (slot >= 0 && UpdateSlot(slot, &value, sizeof(value))) {
+    glUniform1f(program_->uniforms[static_cast<size_t>(slot)].location, value);
+  }
+}
+void Shader::SetUniform(const int slot, const glm::vec2 &value) const {
+  if (slot >= 0 && UpdateSlot(slot, glm::value_ptr(value), sizeof(value))) {
+    glUniform2fv(program_->uniforms[static_cast<size_t>(slot)].location, 1, glm::value_ptr(value));
+  }
+}
+void Shader::SetUniform(const int slot, const glm::vec3 &value) const {
+  if (slot >= 0 && UpdateSlot(slot, glm::value_ptr(value), sizeof(value))) {
+    glUniform3fv(program_->uniforms[static_cast<size_t>(slot)].location, 1, glm::value_ptr(value));
+  }
+}
+void Shader::SetUniform(const int slot, const glm::vec4 &value) const {
+  if (slot >= 0 && UpdateSlot(slot, glm::value_ptr(value), sizeof(value))) {
+    glUniform4fv(program_->uniforms[static_cast<size_t>(slot)].location, 1, glm::value_ptr(value));
+  }
+}
+void Shader::SetUniform(const int slot, const glm::mat2 &value) const {
+  if (slot >= 0 && UpdateSlot(slot, glm::value_ptr(value), sizeof(value))) {
+    glUniformMatrix2fv(program_->uniforms[static_cast<size_t>(slot)].location, 1, GL_FALSE,
+                       glm::value_ptr(value));
+  }
+}
+void Shader::SetUniform(const int slot, const glm::mat3 &value) const {
+  if (slot >= 0 && UpdateSlot(slot, glm::value_ptr(value), sizeof(value))) {
+    glUniformMatrix3fv(program_->uniforms[static_cast<size_t>(slot)].location, 1, GL_FALSE,
+                       glm::value_ptr(value));
+  }
+}
+void Shader::SetUniform(const int slot, const glm::mat4 &value) const {
+  if (slot >= 0 && UpdateSlot(slot, glm::value_ptr(value), sizeof(value))) {
+    glUniformMatrix4fv(program_->uniforms[static_cast<size_t>(slot)].location, 1, GL_FALSE,
+                       glm::value_ptr(value));
+  }
+}
+
+// utility uniform functions, which go through the same cache as the handles
 // ------------------------------------------------------------------------
 void Shader::Uniform1i(const char *name, int value) const {
-  glUniform1i(glGetUniformLocation(program_id_, name), value);
+  SetUniform(FindUniform(name, GL_INT), value);
 }
 // ------------------------------------------------------------------------
 void Shader::Uniform1f(const char *name, float value) const {
-  glUniform1f(glGetUniformLocation(program_id_, name), value);
+  SetUniform(FindUniform(name, GL_FLOAT), value);
 }
 // ------------------------------------------------------------------------
 void Shader::Uniform2fv(const char *name, const glm::vec2 &value) const {
-  glUniform2fv(glGetUniformLocation(program_id_, name), 1, glm::value_ptr(value));
+  SetUniform(FindUniform(name, GL_FLOAT_VEC2), value);
 }
 void Shader::Uniform2f(const char *name, float x, float y) const {
-  glUniform2f(glGetUniformLocation(program_id_, name), x, y);
+  SetUniform(FindUniform(name, GL_FLOAT_VEC2), glm::vec2(x, y));
 }
 // ------------------------------------------------------------------------
 void Shader::Uniform3fv(const char *name, const glm::vec3 &value) const {
-  glUniform3fv(glGetUniformLocation(program_id_, name), 1, glm::value_ptr(value));
+  SetUniform(FindUniform(name, GL_FLOAT_VEC3), value);
 }
 void Shader::Uniform3f(const char *name, float x, float y, float z) const {
-  glUniform3f(glGetUniformLocation(program_id_, name), x, y, z);
+  SetUniform(FindUniform(name, GL_FLOAT_VEC3), glm::vec3(x, y, z));
 }
 // ------------------------------------------------------------------------
 void Shader::Uniform4fv(const char *name, const glm::vec4 &value) const {
-  glUniform4fv(glGetUniformLocation(program_id_, name), 1, glm::value_ptr(value));
+  SetUniform(FindUniform(name, GL_FLOAT_VEC4), value);
 }
 void Shader::Uniform4f(const char *name, float x, float y, float z, float w) const {
-  glUniform4f(glGetUniformLocation(program_id_, name), x, y, z, w);
+  SetUniform(FindUniform(name, GL_FLOAT_VEC4), glm::vec4(x, y, z, w));
 }
 // ------------------------------------------------------------------------
 void Shader::UniformMatrix2fv(const char *name, const glm::mat2 &value) const {
-  glUniformMatrix2fv(glGetUniformLocation(program_id_, name), 1, GL_FALSE, glm::value_ptr(value));
+  SetUniform(FindUniform(name, GL_FLOAT_MAT2), value);
 }
 // ------------------------------------------------------------------------
 void Shader::UniformMatrix3fv(const char *name, const glm::mat3 &value) const {
-  glUniformMatrix3fv(glGetUniformLocation(program_id_, name), 1, GL_FALSE, glm::value_ptr(value));
+  SetUniform(FindUniform(name, GL_FLOAT_MAT3), value);
 }
 // ------------------------------------------------------------------------
 void Shader::UniformMatrix4fv(const char *name, const glm::mat4 &value) const {
-  glUniformMatrix4fv(glGetUniformLocation(program_id_, name), 1, GL_FALSE, glm::value_ptr(value));
+  SetUniform(FindUniform(name, GL_FLOAT_MAT4), value);
 }
 
 };  // namespace bb3d
@@ -4,23 +4,46 @@
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 
-#include <glm/glm.hpp>  // for mat4, vec3, vec4
-#include <string>       // for string
+#include <array>          // for array
+#include <cstddef>        // for size_t
+#include <cstdint>        // for uint64_t
+#include <glm/glm.hpp>    // for mat2, mat3, mat4, vec2, vec3, vec4
+#include <memory>         // for shared_ptr, weak_ptr
+#include <string>         // for string
+#include <unordered_map>  // for unordered_map
+#include <vector>         // for vector
 
 namespace bb3d {
 
+template <typename T>
+class Uniform;
+
 class Shader {
  public:
   // constructor generates the shader on the fly
   // ------------------------------------------------------------------------
+  // Shader paths are relative to the workspace root, like "bb3d/shader/lines.vs", and the shaders
+  // of the bb3d target are compiled into the library. Other paths are read from disk.
+  //
+  // Programs are shared: a Shader whose sources are identical to those of a live Shader reuses its
+  // program instead of compiling another one.
   Shader(const std::string &vshader_path, const std::string &fshader_path,
          const std::string &gshader_path = std::string());
-  ~Shader();
+  ~Shader() = default;
   // activate the shader
   // ------------------------------------------------------------------------
+  // Through GlState, so it is skipped if the program is already in use.
   void UseProgram() const;
+  [[nodiscard]] GLuint ProgramId() const { return program_->id; }
   void VertexAttribPointer(const char *name, GLint size, GLenum type, GLboolean normalized,
                            GLsizei stride, const void *pointer) const;
+  // Location of an active attribute, or -1 if the program doesn't use it.
+  [[nodiscard]] GLint AttribLocation(const std::string &name) const;
+  // Typed handle to an active uniform, for drawables to keep as members instead of looking the
+  // uniform up by name every frame. Uniforms which the program doesn't use get a handle which does
+  // nothing, like glUniform with location -1.
+  template <typename T>
+  [[nodiscard]] Uniform<T> GetUniform(const std::string &name) const;
   // utility uniform functions
   void Uniform1i(const char *name, int value) const;
   void Uniform1f(const char *name, float value) const;
@@ -34,8 +57,107 @@ class Shader {
   void UniformMatrix3fv(const char *name, const glm::mat3 &value) const;
   void UniformMatrix4fv(const char *name, const glm::mat4 &value) const;
 
+  // Directory in which linked program binaries are kept between runs, keyed by the sources and the
+  // driver. Defaults to $BB3D_PROGRAM_CACHE_DIR, and an empty string (the default when that isn't
+  // set) disables the on-disk cache. Needs GL_ARB_get_program_binary.
+  static void SetProgramBinaryCacheDirectory(const std::string &directory);
+  // How the programs of all Shaders constructed so far were obtained.
+  struct ProgramCacheStats {
+    int compiled = 0;          // compiled and linked from source
+    int loaded_from_disk = 0;  // from the program binary cache directory
+    int shared = 0;            // reused from another live Shader
+  };
+  static ProgramCacheStats GetProgramCacheStats();
+  // Forget the programs of the previous GL context, so that they aren't shared with Shaders of the
+  // one which just became current. Window calls this for every context it creates.
+  static void ContextCreated();
+
+ private:
+  template <typename T>
+  friend class Uniform;
+
+  // An active uniform and the last value uploaded to it. Uniform values are program state, so the
+  // cache is valid whichever program was in use in between, and it is shared along with the program.
+  struct UniformSlot {
+    GLint location;
+    GLenum type;
+    bool valid;
+    std::array<unsigned char, sizeof(glm::mat4)> value;
+  };
+
+  // A linked program and its uniform value cache, shared by every Shader built from the same
+  // sources.
+  struct Program {
+    Program() = default;
+    ~Program();
+    Program(const Program &) = delete;
+    Program &operator=(const Program &) = delete;
+
+    GLuint id = 0;
+    int context_generation = 0;  // see ContextCreated
+    std::string sources{};
+    std::vector<UniformSlot> uniforms{};
+    std::unordered_map<std::string, int> uniform_slots{};
+    std::unordered_map<std::string, GLint> attrib_locations{};
+  };
+
+  // Programs live as long as some Shader uses them, and are only shared within their GL context.
+  static std::unordered_map<uint64_t, std::weak_ptr<Program> > &LivePrograms();
+
+  void Introspect();
+  // Index into uniforms_, or -1 for uniforms which the program doesn't use.
+  [[nodiscard]] int FindUniform(const std::string &name, GLenum type) const;
+  // Upload to uniforms_[slot] unless it already holds value. The program must be in use.
+  void SetUniform(int slot, int value) const;
+  void SetUniform(int slot, float value) const;
+  void SetUniform(int slot, const glm::vec2 &value) const;
+  void SetUniform(int slot, const glm::vec3 &value) const;
+  void SetUniform(int slot, const glm::vec4 &value) const;
+  void SetUniform(int slot, const glm::mat2 &value) const;
+  void SetUniform(int slot, const glm::mat3 &value) const;
+  void SetUniform(int slot, const glm::mat4 &value) const;
+  // Returns true if the value changed and has to be uploaded.
+  bool UpdateSlot(int slot, const void *value, size_t size) const;
+
+  // GLSL type matching each C++ type, to check handles against the program.
+  static GLenum GlslType(const int *);
+  static GLenum GlslType(const float *);
+  static GLenum GlslType(const glm::vec2 *);
+  static GLenum GlslType(const glm::vec3 *);
+  static GLenum GlslType(const glm::vec4 *);
+  static GLenum GlslType(const glm::mat2 *);
+  static GLenum GlslType(const glm::mat3 *);
+  static GLenum GlslType(const glm::mat4 *);
+
+  std::shared_ptr<Program> program_;
+};
+
+// Pre-resolved handle to a uniform of a Shader, see Shader::GetUniform. Set skips the upload when
+// the value hasn't changed since it was last set. Like the Shader::Uniform* functions, the program
+// has to be in use.
+template <typename T>
+class Uniform {
+ public:
+  Uniform() = default;
+  void Set(const T &value) const {
+    if (slot_ >= 0) {
+      shader_->SetUniform(slot_, value);
+    }
+  }
+  // False if the program doesn't use this uniform.
+  [[nodiscard]] bool Active() const { return slot_ >= 0; }
+
  private:
-  GLuint program_id_;
+  friend class Shader;
+  Uniform(const Shader *shader, int slot) : shader_(shader), slot_(slot) {}
+
+  const Shader *shader_ = nullptr;
+  int slot_ = -1;
 };
 
+template <typename T>
+Uniform<T> Shader::GetUniform(const std::string &name) const {
+  return Uniform<T>(this, FindUniform(name, GlslType(static_cast<const T *>(nullptr))));
+}
+
 };  // namespace bb3d
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <array>    // for array
+#include <cstddef>  // for size_t
+#include <vector>   // for vector
+
+namespace bb3d {
+
+// Read-only view of contiguous elements, a stand-in for C++20's std::span<const T>. It does not own
+// the data, which has to outlive it.
+template <typename T>
+class Span {
+ public:
+  constexpr Span() = default;
+  constexpr Span(const T *data, size_t size) : data_(data), size_(size) {}
+  // Implicit so that vectors and arrays can be passed where a Span is expected.
+  Span(const std::vector<T> &vec) : data_(vec.data()), size_(vec.size()) {}  // NOLINT
+  template <size_t N>
+  constexpr Span(const std::array<T, N> &arr) : data_(arr.data()), size_(N) {}  // NOLINT
+
+  [[nodiscard]] constexpr const T *data() const { return data_; }
+  [[nodiscard]] constexpr size_t size() const { return size_; }
+  [[nodiscard]] constexpr bool empty() const { return size_ == 0; }
+  constexpr const T &operator[](size_t k) const { return data_[k]; }  // NOLINT
+  [[nodiscard]] constexpr const T *begin() const { return data_; }
+  [[nodiscard]] constexpr const T *end() const { return data_ + size_; }  // NOLINT
+
+ private:
+  const T *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+};  // namespace bb3d
@@ -0,0 +1,158 @@
+#include "bb3d/streaming_buffer.hpp"
+
+#include <GL/glew.h>  // for glBufferStorage, glMapBufferRange, glFenceSync, glClientWaitSync
+
+#include <algorithm>  // for max
+#include <cstddef>    // for size_t
+#include <cstdio>     // for fprintf, stderr
+#include <cstring>    // for memcpy
+#include <vector>     // for vector
+
+namespace bb3d {
+
+bool StreamingBuffer::PersistentMappingSupported() { return GLEW_ARB_buffer_storage != 0; }
+
+StreamingBuffer::StreamingBuffer(UploadMode mode, const GLsizei vertex_stride)
+    : mode_(mode), vertex_stride_(vertex_stride), staging_() {
+  if (mode_ == UploadMode::kPersistentMapped && !PersistentMappingSupported()) {
+    fprintf(stderr,
+            "GL_ARB_buffer_storage is not supported, falling back to glBufferSubData uploads.\n");
+    mode_ = UploadMode::kBufferSubData;
+  }
+
+  glGenBuffers(1, &buffer_);
+  if (mode_ == UploadMode::kBufferSubData) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+    glBufferData(GL_ARRAY_BUFFER, current_buffer_size_, nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+}
+
+StreamingBuffer::~StreamingBuffer() {
+  for (GLsync &fence : fences_) {
+    if (fence != nullptr) {
+      glDeleteSync(fence);
+    }
+  }
+  if (mapped_ != nullptr) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+  glDeleteBuffers(1, &buffer_);
+}
+
+void *StreamingBuffer::Reserve(const GLsizei num_vertices) {
+  const auto size = static_cast<size_t>(num_vertices) * static_cast<size_t>(vertex_stride_);
+
+  if (mode_ == UploadMode::kBufferSubData) {
+    staging_.resize(size);
+    return staging_.data();
+  }
+
+  // Fence the region we just used so we know when the GPU is done reading it, and move on.
+  if (region_in_use_) {
+    fences_[static_cast<size_t>(region_)] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    region_ = (region_ + 1) % kNumRegions;
+    region_in_use_ = false;
+  }
+
+  if (num_vertices > region_capacity_) {
+    // Grow geometrically so a slowly growing trajectory doesn't reallocate every frame.
+    Reallocate(std::max(num_vertices, 2 * region_capacity_));
+  }
+
+  WaitForRegion(region_);
+  region_in_use_ = true;
+  return mapped_ + static_cast<size_t>(region_) * static_cast<size_t>(region_capacity_) *
+                       static_cast<size_t>(vertex_stride_);
+}
+
+GLint StreamingBuffer::Commit() {
+  if (mode_ == UploadMode::kPersistentMapped) {
+    // The mapping is coherent, so there is nothing to flush.
+    return region_ * region_capacity_;
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+  const auto buffer_size = static_cast<GLsizeiptr>(staging_.size());
+  if (buffer_size == current_buffer_size_) {
+    // if the size of data is the same, just update the buffer
+    glBufferSubData(GL_ARRAY_BUFFER, 0, buffer_size, staging_.data());
+  } else {
+    // if the size of data has changed, we have to reallocate GPU memory
+    glBufferData(GL_ARRAY_BUFFER, buffer_size, staging_.data(), GL_DYNAMIC_DRAW);
+    current_buffer_size_ = buffer_size;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return 0;
+}
+
+GLint StreamingBuffer::Upload(const void *data, const GLsizei num_vertices) {
+  const auto size = static_cast<size_t>(num_vertices) * static_cast<size_t>(vertex_stride_);
+  if (mode_ == UploadMode::kPersistentMapped) {
+    void *destination = Reserve(num_vertices);
+    if (size > 0) {
+      memcpy(destination, data, size);
+    }
+    return Commit();
+  }
+
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+  const auto buffer_size = static_cast<GLsizeiptr>(size);
+  if (buffer_size == current_buffer_size_) {
+    glBufferSubData(GL_ARRAY_BUFFER, 0, buffer_size, data);
+  } else {
+    glBufferData(GL_ARRAY_BUFFER, buffer_size, data, GL_DYNAMIC_DRAW);
+    current_buffer_size_ = buffer_size;
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return 0;
+}
+
+void StreamingBuffer::Reallocate(const GLsizei region_capacity) {
+  // Storage allocated with glBufferStorage is immutable, so growing means a new buffer object. The
+  // GL keeps the old one alive until the draw calls which reference it have completed.
+  for (GLsync &fence : fences_) {
+    if (fence != nullptr) {
+      glDeleteSync(fence);
+      fence = nullptr;
+    }
+  }
+  if (mapped_ != nullptr) {
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+    glUnmapBuffer(GL_ARRAY_BUFFER);
+    glDeleteBuffers(1, &buffer_);
+    glGenBuffers(1, &buffer_);
+  }
+
+  region_capacity_ = region_capacity;
+  region_ = 0;
+  const auto buffer_size = static_cast<GLsizeiptr>(kNumRegions) *
+                           static_cast<GLsizeiptr>(region_capacity_) *
+                           static_cast<GLsizeiptr>(vertex_stride_);
+  // NOLINTNEXTLINE(hicpp-signed-bitwise)
+  const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+  glBindBuffer(GL_ARRAY_BUFFER, buffer_);
+  glBufferStorage(GL_ARRAY_BUFFER, buffer_size, nullptr, flags);
+  mapped_ = static_cast<unsigned char *>(glMapBufferRange(GL_ARRAY_BUFFER, 0, buffer_size, flags));
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  generation_++;
+}
+
+void StreamingBuffer::WaitForRegion(const int region) {
+  GLsync &fence = fences_[static_cast<size_t>(region)];
+  if (fence == nullptr) {
+    return;
+  }
+  const GLuint64 timeout_ns = 1000000000;
+  GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, timeout_ns);
+  while (status == GL_TIMEOUT_EXPIRED) {
+    status = glClientWaitSync(fence, 0, timeout_ns);
+  }
+  glDeleteSync(fence);
+  fence = nullptr;
+}
+
+};  // namespace bb3d
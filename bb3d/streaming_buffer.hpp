@@ -0,0 +1,72 @@
+#pragma once
+
+#include <GL/glew.h>  // for GLuint, GLint, GLsizei, GLsync
+
+#include <array>   // for array
+#include <vector>  // for vector
+
+namespace bb3d {
+
+enum class UploadMode {
+  // Pack vertices into a CPU-side staging vector, then glBufferSubData (or glBufferData when the
+  // size changes) into a single buffer.
+  kBufferSubData,
+  // Write vertices straight into a persistently mapped GL_ARB_buffer_storage ring. Falls back to
+  // kBufferSubData when the extension is not available.
+  kPersistentMapped,
+};
+
+// A vertex buffer which is completely rewritten every Update.
+//
+// In kPersistentMapped mode the buffer is split into kNumRegions regions which are used round
+// robin. Each region is guarded by a fence placed when we move on from it, and we only wait on that
+// fence when we come back around to the region, by which time the GPU has normally long since
+// finished reading it. So writing never stalls on the draw calls of the previous frames.
+class StreamingBuffer {
+ public:
+  StreamingBuffer(UploadMode mode, GLsizei vertex_stride);
+  ~StreamingBuffer();
+  StreamingBuffer(const StreamingBuffer &) = delete;
+  StreamingBuffer &operator=(const StreamingBuffer &) = delete;
+
+  // Returns memory to write num_vertices vertices to. Only valid until Commit.
+  void *Reserve(GLsizei num_vertices);
+  // Makes the vertices written since Reserve available to draw calls. Returns the index of the
+  // first one in Buffer(), to be used as the `first` argument of glDrawArrays.
+  GLint Commit();
+  // Reserve + copy + Commit for vertices which are already laid out for the GPU. In kBufferSubData
+  // mode this uploads straight from `data` without going through the staging vector.
+  GLint Upload(const void *data, GLsizei num_vertices);
+
+  [[nodiscard]] GLuint Buffer() const { return buffer_; }
+  // Bumped whenever Buffer() is replaced by a new buffer object, after which vertex attribute
+  // pointers need to be specified again.
+  [[nodiscard]] int Generation() const { return generation_; }
+  [[nodiscard]] UploadMode Mode() const { return mode_; }
+
+  static bool PersistentMappingSupported();
+
+ private:
+  static constexpr int kNumRegions = 3;
+
+  void Reallocate(GLsizei region_capacity);
+  void WaitForRegion(int region);
+
+  UploadMode mode_;
+  GLsizei vertex_stride_;
+  GLuint buffer_{};
+  int generation_ = 0;
+
+  // kBufferSubData
+  std::vector<unsigned char> staging_;
+  GLsizeiptr current_buffer_size_ = 0;
+
+  // kPersistentMapped
+  unsigned char *mapped_ = nullptr;
+  GLsizei region_capacity_ = 0;  // in vertices
+  int region_ = 0;
+  bool region_in_use_ = false;
+  std::array<GLsync, kNumRegions> fences_{};
+};
+
+};  // namespace bb3d
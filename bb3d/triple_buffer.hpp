@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>    // for array
+#include <atomic>   // for atomic, memory_order_acq_rel, memory_order_acquire
+#include <cstddef>  // for size_t
+#include <cstdint>  // for uint8_t
+
+namespace bb3d {
+
+// Lock-free single-producer single-consumer triple buffer.
+//
+// The producer fills Back() and calls Publish(), which swaps the back slot with the shared middle
+// slot in one atomic exchange. The consumer calls Consume(), which swaps the middle slot into
+// Front() only if something new was published. Neither side ever waits on the other: the producer
+// can publish faster than the consumer reads (intermediate values are dropped) and the consumer
+// keeps drawing the newest complete value it has seen.
+//
+// After Publish() the producer gets a recycled slot which still holds an older value. It must
+// overwrite everything it cares about, but it can reuse the slot's allocations (e.g. clear() a
+// std::vector instead of constructing a new one).
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() = default;
+  ~TripleBuffer() = default;
+  TripleBuffer(const TripleBuffer &) = delete;
+  TripleBuffer &operator=(const TripleBuffer &) = delete;
+
+  // producer side
+  T &Back() { return slots_[back_]; }
+  void Publish() {
+    const uint8_t previous_middle =
+        middle_.exchange(static_cast<uint8_t>(back_ | kFreshBit), std::memory_order_acq_rel);
+    back_ = static_cast<uint8_t>(previous_middle & kIndexMask);
+  }
+
+  // consumer side
+  // Returns true if a new value was published since the last call, in which case Front() now
+  // holds it. Returns false (and leaves Front() alone) otherwise.
+  bool Consume() {
+    if ((middle_.load(std::memory_order_acquire) & kFreshBit) == 0) {
+      return false;
+    }
+    const uint8_t previous_middle = middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = static_cast<uint8_t>(previous_middle & kIndexMask);
+    return true;
+  }
+  [[nodiscard]] const T &Front() const { return slots_[front_]; }
+
+ private:
+  static constexpr uint8_t kIndexMask = 0x3;
+  static constexpr uint8_t kFreshBit = 0x4;
+  // Keep the producer's and consumer's private indices on separate cache lines so that the only
+  // shared write traffic is the middle index.
+  static constexpr size_t kCacheLine = 64;
+
+  std::array<T, 3> slots_{};
+  alignas(kCacheLine) std::atomic<uint8_t> middle_{1};
+  alignas(kCacheLine) uint8_t back_ = 0;
+  alignas(kCacheLine) uint8_t front_ = 2;
+};
+
+};  // namespace bb3d
@@ -0,0 +1,32 @@
+#include "bb3d/vertex_format.hpp"
+
+#include <algorithm>  // for min, max
+#include <cmath>      // for lround
+
+namespace bb3d {
+
+uint32_t PackRgba8(const glm::vec4 &color) {
+  const auto to_byte = [](float value) {
+    return static_cast<uint32_t>(std::lround(255.0F * std::min(std::max(value, 0.0F), 1.0F)));
+  };
+  return to_byte(color.r) | (to_byte(color.g) << 8U) | (to_byte(color.b) << 16U) |
+         (to_byte(color.a) << 24U);
+}
+
+Quantization::Quantization(const Aabb &bounds) {
+  if (bounds.Empty()) {
+    return;
+  }
+  origin_ = bounds.min;
+  scale_ = bounds.max - bounds.min;
+  for (int axis = 0; axis < 3; axis++) {
+    inverse_scale_[axis] = scale_[axis] > 0 ? 65535.0F / scale_[axis] : 0.0F;
+  }
+}
+
+uint16_t Quantization::Quantize(const float value, const int axis) const {
+  const float quantized = (value - origin_[axis]) * inverse_scale_[axis];
+  return static_cast<uint16_t>(std::lround(std::min(std::max(quantized, 0.0F), 65535.0F)));
+}
+
+};  // namespace bb3d
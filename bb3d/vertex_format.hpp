@@ -0,0 +1,42 @@
+#pragma once
+
+#include <cstdint>      // for uint16_t, uint32_t
+#include <glm/glm.hpp>  // for vec3, vec4
+
+#include "bb3d/culling.hpp"  // for Aabb
+
+namespace bb3d {
+
+enum class VertexFormat {
+  // 32 bit float positions and colors, uploaded as given.
+  kFloat,
+  // Positions quantized to 16 bits between the bounds of the data and RGBA8 colors, about half the
+  // size. The vertex shader dequantizes the positions, whose error is at most 1/131070 of the
+  // bounds in each direction, e.g. 1.5 cm across 2 km.
+  kCompact,
+};
+
+// Pack a color with components in [0, 1] into RGBA8, red in the lowest byte, which is the byte
+// order of GL_UNSIGNED_BYTE attributes and of GLSL's unpackUnorm4x8.
+uint32_t PackRgba8(const glm::vec4 &color);
+
+// Maps positions inside a box to 16 bit unsigned integers, which the vertex shader turns back into
+// origin + scale * normalized, normalized being the integers divided by 65535 by a normalized
+// GL_UNSIGNED_SHORT attribute.
+class Quantization {
+ public:
+  // The identity, for VertexFormat::kFloat.
+  Quantization() = default;
+  explicit Quantization(const Aabb &bounds);
+
+  [[nodiscard]] uint16_t Quantize(float value, int axis) const;
+  [[nodiscard]] const glm::vec3 &Origin() const { return origin_; }
+  [[nodiscard]] const glm::vec3 &Scale() const { return scale_; }
+
+ private:
+  glm::vec3 origin_{0.0F};
+  glm::vec3 scale_{1.0F};
+  glm::vec3 inverse_scale_{1.0F};  // 65535 / scale_, 0 where the box is flat
+};
+
+};  // namespace bb3d
@@ -0,0 +1,423 @@
+// Microbenchmarks of every drawable's Update and Draw path over a range of sizes, in a headless
+// context so that they also run on CI machines with Mesa's llvmpipe. Every case has two CPU
+// timings: preparing the data on the caller's side (flattening polylines into one array, laying out
+// text, filling grids) and submitting it (the drawable's call, which packs and uploads the data or
+// issues the draw). Both are reported separately from the GPU time of the submitted commands,
+// measured with GL_TIMESTAMP queries through Profiler. The results go to stdout as JSON, and a
+// table to stderr.
+//
+//   bazel run //:bb3d_benchmarks -- [--texture <image>] [--max_vertices N] [--filter <substring>]
+//
+// Cases which would make more than --max_vertices vertices (default 1e7) are left out. Gridmesh is
+// textured with --texture, or with a generated checkerboard.
+
+#include <GL/glew.h>    // for glFinish, glClear, glGetString, GL_RENDERER, GL_VERSION, GLint
+#include <SOIL/SOIL.h>  // for SOIL_save_image, SOIL_SAVE_TYPE_TGA
+#include <unistd.h>     // for rmdir
+
+#include <cmath>               // for sin, cos
+#include <cstddef>             // for size_t
+#include <cstdio>              // for printf, fprintf, snprintf, perror, remove
+#include <cstdlib>             // for EXIT_SUCCESS, EXIT_FAILURE, atof, exit, mkdtemp
+#include <cstring>             // for strcmp
+#include <eigen3/Eigen/Dense>  // for Matrix, Dynamic
+#include <glm/glm.hpp>         // for mat4, vec2, vec3, vec4
+#include <string>              // for string, to_string
+#include <utility>             // for pair, make_pair, move
+#include <vector>              // for vector
+
+#include "bb3d/opengl_context.hpp"          // for Window, HeadlessOptions
+#include "bb3d/profiler.hpp"                // for Profiler, TimerStats
+#include "bb3d/shader/camera_uniforms.hpp"  // for CameraUniforms
+#include "bb3d/shader/colorlines.hpp"       // for ColorLines, ColoredVec3
+#include "bb3d/shader/cubemesh.hpp"         // for Cubemesh, CubemeshMode
+#include "bb3d/shader/freetype.hpp"         // for Freetype
+#include "bb3d/shader/gridmesh.hpp"         // for Gridmesh
+#include "bb3d/shader/labels.hpp"           // for Labels, Label
+#include "bb3d/shader/lines.hpp"            // for Lines
+
+namespace {
+
+constexpr int kMinIterations = 5;
+constexpr int kMaxIterations = 200;  // at most Profiler::kWindowSize, so every sample counts
+constexpr double kMinMilliseconds = 500;
+constexpr int kVerticesPerPolyline = 100;
+
+const std::vector<int> kVertexCounts = {1000, 10000, 100000, 1000000, 10000000};
+// Square grids of about 1e3 to 1e7 cells and a long thin one.
+const std::vector<std::pair<int, int> > kGridShapes = {
+    {32, 32}, {100, 100}, {316, 316}, {1000, 1000}, {3162, 3162}, {10, 100000}};
+const std::vector<int> kTextLengths = {10, 100, 1000, 10000};
+const std::vector<int> kLabelCounts = {100, 1000, 10000, 100000};
+
+using Params = std::vector<std::pair<std::string, int> >;
+
+struct Options {
+  std::string texture{};
+  double max_vertices = 1e7;
+  std::string filter{};
+};
+
+class Suite {
+ public:
+  explicit Suite(Options options) : options_(std::move(options)) {}
+
+  // Whether cases of this size are run. Checked before building the input data.
+  [[nodiscard]] bool Fits(const double vertices) const {
+    return vertices <= options_.max_vertices;
+  }
+
+  // Time `prepare` followed by `submit` until kMinMilliseconds have passed (at least
+  // kMinIterations, at most kMaxIterations times). gpu_timer is the name of the Profiler GPU scope
+  // which submit records.
+  template <typename Prepare, typename Submit>
+  void Run(const std::string &name, const Params &params, const char *gpu_timer, Prepare prepare,
+           Submit submit) {
+    const std::string label = name + " " + ParamsText(params);
+    if (label.find(options_.filter) == std::string::npos) {
+      return;
+    }
+
+    bb3d::Profiler &profiler = bb3d::Profiler::Get();
+    const auto iteration = [&]() {
+      // Clear outside of the timed region, so every Draw rasterizes the same amount.
+      // NOLINTNEXTLINE(hicpp-signed-bitwise)
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+      {
+        const bb3d::Profiler::CpuScope cpu_scope("prepare");
+        prepare();
+      }
+      {
+        const bb3d::Profiler::CpuScope cpu_scope("submit");
+        submit();
+      }
+      glFinish();
+      profiler.BeginFrame();
+    };
+    iteration();  // warm up
+    Drain();
+    profiler.Reset();
+
+    int iterations = 0;
+    double elapsed_ms = 0;
+    while (iterations < kMaxIterations &&
+           (iterations < kMinIterations || elapsed_ms < kMinMilliseconds)) {
+      iteration();
+      iterations++;
+      const bb3d::TimerStats prepared = profiler.CpuStats("prepare");
+      const bb3d::TimerStats submitted = profiler.CpuStats("submit");
+      elapsed_ms = (prepared.mean_ms + submitted.mean_ms) * submitted.num_samples;
+    }
+    Drain();
+
+    const bb3d::TimerStats prepared = profiler.CpuStats("prepare");
+    const bb3d::TimerStats submitted = profiler.CpuStats("submit");
+    const bb3d::TimerStats gpu = profiler.GpuStats(gpu_timer);
+    fprintf(stderr, "%-48s %9.3f %9.3f %9.3f %9.3f %9.3f\n", label.c_str(), prepared.mean_ms,
+            submitted.mean_ms, submitted.p99_ms, gpu.mean_ms, gpu.p99_ms);
+    results_.push_back("    {\"name\": \"" + name + "\", \"params\": " + ParamsJson(params) +
+                       ", \"iterations\": " + std::to_string(iterations) +
+                       ", \"prepare_ms\": " + StatsJson(prepared) +
+                       ", \"submit_ms\": " + StatsJson(submitted) + ", \"gpu_ms\": " +
+                       StatsJson(gpu) + "}");
+  }
+
+  void PrintJson() const {
+    printf("{\n  \"context\": {\"renderer\": \"%s\", \"version\": \"%s\"},\n  \"benchmarks\": [\n",
+           glGetString(GL_RENDERER), glGetString(GL_VERSION));
+    for (size_t k = 0; k < results_.size(); k++) {
+      printf("%s%s\n", results_[k].c_str(), k + 1 < results_.size() ? "," : "");
+    }
+    printf("  ]\n}\n");
+  }
+
+ private:
+  // Collect the GPU timings still in flight.
+  static void Drain() {
+    glFinish();
+    for (int k = 0; k < bb3d::Profiler::kFramesInFlight; k++) {
+      bb3d::Profiler::Get().BeginFrame();
+    }
+  }
+
+  static std::string ParamsText(const Params &params) {
+    std::string text;
+    for (const auto &param : params) {
+      text += (text.empty() ? "" : " ") + param.first + "=" + std::to_string(param.second);
+    }
+    return text;
+  }
+
+  static std::string ParamsJson(const Params &params) {
+    std::string json = "{";
+    for (const auto &param : params) {
+      json += (json.size() > 1 ? ", \"" : "\"") + param.first + "\": " +
+              std::to_string(param.second);
+    }
+    return json + "}";
+  }
+
+  static std::string StatsJson(const bb3d::TimerStats &stats) {
+    std::string json(128, '\0');
+    const int length = snprintf(json.data(), json.size(),
+                                R"({"min": %.4f, "mean": %.4f, "p99": %.4f})", stats.min_ms,
+                                stats.mean_ms, stats.p99_ms);
+    json.resize(static_cast<size_t>(length));
+    return json;
+  }
+
+  Options options_;
+  std::vector<std::string> results_{};
+};
+
+// Polylines of kVerticesPerPolyline vertices, inside [-1, 1].
+std::vector<std::vector<glm::vec3> > MakePolylines(const int num_vertices) {
+  std::vector<std::vector<glm::vec3> > polylines(
+      static_cast<size_t>(num_vertices / kVerticesPerPolyline));
+  for (size_t kp = 0; kp < polylines.size(); kp++) {
+    const float radius = static_cast<float>(kp + 1) / static_cast<float>(polylines.size());
+    for (int kv = 0; kv < kVerticesPerPolyline; kv++) {
+      const float angle = 6.28F * static_cast<float>(kv) / kVerticesPerPolyline;
+      polylines[kp].emplace_back(radius * std::cos(angle), radius * std::sin(angle), 0);
+    }
+  }
+  return polylines;
+}
+
+// Concatenate polylines into one array of vertices and the offsets where each starts, the layout
+// which the Update(Span, Span) overloads upload as is.
+template <typename T>
+void Flatten(const std::vector<std::vector<T> > &polylines, std::vector<T> &vertices,
+             std::vector<GLint> &offsets) {
+  vertices.clear();
+  offsets.clear();
+  for (const std::vector<T> &polyline : polylines) {
+    offsets.push_back(static_cast<GLint>(vertices.size()));
+    vertices.insert(vertices.end(), polyline.begin(), polyline.end());
+  }
+}
+
+void BenchmarkLines(Suite &suite) {
+  for (const int num_vertices : kVertexCounts) {
+    if (!suite.Fits(num_vertices)) {
+      continue;
+    }
+    const Params params = {{"vertices", num_vertices}};
+    const std::vector<std::vector<glm::vec3> > polylines = MakePolylines(num_vertices);
+
+    std::vector<std::vector<bb3d::ColoredVec3> > colored(polylines.size());
+    for (size_t kp = 0; kp < polylines.size(); kp++) {
+      for (const glm::vec3 &position : polylines[kp]) {
+        colored[kp].push_back({position, {position.x, position.y, 1, 1}});
+      }
+    }
+    bb3d::ColorLines color_lines;
+    std::vector<bb3d::ColoredVec3> colored_vertices;
+    std::vector<GLint> offsets;
+    suite.Run(
+        "ColorLines::Update", params, "ColorLines::Update",
+        [&]() { Flatten(colored, colored_vertices, offsets); },
+        [&]() { color_lines.Update(colored_vertices, offsets); });
+    suite.Run(
+        "ColorLines::Draw", params, "ColorLines::Draw", []() {},
+        [&]() { color_lines.Draw(GL_LINE_STRIP); });
+
+    bb3d::Lines lines;
+    std::vector<glm::vec3> vertices;
+    suite.Run(
+        "Lines::Update", params, "Lines::Update",
+        [&]() { Flatten(polylines, vertices, offsets); },
+        [&]() { lines.Update(vertices, offsets); });
+    suite.Run(
+        "Lines::Draw", params, "Lines::Draw", []() {},
+        [&]() { lines.Draw({1, 1, 1, 1}, GL_LINE_STRIP); });
+  }
+}
+
+void BenchmarkCubemesh(Suite &suite) {
+  for (const bb3d::CubemeshMode mode :
+       {bb3d::CubemeshMode::kExpanded, bb3d::CubemeshMode::kInstanced}) {
+    const bool instanced = mode == bb3d::CubemeshMode::kInstanced;
+    for (const auto &shape : kGridShapes) {
+      const Params params = {
+          {"rows", shape.first}, {"cols", shape.second}, {"instanced", instanced ? 1 : 0}};
+      const double cells = static_cast<double>(shape.first) * static_cast<double>(shape.second);
+      // kExpanded makes 4 vertices per cell
+      if (!suite.Fits(instanced ? cells : 4 * cells)) {
+        continue;
+      }
+      Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> grid(shape.first,
+                                                                                      shape.second);
+      const auto fill_grid = [&]() {
+        for (int ku = 0; ku < shape.first; ku++) {
+          for (int kv = 0; kv < shape.second; kv++) {
+            const float height = 0.25F * static_cast<float>((ku + kv) % 3);
+            grid(ku, kv) = std::make_pair(height, glm::vec3(height, 0.5F, 1 - height));
+          }
+        }
+      };
+      bb3d::Cubemesh cubemesh(mode);
+      suite.Run("Cubemesh::Update", params, "Cubemesh::Update", fill_grid,
+                [&]() { cubemesh.Update(grid, -1, 1, -1, 1); });
+      suite.Run(
+          "Cubemesh::Draw", params, "Cubemesh::Draw", []() {}, [&]() { cubemesh.Draw(); });
+    }
+  }
+}
+
+void BenchmarkGridmesh(Suite &suite, const std::string &texture) {
+  for (const auto &shape : kGridShapes) {
+    const Params params = {{"rows", shape.first}, {"cols", shape.second}, {"heightmap", 0}};
+    const Params heightmap_params = {
+        {"rows", shape.first}, {"cols", shape.second}, {"heightmap", 1}};
+    if (!suite.Fits(static_cast<double>(shape.first) * static_cast<double>(shape.second))) {
+      continue;
+    }
+    Eigen::Matrix<glm::vec3, Eigen::Dynamic, Eigen::Dynamic> grid(shape.first, shape.second);
+    Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> heights(shape.first, shape.second);
+    const auto height = [](int ku, int kv) {
+      return 0.1F * std::sin(0.01F * static_cast<float>(ku + kv));
+    };
+    const auto fill_grid = [&]() {
+      for (int ku = 0; ku < shape.first; ku++) {
+        for (int kv = 0; kv < shape.second; kv++) {
+          grid(ku, kv) =
+              glm::vec3(2 * static_cast<float>(ku) / static_cast<float>(shape.first) - 1,
+                        2 * static_cast<float>(kv) / static_cast<float>(shape.second) - 1,
+                        height(ku, kv));
+        }
+      }
+    };
+    const auto fill_heights = [&]() {
+      for (int ku = 0; ku < shape.first; ku++) {
+        for (int kv = 0; kv < shape.second; kv++) {
+          heights(ku, kv) = height(ku, kv);
+        }
+      }
+    };
+    bb3d::Gridmesh gridmesh(texture);
+    suite.Run("Gridmesh::Update", params, "Gridmesh::Update", fill_grid,
+              [&]() { gridmesh.Update(grid); });
+    suite.Run(
+        "Gridmesh::Draw", params, "Gridmesh::Draw", []() {}, [&]() { gridmesh.Draw(); });
+    suite.Run("Gridmesh::UpdateHeightmap", heightmap_params, "Gridmesh::UpdateHeightmap",
+              fill_heights, [&]() { gridmesh.UpdateHeightmap(heights, -1, 1, -1, 1); });
+    suite.Run(
+        "Gridmesh::Draw", heightmap_params, "Gridmesh::Draw", []() {},
+        [&]() { gridmesh.Draw(); });
+  }
+}
+
+void BenchmarkText(Suite &suite, const glm::mat4 &orthographic_projection) {
+  bb3d::Freetype freetype(14);
+  for (const int length : kTextLengths) {
+    if (!suite.Fits(6.0 * length)) {  // 6 vertices per glyph
+      continue;
+    }
+    std::string text;
+    for (int k = 0; k < length; k++) {
+      text.push_back(static_cast<char>('!' + k % 94));
+    }
+    // RenderText is AddText, which lays the text out on the CPU, followed by Flush.
+    suite.Run(
+        "Freetype::RenderText", {{"characters", length}}, "Freetype::Flush",
+        [&]() { freetype.AddText(text, 10, 10, {1, 1, 1}); },
+        [&]() { freetype.Flush(orthographic_projection); });
+  }
+
+  bb3d::Labels labels(freetype.Atlas());
+  for (const int num_labels : kLabelCounts) {
+    if (!suite.Fits(6.0 * 10 * num_labels)) {  // about 10 glyphs per label
+      continue;
+    }
+    std::vector<bb3d::Label> new_labels;
+    const auto make_labels = [&]() {
+      new_labels.clear();
+      for (int k = 0; k < num_labels; k++) {
+        const float angle = 0.001F * static_cast<float>(k);
+        new_labels.push_back(
+            {{std::cos(angle), std::sin(angle), 0}, "label " + std::to_string(k)});
+      }
+    };
+    const Params params = {{"labels", num_labels}};
+    suite.Run("Labels::Update", params, "Labels::Update", make_labels,
+              [&]() { labels.Update(new_labels); });
+    suite.Run(
+        "Labels::Draw", params, "Labels::Draw", []() {}, [&]() { labels.Draw(); });
+  }
+}
+
+// Write a checkerboard image for Gridmesh into a new directory under /tmp, and return its path.
+std::string WriteCheckerboard() {
+  std::string directory = "/tmp/bb3d_benchmarks_XXXXXX";
+  if (mkdtemp(directory.data()) == nullptr) {
+    perror("mkdtemp");
+    exit(EXIT_FAILURE);
+  }
+  const int size = 256;
+  const int square = 32;
+  std::vector<unsigned char> pixels(static_cast<size_t>(4 * size * size));
+  for (int row = 0; row < size; row++) {
+    for (int col = 0; col < size; col++) {
+      const bool light = (row / square + col / square) % 2 == 0;
+      unsigned char *pixel = &pixels[static_cast<size_t>(4 * (row * size + col))];
+      pixel[0] = light ? 230 : 40;
+      pixel[1] = light ? 230 : 90;
+      pixel[2] = light ? 230 : 160;
+      pixel[3] = 255;
+    }
+  }
+  const std::string path = directory + "/checkerboard.tga";
+  if (SOIL_save_image(path.c_str(), SOIL_SAVE_TYPE_TGA, size, size, 4, pixels.data()) == 0) {
+    fprintf(stderr, "Can't write %s\n", path.c_str());
+    exit(EXIT_FAILURE);
+  }
+  return path;
+}
+
+};  // namespace
+
+int main(int argc, char *argv[]) {
+  Options options;
+  for (int k = 1; k < argc; k += 2) {
+    if (k + 1 < argc && strcmp(argv[k], "--texture") == 0) {
+      options.texture = argv[k + 1];
+    } else if (k + 1 < argc && strcmp(argv[k], "--max_vertices") == 0) {
+      options.max_vertices = std::atof(argv[k + 1]);
+    } else if (k + 1 < argc && strcmp(argv[k], "--filter") == 0) {
+      options.filter = argv[k + 1];
+    } else {
+      fprintf(stderr, "usage: %s [--texture <image>] [--max_vertices N] [--filter <substring>]\n",
+              argv[0]);
+      return EXIT_FAILURE;
+    }
+  }
+
+  bb3d::Window window(argv[0], bb3d::HeadlessOptions());
+  bb3d::Profiler::Get().SetEnabled(true);
+
+  // Identity view and projection, and all the data inside [-1, 1], so everything is on screen.
+  const bb3d::Window::Size size = window.GetSize();
+  bb3d::CameraUniforms::Get().Update(
+      glm::mat4(1), glm::mat4(1),
+      glm::vec2(static_cast<float>(size.width), static_cast<float>(size.height)), 0);
+
+  const bool generate_texture = options.texture.empty();
+  const std::string texture = generate_texture ? WriteCheckerboard() : options.texture;
+
+  Suite suite(options);
+  fprintf(stderr, "%-48s %9s %9s %9s %9s %9s\n", "case", "prep mean", "sub mean", "sub p99",
+          "gpu mean", "gpu p99");
+  BenchmarkLines(suite);
+  BenchmarkCubemesh(suite);
+  BenchmarkGridmesh(suite, texture);
+  BenchmarkText(suite, window.GetOrthographicProjection());
+  suite.PrintJson();
+
+  if (generate_texture) {
+    std::remove(texture.c_str());
+    rmdir(texture.substr(0, texture.rfind('/')).c_str());
+  }
+
+  return EXIT_SUCCESS;
+}
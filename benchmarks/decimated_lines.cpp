@@ -0,0 +1,83 @@
+// Frame times of a DecimatedLines telemetry trace of tens of millions of samples, in a headless
+// window whose camera zooms from the whole trace in to a few seconds of it, so every frame
+// decimates again. Frame times and vertices drawn should depend on the zoom only weakly and not on
+// the number of samples.
+//
+//   bazel run //:decimated_lines -- [millions of samples] [threads]
+
+#include <sys/types.h>  // for key_t
+
+#include <algorithm>    // for sort
+#include <chrono>       // for steady_clock, duration
+#include <cmath>        // for sin, pow
+#include <cstdio>       // for printf
+#include <cstdlib>      // for EXIT_SUCCESS, atof, atoi
+#include <functional>   // for function
+#include <glm/glm.hpp>  // for mat4, vec3, vec4
+#include <random>       // for mt19937, normal_distribution
+#include <utility>      // for move
+#include <vector>       // for vector
+
+#include "bb3d/opengl_context.hpp"         // for Window, HeadlessOptions
+#include "bb3d/shader/decimatedlines.hpp"  // for DecimatedLines
+
+// Four hours at 1 kHz is 14.4M samples: a slow oscillation, noise and occasional spikes, plotted
+// as (seconds / 10, value, 0).
+static std::vector<glm::vec3> Telemetry(const size_t num_samples) {
+  std::mt19937 generator(0);
+  std::normal_distribution<float> noise(0.0F, 0.05F);
+  std::vector<glm::vec3> samples(num_samples);
+  for (size_t k = 0; k < num_samples; k++) {
+    const float seconds = static_cast<float>(k) * 1e-3F;
+    const float spike = k % 1000003 == 0 ? 5.0F : 0.0F;
+    samples[k] = {0.1F * seconds, std::sin(0.01F * seconds) + noise(generator) + spike, 0.0F};
+  }
+  return samples;
+}
+
+int main(int argc, char *argv[]) {
+  const double millions = argc > 1 ? std::atof(argv[1]) : 50.0;
+  const auto num_samples = static_cast<size_t>(millions * 1e6);
+
+  bb3d::HeadlessOptions headless;
+  headless.num_frames = 600;
+  bb3d::Window window(argv[0], headless);
+  // looking down on the x/y plane
+  window.SetCameraElevationDeg(-89);
+
+  bb3d::DecimatedLines lines;
+  if (argc > 2) {
+    lines.SetNumThreads(std::atoi(argv[2]));
+  }
+  std::vector<glm::vec3> samples = Telemetry(num_samples);
+  const float end_x = samples.back().x;
+  window.SetCameraFocus({0.5F * end_x, 0, 0});
+  const auto t_build = std::chrono::steady_clock::now();
+  lines.Update(std::move(samples));
+  const double build_ms =
+      1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t_build).count();
+
+  std::vector<double> frame_ms;
+  std::function<void(key_t)> handle_keypress = [](key_t key __attribute__((unused))) {};
+  std::function<void()> update_visualization = [&]() {
+    // From the whole trace down to a few seconds of it.
+    const float zoom =
+        static_cast<float>(window.FrameCount()) / static_cast<float>(headless.num_frames);
+    window.SetCameraDistance(end_x * std::pow(1e-4F, zoom));
+  };
+  std::function<void(const glm::mat4 &, const glm::mat4 &)> draw_visualization =
+      [&](const glm::mat4 &view, const glm::mat4 &proj) {
+        const auto t0 = std::chrono::steady_clock::now();
+        lines.Draw(view, proj, glm::vec4(1, 1, 1, 1));
+        frame_ms.push_back(
+            1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+      };
+  window.Run(handle_keypress, update_visualization, draw_visualization);
+
+  std::sort(frame_ms.begin(), frame_ms.end());
+  printf("samples %zu, build %.1f ms\n", lines.NumSamples(), build_ms);
+  printf("draw cpu ms: median %.3f, p99 %.3f, max %.3f\n", frame_ms[frame_ms.size() / 2],
+         frame_ms[frame_ms.size() * 99 / 100], frame_ms.back());
+  printf("last frame: %zu vertices drawn\n", lines.NumDrawnVertices());
+  return EXIT_SUCCESS;
+}
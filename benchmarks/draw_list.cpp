@@ -0,0 +1,139 @@
+// State changes and frame time of many small drawables of a few kinds, added in an interleaved
+// order: a ColorLines, a Cubemesh and a Lines each, over and over. A headless window draws them
+// from draw_visualization in that order for a number of frames, and then as many frames from the
+// window's DrawList, which sorts them by state. The sorted half should change programs and vertex
+// arrays once per kind rather than once per drawable, and skip most blending changes.
+//
+//   bazel run //:draw_list -- [groups of drawables]
+
+#include <sys/types.h>  // for key_t
+
+#include <GL/glew.h>  // for GL_LINE_STRIP
+
+#include <algorithm>           // for sort
+#include <chrono>              // for steady_clock, duration
+#include <cmath>               // for ceil, sqrt, sin, cos
+#include <cstdio>              // for printf
+#include <cstdlib>             // for EXIT_SUCCESS, atoi
+#include <eigen3/Eigen/Dense>  // for Matrix, Dynamic
+#include <functional>          // for function
+#include <glm/glm.hpp>         // for mat4, vec3, vec4
+#include <memory>              // for unique_ptr, make_unique
+#include <utility>             // for pair, make_pair, move
+#include <vector>              // for vector
+
+#include "bb3d/gl_state.hpp"           // for GlState, GlStateStats
+#include "bb3d/opengl_context.hpp"     // for Window, HeadlessOptions
+#include "bb3d/shader/colorlines.hpp"  // for ColorLines, ColoredVec3
+#include "bb3d/shader/cubemesh.hpp"    // for Cubemesh
+#include "bb3d/shader/lines.hpp"       // for Lines
+
+static double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+struct Group {
+  bb3d::ColorLines color_lines{};
+  bb3d::Cubemesh cubemesh{};
+  bb3d::Lines lines{};
+};
+
+int main(int argc, char *argv[]) {
+  const int num_groups = argc > 1 ? std::atoi(argv[1]) : 300;
+  const int frames_per_half = 300;
+  const glm::vec4 line_color(0.3F, 0.8F, 1.0F, 0.5F);
+
+  bb3d::HeadlessOptions headless;
+  headless.num_frames = 2 * frames_per_half;
+  bb3d::Window window(argv[0], headless);
+  window.SetCameraElevationDeg(-60);
+  window.SetCameraFocus({0, 0, 0});
+  window.SetCameraDistance(4);
+
+  // Groups on a square layout in the x/y plane, each a few boxes with a ring of lines above them.
+  std::vector<std::unique_ptr<Group> > groups;
+  const int side = static_cast<int>(std::ceil(std::sqrt(num_groups)));
+  for (int k = 0; k < num_groups; k++) {
+    const float x0 = -2 + 4 * static_cast<float>(k % side) / static_cast<float>(side);
+    const float y0 = -2 + 4 * static_cast<float>(k / side) / static_cast<float>(side);
+    const float size = 3.0F / static_cast<float>(side);
+    auto group = std::make_unique<Group>();
+
+    Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> grid(4, 4);
+    for (int ku = 0; ku < 4; ku++) {
+      for (int kv = 0; kv < 4; kv++) {
+        const float height = 0.02F * static_cast<float>((ku + kv + k) % 3);
+        grid(ku, kv) = std::make_pair(height, glm::vec3(0.5F, height * 20, 0.5F));
+      }
+    }
+    group->cubemesh.Update(grid, x0, x0 + size, y0, y0 + size);
+
+    std::vector<bb3d::ColoredVec3> ring;
+    std::vector<glm::vec3> square;
+    for (int kv = 0; kv <= 16; kv++) {
+      const float angle = 2 * 3.14159F * static_cast<float>(kv) / 16;
+      const glm::vec3 center(x0 + 0.5F * size, y0 + 0.5F * size, 0.2F);
+      ring.push_back({center + 0.4F * size * glm::vec3(std::cos(angle), std::sin(angle), 0),
+                      {1, 1, 1, 0.8F}});
+      square.push_back(center + 0.3F * size * glm::vec3(kv % 2, (kv / 2) % 2, 0.1F));
+    }
+    group->color_lines.Update(std::vector<std::vector<bb3d::ColoredVec3> >{ring});
+    group->lines.Update(std::vector<std::vector<glm::vec3> >{square});
+    groups.push_back(std::move(group));
+  }
+
+  std::vector<double> frame_ms[2];
+  std::vector<double> programs[2];
+  std::vector<double> vertex_arrays[2];
+  std::vector<double> capabilities[2];
+  std::vector<double> skipped[2];
+  auto t_last = std::chrono::steady_clock::now();
+  std::function<void(key_t)> handle_keypress = [](key_t key __attribute__((unused))) {};
+  std::function<void()> update_visualization = [&]() {
+    const auto t_now = std::chrono::steady_clock::now();
+    const int frame = window.FrameCount();
+    if (frame > 0) {
+      // FrameStats is of the previous frame, which is what frame_ms measures.
+      const int half = (frame - 1) / frames_per_half;
+      const bb3d::GlStateStats &stats = bb3d::GlState::Get().FrameStats();
+      frame_ms[half].push_back(1e3 * std::chrono::duration<double>(t_now - t_last).count());
+      programs[half].push_back(stats.programs);
+      vertex_arrays[half].push_back(stats.vertex_arrays);
+      capabilities[half].push_back(stats.capabilities + stats.blend_funcs);
+      skipped[half].push_back(stats.skipped);
+    }
+    t_last = t_now;
+    if (frame == frames_per_half) {
+      for (const std::unique_ptr<Group> &group : groups) {
+        window.GetDrawList().Add(group->color_lines, GL_LINE_STRIP);
+        window.GetDrawList().Add(group->cubemesh);
+        window.GetDrawList().Add(group->lines, line_color, GL_LINE_STRIP);
+      }
+    }
+  };
+  std::function<void(const glm::mat4 &, const glm::mat4 &)> draw_visualization =
+      [&](const glm::mat4 &view __attribute__((unused)),
+          const glm::mat4 &proj __attribute__((unused))) {
+        if (window.FrameCount() >= frames_per_half) {
+          return;
+        }
+        for (const std::unique_ptr<Group> &group : groups) {
+          group->color_lines.Draw(GL_LINE_STRIP);
+          group->cubemesh.Draw();
+          group->lines.Draw(line_color, GL_LINE_STRIP);
+        }
+      };
+  window.Run(handle_keypress, update_visualization, draw_visualization);
+
+  printf("%d drawables in %d groups\n", 3 * num_groups, num_groups);
+  const char *names[2] = {"in order", "draw list"};
+  for (int half = 0; half < 2; half++) {
+    printf(
+        "%-10s frame ms %.3f, programs %.0f, vertex arrays %.0f, enables and blend funcs %.0f, "
+        "skipped %.0f (medians)\n",
+        names[half], Median(frame_ms[half]), Median(programs[half]), Median(vertex_arrays[half]),
+        Median(capabilities[half]), Median(skipped[half]));
+  }
+  return EXIT_SUCCESS;
+}
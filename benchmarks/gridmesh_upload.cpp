@@ -0,0 +1,89 @@
+// Bytes uploaded and time per Gridmesh::Update for a large surface whose shape doesn't change,
+// compared with what the previous interleaved x/y/z/s/t + index buffer upload sent every time, and
+// with UpdateHeightmap which only sends the heights.
+//
+//   bazel run //:gridmesh_upload -- <texture image> [rows] [cols]
+
+#include <GL/glew.h>  // for glFinish
+
+#include <chrono>              // for steady_clock, duration
+#include <cstddef>             // for size_t
+#include <cstdio>              // for printf, fprintf
+#include <cstdlib>             // for EXIT_SUCCESS, EXIT_FAILURE, atoi
+#include <eigen3/Eigen/Dense>  // for Matrix, Dynamic
+#include <glm/glm.hpp>         // for vec3
+
+#include "bb3d/opengl_context.hpp"   // for Window
+#include "bb3d/shader/gridmesh.hpp"  // for Gridmesh
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <texture image> [rows] [cols]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const int rows = argc > 2 ? std::atoi(argv[2]) : 1000;
+  const int cols = argc > 3 ? std::atoi(argv[3]) : 1000;
+  const int num_updates = 30;
+
+  bb3d::Window window(argv[0]);
+  bb3d::Gridmesh gridmesh(argv[1]);
+
+  Eigen::Matrix<glm::vec3, Eigen::Dynamic, Eigen::Dynamic> grid(rows, cols);
+  for (int ku = 0; ku < rows; ku++) {
+    for (int kv = 0; kv < cols; kv++) {
+      grid(ku, kv) = glm::vec3(ku, kv, 0);
+    }
+  }
+
+  // what every Update used to upload: 5 floats per vertex, 6 indices per cell
+  const size_t vertices = static_cast<size_t>(rows) * static_cast<size_t>(cols);
+  const size_t cells = static_cast<size_t>(rows - 1) * static_cast<size_t>(cols - 1);
+  const size_t before_bytes = 5 * sizeof(float) * vertices + 6 * sizeof(GLuint) * cells;
+
+  gridmesh.Update(grid);
+  glFinish();
+  const size_t first_bytes = gridmesh.UploadedBytes();
+
+  size_t steady_bytes = 0;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int k = 0; k < num_updates; k++) {
+    grid(0, 0).z = static_cast<float>(k);
+    gridmesh.Update(grid);
+    steady_bytes += gridmesh.UploadedBytes();
+  }
+  glFinish();
+  const double seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+  Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> heights(rows, cols);
+  for (int ku = 0; ku < rows; ku++) {
+    for (int kv = 0; kv < cols; kv++) {
+      heights(ku, kv) = grid(ku, kv).z;
+    }
+  }
+  const auto limit = [](int n) { return static_cast<float>(n - 1); };
+  gridmesh.UpdateHeightmap(heights, 0, limit(rows), 0, limit(cols));
+  glFinish();
+
+  size_t heightmap_bytes = 0;
+  const auto t1 = std::chrono::steady_clock::now();
+  for (int k = 0; k < num_updates; k++) {
+    heights(0, 0) = static_cast<float>(k);
+    gridmesh.UpdateHeightmap(heights, 0, limit(rows), 0, limit(cols));
+    heightmap_bytes += gridmesh.UploadedBytes();
+  }
+  glFinish();
+  const double heightmap_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+
+  printf("%dx%d grid\n", rows, cols);
+  printf("bytes per update before (every update):  %zu\n", before_bytes);
+  printf("bytes per update after (first update):    %zu\n", first_bytes);
+  printf("bytes per update after (same shape):      %zu\n", steady_bytes / num_updates);
+  printf("time per update (same shape):             %.3f ms\n", 1e3 * seconds / num_updates);
+  printf("bytes per update heightmap (same shape):  %zu\n", heightmap_bytes / num_updates);
+  printf("time per update heightmap (same shape):   %.3f ms\n",
+         1e3 * heightmap_seconds / num_updates);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,79 @@
+// CPU used by a visualizer which nobody is interacting with: the scene is updated once and then
+// left alone for a while. Run it once with the default continuous rendering and once with
+// on-demand rendering to compare.
+//
+//   bazel run //:idle_cpu -- [continuous|on_demand] [seconds]
+//
+// CPU time is for the whole process, so it includes the GL driver's own threads.
+
+#include <sys/types.h>  // for key_t
+#include <time.h>       // for clock_gettime, CLOCK_PROCESS_CPUTIME_ID, timespec
+
+#include <chrono>       // for steady_clock, duration
+#include <cmath>        // for sin, cos
+#include <cstdio>       // for printf, fprintf
+#include <cstdlib>      // for EXIT_SUCCESS, EXIT_FAILURE, atof
+#include <cstring>      // for strcmp
+#include <functional>   // for function
+#include <glm/glm.hpp>  // for mat4, vec3, vec4
+#include <vector>       // for vector
+
+#include "bb3d/opengl_context.hpp"     // for Window
+#include "bb3d/shader/colorlines.hpp"  // for ColorLines, ColoredVec3
+
+static double ProcessCpuSeconds() {
+  timespec now{};
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+  return static_cast<double>(now.tv_sec) + 1e-9 * static_cast<double>(now.tv_nsec);
+}
+
+int main(int argc, char *argv[]) {
+  const bool on_demand = argc > 1 && strcmp(argv[1], "on_demand") == 0;
+  if (argc > 1 && !on_demand && strcmp(argv[1], "continuous") != 0) {
+    fprintf(stderr, "usage: %s [continuous|on_demand] [seconds]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const double duration_seconds = argc > 2 ? std::atof(argv[2]) : 10.0;
+
+  bb3d::Window window(argv[0]);
+  window.SetOnDemandRendering(on_demand);
+  bb3d::ColorLines spiral;
+
+  bool updated = false;
+  const auto t_start = std::chrono::steady_clock::now();
+  const double cpu_start = ProcessCpuSeconds();
+
+  std::function<void(key_t)> handle_keypress = [](key_t key __attribute__((unused))) {};
+
+  std::function<void()> update_visualization = [&]() {
+    if (!updated) {
+      std::vector<bb3d::ColoredVec3> line;
+      for (int k = 0; k < 1000; k++) {
+        const float s = static_cast<float>(k) / 999.0F;
+        line.push_back({{s * std::cos(30 * s), s * std::sin(30 * s), -s}, {s, 1 - s, 1, 1}});
+      }
+      spiral.Update({line});
+      updated = true;
+    }
+    if (std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count() >
+        duration_seconds) {
+      window.Close();
+    }
+  };
+
+  std::function<void(const glm::mat4 &, const glm::mat4 &)> draw_visualization =
+      [&](const glm::mat4 &view, const glm::mat4 &proj) {
+        spiral.Draw(view, proj, GL_LINE_STRIP);
+      };
+
+  window.Run(handle_keypress, update_visualization, draw_visualization);
+
+  const double cpu_seconds = ProcessCpuSeconds() - cpu_start;
+  const double wall_seconds =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - t_start).count();
+  printf("%-12s %8s %10s %10s\n", "mode", "frames", "cpu s", "cpu %");
+  printf("%-12s %8d %10.3f %10.1f\n", on_demand ? "on_demand" : "continuous", window.FrameCount(),
+         cpu_seconds, 100 * cpu_seconds / wall_seconds);
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,64 @@
+// Compare per-segment glDrawArrays against a single glMultiDrawArrays for many short polylines
+// (e.g. per-particle tracks), where the per-segment path is bound by draw call overhead.
+//
+//   bazel run //:multidraw -- [num_segments] [vertices_per_segment]
+
+#include <GL/glew.h>  // for glFinish, GL_LINE_STRIP
+
+#include <chrono>       // for steady_clock, duration
+#include <cmath>        // for sin, cos
+#include <cstdio>       // for printf
+#include <cstdlib>      // for EXIT_SUCCESS, atoi
+#include <glm/glm.hpp>  // for mat4, vec3, vec4
+#include <vector>       // for vector
+
+#include "bb3d/gl_state.hpp"           // for GlState
+#include "bb3d/opengl_context.hpp"     // for Window
+#include "bb3d/shader/colorlines.hpp"  // for ColorLines, ColoredVec3
+#include "bb3d/span.hpp"               // for Span
+
+int main(int argc, char *argv[]) {
+  const int num_segments = argc > 1 ? std::atoi(argv[1]) : 50000;
+  const int vertices_per_segment = argc > 2 ? std::atoi(argv[2]) : 8;
+  const int num_frames = 100;
+
+  bb3d::Window window(argv[0]);
+  const glm::mat4 view = window.GetWindowState()->GetViewTransformation();
+  const glm::mat4 proj = window.GetProjectionTransformation();
+
+  std::vector<bb3d::ColoredVec3> vertices;
+  std::vector<GLint> segment_offsets;
+  for (int ks = 0; ks < num_segments; ks++) {
+    segment_offsets.push_back(static_cast<GLint>(vertices.size()));
+    const float angle = 6.28F * static_cast<float>(ks) / static_cast<float>(num_segments);
+    for (int kv = 0; kv < vertices_per_segment; kv++) {
+      const float r = 1.0F + 0.1F * static_cast<float>(kv);
+      vertices.push_back({{r * std::cos(angle), r * std::sin(angle), 0}, {1, 1, 1, 1}});
+    }
+  }
+
+  bb3d::ColorLines lines;
+  lines.Update(vertices, segment_offsets);
+
+  printf("%d segments of %d vertices\n", num_segments, vertices_per_segment);
+  printf("%-12s %14s %12s\n", "path", "draws/frame", "ms/frame");
+  for (const bool batched : {false, true}) {
+    lines.SetBatchedDraw(batched);
+    lines.Draw(view, proj, GL_LINE_STRIP);  // warm up
+    glFinish();
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int k = 0; k < num_frames; k++) {
+      lines.Draw(view, proj, GL_LINE_STRIP);
+      bb3d::GlState::Get().EndFrame();
+    }
+    glFinish();
+    const double seconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    printf("%-12s %14d %12.3f\n", batched ? "multidraw" : "per-segment",
+           bb3d::GlState::Get().FrameStats().draws, 1e3 * seconds / num_frames);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+// Cost and latency of picking on a scene of millions of primitives: an instanced Cubemesh, a
+// ColorLines of many line strips above it and, given a texture image, a Gridmesh next to it. A
+// headless window draws the same view for a number of frames without picking and then as many
+// frames with a pick at a different spot every frame. Frame times of both halves should be nearly
+// the same, and results should arrive a frame or two after they are requested.
+//
+//   bazel run //:picking -- [cells per side] [texture image]
+
+#include <sys/types.h>  // for key_t
+
+#include <GL/glew.h>  // for GL_LINE_STRIP, GLint
+
+#include <algorithm>           // for sort
+#include <chrono>              // for steady_clock, duration
+#include <cmath>               // for sin, cos
+#include <cstdint>             // for uint32_t
+#include <cstdio>              // for printf
+#include <cstdlib>             // for EXIT_SUCCESS, atoi
+#include <deque>               // for deque
+#include <eigen3/Eigen/Dense>  // for Matrix, Dynamic
+#include <functional>          // for function
+#include <glm/glm.hpp>         // for mat4, vec3, vec4
+#include <memory>              // for unique_ptr, make_unique
+#include <string>              // for string
+#include <utility>             // for pair, make_pair
+#include <vector>              // for vector
+
+#include "bb3d/opengl_context.hpp"     // for Window, HeadlessOptions
+#include "bb3d/picker.hpp"             // for PickResult, PickedCell, PickedVertex
+#include "bb3d/shader/colorlines.hpp"  // for ColorLines, ColoredVec3
+#include "bb3d/shader/cubemesh.hpp"    // for Cubemesh, CubemeshMode
+#include "bb3d/shader/gridmesh.hpp"    // for Gridmesh
+
+static constexpr uint32_t kCubemeshId = 1;
+static constexpr uint32_t kLinesId = 2;
+static constexpr uint32_t kGridmeshId = 3;
+
+static double Median(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  return values.empty() ? 0.0 : values[values.size() / 2];
+}
+
+int main(int argc, char *argv[]) {
+  const int cells = argc > 1 ? std::atoi(argv[1]) : 1000;
+  const std::string texture = argc > 2 ? argv[2] : "";
+  const int frames_per_half = 300;
+
+  bb3d::HeadlessOptions headless;
+  headless.num_frames = 2 * frames_per_half;
+  bb3d::Window window(argv[0], headless);
+  // looking down on the x/y plane
+  window.SetCameraElevationDeg(-89);
+  window.SetCameraFocus({0, 0, 0});
+  window.SetCameraDistance(3);
+
+  // cells x cells boxes, 6 triangles each, over x in [-1, 0]
+  Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> grid(cells, cells);
+  for (int ku = 0; ku < cells; ku++) {
+    for (int kv = 0; kv < cells; kv++) {
+      const float height = 0.05F * static_cast<float>((ku * 7 + kv * 13) % 5);
+      grid(ku, kv) = std::make_pair(height, glm::vec3(height * 4, 0.5F, 1 - height * 4));
+    }
+  }
+  bb3d::Cubemesh cubemesh(bb3d::CubemeshMode::kInstanced);
+  cubemesh.Update(grid, -1, 0, -1, 1);
+
+  // as many line strips as there are rows of cells, of as many vertices as cells per row, above
+  std::vector<bb3d::ColoredVec3> vertices;
+  std::vector<GLint> segment_offsets;
+  for (int ks = 0; ks < cells; ks++) {
+    segment_offsets.push_back(static_cast<GLint>(vertices.size()));
+    const float y = -1 + 2 * static_cast<float>(ks) / static_cast<float>(cells);
+    for (int kv = 0; kv < cells; kv++) {
+      const float x = -1 + 2 * static_cast<float>(kv) / static_cast<float>(cells);
+      vertices.push_back({{x, y + 0.01F * std::sin(40 * x), 0.5F}, {1, 1, 1, 1}});
+    }
+  }
+  bb3d::ColorLines lines;
+  lines.Update(vertices, segment_offsets);
+
+  // a heightmap of cells x cells points over x in [0, 1]
+  std::unique_ptr<bb3d::Gridmesh> gridmesh;
+  if (!texture.empty()) {
+    Eigen::Matrix<float, Eigen::Dynamic, Eigen::Dynamic> heights(cells, cells);
+    for (int ku = 0; ku < cells; ku++) {
+      for (int kv = 0; kv < cells; kv++) {
+        heights(ku, kv) = 0.1F * std::cos(0.05F * static_cast<float>(ku + kv));
+      }
+    }
+    gridmesh = std::make_unique<bb3d::Gridmesh>(texture);
+    gridmesh->UpdateHeightmap(heights, 0, 1, -1, 1);
+  }
+
+  // (x of the request, frame it was requested in), x is unique per frame
+  std::deque<std::pair<double, int> > in_flight;
+  std::vector<double> latency_frames;
+  std::vector<int> hits(4, 0);
+  int misses = 0;
+  std::function<void()> draw_ids = [&]() {
+    cubemesh.DrawIds(kCubemeshId);
+    lines.DrawIds(kLinesId, GL_LINE_STRIP);
+    if (gridmesh != nullptr) {
+      gridmesh->DrawIds(kGridmeshId);
+    }
+  };
+  std::function<void(const bb3d::PickResult &)> handle_pick = [&](const bb3d::PickResult &result) {
+    // Requests which were replaced before they were drawn never get a result.
+    while (!in_flight.empty() && in_flight.front().first != result.x) {
+      in_flight.pop_front();
+    }
+    if (!in_flight.empty()) {
+      latency_frames.push_back(window.FrameCount() - in_flight.front().second);
+      in_flight.pop_front();
+    }
+    if (!result.hit) {
+      misses++;
+      return;
+    }
+    hits[result.object_id]++;
+    if (result.object_id == kLinesId) {
+      const bb3d::PickedVertex picked = lines.DecodePick(result.primitive_id);
+      if (hits[kLinesId] == 1) {
+        printf("first line hit: segment %d, vertex %d\n", picked.segment, picked.vertex);
+      }
+    } else {
+      const bb3d::PickedCell picked = result.object_id == kCubemeshId
+                                          ? cubemesh.DecodePick(result.primitive_id)
+                                          : gridmesh->DecodePick(result.primitive_id);
+      if (hits[result.object_id] == 1) {
+        printf("first %s hit: cell (%d, %d)\n",
+               result.object_id == kCubemeshId ? "cubemesh" : "gridmesh", picked.row, picked.col);
+      }
+    }
+  };
+  window.SetPicking(draw_ids, handle_pick, false);
+
+  std::vector<double> frame_ms[2];
+  auto t_last = std::chrono::steady_clock::now();
+  std::function<void(key_t)> handle_keypress = [](key_t key __attribute__((unused))) {};
+  std::function<void()> update_visualization = [&]() {
+    const auto t_now = std::chrono::steady_clock::now();
+    const int frame = window.FrameCount();
+    if (frame > 0) {
+      frame_ms[(frame - 1) / frames_per_half].push_back(
+          1e3 * std::chrono::duration<double>(t_now - t_last).count());
+    }
+    t_last = t_now;
+    if (frame >= frames_per_half) {
+      // Sweep across the middle of the window, through all drawables.
+      const double x = 10 + (frame - frames_per_half);
+      const double y = 0.5 * headless.height;
+      window.RequestPick(x, y);
+      in_flight.emplace_back(x, frame);
+    }
+  };
+  std::function<void(const glm::mat4 &, const glm::mat4 &)> draw_visualization =
+      [&](const glm::mat4 &view, const glm::mat4 &proj) {
+        cubemesh.Draw(view, proj);
+        lines.Draw(view, proj, GL_LINE_STRIP);
+        if (gridmesh != nullptr) {
+          gridmesh->Draw(view, proj);
+        }
+      };
+  window.Run(handle_keypress, update_visualization, draw_visualization);
+
+  const double triangles = 6.0 * cells * cells + (gridmesh != nullptr ? 2.0 * cells * cells : 0);
+  printf("%.1fM triangles, %zu line vertices\n", 1e-6 * triangles, vertices.size());
+  printf("frame ms (median): %.3f without picking, %.3f with\n", Median(frame_ms[0]),
+         Median(frame_ms[1]));
+  std::sort(latency_frames.begin(), latency_frames.end());
+  printf("picks: %zu results of %d requests, latency frames: median %.0f, max %.0f\n",
+         latency_frames.size(), frames_per_half, Median(latency_frames),
+         latency_frames.empty() ? 0.0 : latency_frames.back());
+  printf("hits: cubemesh %d, lines %d, gridmesh %d, nothing %d\n", hits[kCubemeshId],
+         hits[kLinesId], hits[kGridmeshId], misses);
+  return EXIT_SUCCESS;
+}
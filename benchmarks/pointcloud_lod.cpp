@@ -0,0 +1,96 @@
+// Frame times of a PointCloud much larger than its point budget, in a headless window. The cloud is
+// a synthetic city block pattern; the camera starts far away and zooms in on one corner, so both
+// the coarse and the fine levels of the octree are exercised. Frame times should stay flat as the
+// number of points grows. The cloud is generated and added a million points at a time, so with a
+// cache dir it never has to fit in memory.
+//
+//   bazel run //:pointcloud_lod -- [millions of points] [cache dir]
+
+#include <sys/types.h>  // for key_t
+
+#include <algorithm>    // for sort, min
+#include <chrono>       // for steady_clock, duration
+#include <cmath>        // for sin, cos, fmod, pow
+#include <cstdio>       // for printf
+#include <cstdlib>      // for EXIT_SUCCESS, atof
+#include <functional>   // for function
+#include <glm/glm.hpp>  // for mat4, vec3, vec4
+#include <random>       // for mt19937, uniform_real_distribution
+#include <vector>       // for vector
+
+#include "bb3d/opengl_context.hpp"     // for Window, HeadlessOptions
+#include "bb3d/shader/pointcloud.hpp"  // for PointCloud, PointCloudPoint, PointCloudOptions
+
+static std::vector<bb3d::PointCloudPoint> CityBlocks(const size_t num_points,
+                                                     std::mt19937 &generator) {
+  std::uniform_real_distribution<float> uniform(0.0F, 1.0F);
+  std::vector<bb3d::PointCloudPoint> points(num_points);
+  for (bb3d::PointCloudPoint &point : points) {
+    // 2 km x 2 km of ground with 50 m blocks of buildings up to 40 m tall.
+    const float x = 2000 * uniform(generator);
+    const float y = 2000 * uniform(generator);
+    const bool building = std::fmod(x, 50.0F) < 35 && std::fmod(y, 50.0F) < 35;
+    const float height = building ? 40 * (0.5F + 0.5F * std::sin(0.01F * x) * std::cos(0.01F * y))
+                                  : 0.0F;
+    const float z = height * uniform(generator);
+    point.position = {x, y, z};
+    point.color = bb3d::PackRgba8({0.3F + 0.7F * z / 40, 0.6F, 1.0F - 0.7F * z / 40, 1.0F});
+  }
+  return points;
+}
+
+int main(int argc, char *argv[]) {
+  const double millions = argc > 1 ? std::atof(argv[1]) : 20.0;
+  const auto num_points = static_cast<size_t>(millions * 1e6);
+  bb3d::PointCloudOptions options;
+  if (argc > 2) {
+    options.cache_dir = argv[2];
+  }
+
+  bb3d::HeadlessOptions headless;
+  headless.num_frames = 600;
+  bb3d::Window window(argv[0], headless);
+  window.SetCameraFocus({0, 0, 0});
+  window.SetCameraElevationDeg(-45);
+
+  bb3d::PointCloud cloud(options);
+  const auto t_build = std::chrono::steady_clock::now();
+  std::mt19937 generator(0);
+  const size_t batch_points = 1000000;
+  for (size_t added = 0; added < num_points; added += batch_points) {
+    cloud.AddPoints(CityBlocks(std::min(batch_points, num_points - added), generator));
+  }
+  cloud.FinishPoints();
+
+  std::vector<double> frame_ms;
+  double build_seconds = 0;
+  std::function<void(key_t)> handle_keypress = [](key_t key __attribute__((unused))) {};
+  std::function<void()> update_visualization = [&]() {
+    // From the whole map down to a single block.
+    const float zoom =
+        static_cast<float>(window.FrameCount()) / static_cast<float>(headless.num_frames);
+    window.SetCameraDistance(3000.0F * std::pow(0.005F, zoom));
+    if (build_seconds == 0 && !cloud.Stats().building) {
+      build_seconds =
+          std::chrono::duration<double>(std::chrono::steady_clock::now() - t_build).count();
+    }
+  };
+  std::function<void(const glm::mat4 &, const glm::mat4 &)> draw_visualization =
+      [&](const glm::mat4 &view, const glm::mat4 &proj) {
+        const auto t0 = std::chrono::steady_clock::now();
+        cloud.Draw(view, proj);
+        frame_ms.push_back(
+            1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count());
+      };
+  window.Run(handle_keypress, update_visualization, draw_visualization);
+
+  const bb3d::PointCloudStats stats = cloud.Stats();
+  std::sort(frame_ms.begin(), frame_ms.end());
+  printf("points %zu, nodes %d, build %.2f s%s\n", num_points, stats.num_nodes, build_seconds,
+         stats.building ? " (unfinished)" : "");
+  printf("draw cpu ms: median %.3f, p99 %.3f, max %.3f\n", frame_ms[frame_ms.size() / 2],
+         frame_ms[frame_ms.size() * 99 / 100], frame_ms.back());
+  printf("last frame: %d nodes, %zu points drawn, %zu points resident\n", stats.drawn_nodes,
+         stats.drawn_points, stats.resident_points);
+  return EXIT_SUCCESS;
+}
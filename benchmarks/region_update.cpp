@@ -0,0 +1,155 @@
+// Bytes uploaded and time per frame when a small part of a large Cubemesh or Gridmesh changes every
+// frame (e.g. an occupancy map being filled in), comparing a full Update, UpdateRegion on the
+// changed patches and Update with diff updates enabled.
+//
+//   bazel run //:region_update -- [texture image] [size]
+//
+// The Gridmesh is only measured when a texture image is given.
+
+#include <GL/glew.h>  // for glFinish
+
+#include <chrono>              // for steady_clock, duration
+#include <cstddef>             // for size_t
+#include <cstdio>              // for printf
+#include <cstdlib>             // for EXIT_SUCCESS, atoi
+#include <eigen3/Eigen/Dense>  // for Matrix, Dynamic
+#include <glm/glm.hpp>         // for vec3
+#include <random>              // for mt19937, uniform_int_distribution
+#include <utility>             // for pair
+#include <vector>              // for vector
+
+#include "bb3d/opengl_context.hpp"   // for Window
+#include "bb3d/shader/cubemesh.hpp"  // for Cubemesh, CubemeshMode
+#include "bb3d/shader/gridmesh.hpp"  // for Gridmesh
+
+namespace {
+
+constexpr int kPatchSize = 8;
+constexpr int kNumFrames = 20;
+
+struct Patch {
+  int row0;
+  int col0;
+};
+
+// Patches covering about 1% of a size x size grid, different every frame.
+std::vector<std::vector<Patch> > MakePatches(const int size) {
+  const int num_patches = size * size / 100 / (kPatchSize * kPatchSize);
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> corner(0, size - kPatchSize);
+  std::vector<std::vector<Patch> > frames(kNumFrames);
+  for (std::vector<Patch> &patches : frames) {
+    for (int k = 0; k < num_patches; k++) {
+      patches.push_back({corner(rng), corner(rng)});
+    }
+  }
+  return frames;
+}
+
+void PrintRow(const char *drawable, const char *path, size_t bytes, double seconds) {
+  printf("%-10s %-10s %14.2f %12.3f\n", drawable, path,
+         static_cast<double>(bytes) / kNumFrames / 1e6, 1e3 * seconds / kNumFrames);
+}
+
+// Run every frame of `frame(k)` and return the total bytes uploaded and seconds taken.
+template <typename F>
+std::pair<size_t, double> TimeFrames(F frame) {
+  size_t bytes = 0;
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int k = 0; k < kNumFrames; k++) {
+    bytes += frame(k);
+  }
+  glFinish();
+  return {bytes, std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count()};
+}
+
+template <typename T, typename Mesh, typename Fill, typename FullUpdate>
+void Compare(const char *name, Mesh &mesh, const int size,
+             const std::vector<std::vector<Patch> > &frames, Fill fill, FullUpdate full_update) {
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> grid(size, size);
+  for (int ku = 0; ku < size; ku++) {
+    for (int kv = 0; kv < size; kv++) {
+      grid(ku, kv) = fill(ku, kv, 0);
+    }
+  }
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> block(kPatchSize, kPatchSize);
+  const auto apply_patches = [&](const int k, const bool upload_regions) {
+    size_t bytes = 0;
+    for (const Patch &patch : frames[static_cast<size_t>(k)]) {
+      for (int ku = 0; ku < kPatchSize; ku++) {
+        for (int kv = 0; kv < kPatchSize; kv++) {
+          block(ku, kv) = fill(patch.row0 + ku, patch.col0 + kv, k + 1);
+          grid(patch.row0 + ku, patch.col0 + kv) = block(ku, kv);
+        }
+      }
+      if (upload_regions) {
+        mesh.UpdateRegion(patch.row0, patch.col0, block);
+        bytes += mesh.UploadedBytes();
+      }
+    }
+    return bytes;
+  };
+
+  full_update(grid);
+  glFinish();
+  const auto full = TimeFrames([&](int k) {
+    apply_patches(k, false);
+    full_update(grid);
+    return mesh.UploadedBytes();
+  });
+  PrintRow(name, "full", full.first, full.second);
+
+  const auto region = TimeFrames([&](int k) { return apply_patches(k, true); });
+  PrintRow(name, "region", region.first, region.second);
+
+  mesh.SetDiffUpdates(true);
+  full_update(grid);
+  glFinish();
+  const auto diff = TimeFrames([&](int k) {
+    apply_patches(k, false);
+    full_update(grid);
+    return mesh.UploadedBytes();
+  });
+  PrintRow(name, "diff", diff.first, diff.second);
+  mesh.SetDiffUpdates(false);
+}
+
+};  // namespace
+
+int main(int argc, char *argv[]) {
+  const int size = argc > 2 ? std::atoi(argv[2]) : 4096;
+  const std::vector<std::vector<Patch> > frames = MakePatches(size);
+
+  bb3d::Window window(argv[0]);
+
+  printf("%dx%d grid, %zu patches of %dx%d per frame\n", size, size, frames[0].size(), kPatchSize,
+         kPatchSize);
+  printf("%-10s %-10s %14s %12s\n", "drawable", "path", "MB/frame", "ms/frame");
+
+  for (const bb3d::CubemeshMode mode :
+       {bb3d::CubemeshMode::kExpanded, bb3d::CubemeshMode::kInstanced}) {
+    bb3d::Cubemesh cubemesh(mode);
+    Compare<std::pair<float, glm::vec3> >(
+        mode == bb3d::CubemeshMode::kExpanded ? "Cubemesh" : "Instanced", cubemesh, size, frames,
+        [](int ku, int kv, int k) {
+          return std::make_pair(0.1F * static_cast<float>(k),
+                                glm::vec3(static_cast<float>(ku % 2), static_cast<float>(kv % 2),
+                                          static_cast<float>(k % 2)));
+        },
+        [&](const Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> &g) {
+          cubemesh.Update(g, 0, 1, 0, 1);
+        });
+  }
+
+  if (argc > 1) {
+    bb3d::Gridmesh gridmesh(argv[1]);
+    Compare<glm::vec3>(
+        "Gridmesh", gridmesh, size, frames,
+        [](int ku, int kv, int k) { return glm::vec3(ku, kv, 0.1F * static_cast<float>(k)); },
+        [&](const Eigen::Matrix<glm::vec3, Eigen::Dynamic, Eigen::Dynamic> &g) {
+          gridmesh.Update(g);
+        });
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,121 @@
+// Time to construct a typical set of drawables, first with an empty program binary cache (every
+// distinct program is compiled once and shared by the other instances), then again after they have
+// all been destroyed, when the programs come from the on-disk cache.
+//
+//   bazel run //:shader_startup -- [instances of each drawable] [cache directory]
+//
+// Without a cache directory a fresh one is made under /tmp. Gridmesh is textured with a small
+// generated image.
+
+#include <GL/glew.h>    // for glFinish
+#include <SOIL/SOIL.h>  // for SOIL_save_image, SOIL_SAVE_TYPE_TGA
+#include <unistd.h>     // for rmdir
+
+#include <chrono>   // for steady_clock, duration
+#include <cstddef>  // for size_t
+#include <cstdio>   // for printf, perror, fprintf, remove
+#include <cstdlib>  // for EXIT_SUCCESS, EXIT_FAILURE, atoi, exit, mkdtemp
+#include <memory>   // for unique_ptr, make_unique
+#include <string>   // for string
+#include <vector>   // for vector
+
+#include "bb3d/opengl_context.hpp"     // for Window
+#include "bb3d/shader/colorlines.hpp"  // for ColorLines
+#include "bb3d/shader/cubemesh.hpp"    // for Cubemesh, CubemeshMode
+#include "bb3d/shader/freetype.hpp"    // for Freetype
+#include "bb3d/shader/gridmesh.hpp"    // for Gridmesh
+#include "bb3d/shader/lines.hpp"       // for Lines
+#include "bb3d/shader/shader.hpp"      // for Shader
+
+namespace {
+
+struct Drawables {
+  std::vector<std::unique_ptr<bb3d::ColorLines> > color_lines{};
+  std::vector<std::unique_ptr<bb3d::Lines> > lines{};
+  std::vector<std::unique_ptr<bb3d::Cubemesh> > cubemeshes{};
+  std::vector<std::unique_ptr<bb3d::Gridmesh> > gridmeshes{};
+  std::vector<std::unique_ptr<bb3d::Freetype> > freetypes{};
+};
+
+// Write a 16x16 checkerboard image for Gridmesh into `directory`, and return its path.
+std::string WriteTexture(const std::string &directory) {
+  const int size = 16;
+  std::vector<unsigned char> pixels(static_cast<size_t>(4 * size * size));
+  for (int k = 0; k < size * size; k++) {
+    const unsigned char value = (k / size + k % size) % 2 == 0 ? 230 : 40;
+    for (int channel = 0; channel < 3; channel++) {
+      pixels[static_cast<size_t>(4 * k + channel)] = value;
+    }
+    pixels[static_cast<size_t>(4 * k + 3)] = 255;
+  }
+  const std::string path = directory + "/texture.tga";
+  if (SOIL_save_image(path.c_str(), SOIL_SAVE_TYPE_TGA, size, size, 4, pixels.data()) == 0) {
+    fprintf(stderr, "Can't write %s\n", path.c_str());
+    exit(EXIT_FAILURE);
+  }
+  return path;
+}
+
+// Construct the drawables and print how long it took and where their programs came from.
+void Startup(const char *name, const int instances, const std::string &texture) {
+  const bb3d::Shader::ProgramCacheStats before = bb3d::Shader::GetProgramCacheStats();
+  const auto t0 = std::chrono::steady_clock::now();
+  {
+    Drawables drawables;
+    for (int k = 0; k < instances; k++) {
+      drawables.color_lines.push_back(std::make_unique<bb3d::ColorLines>());
+      drawables.lines.push_back(std::make_unique<bb3d::Lines>());
+      drawables.cubemeshes.push_back(
+          std::make_unique<bb3d::Cubemesh>(bb3d::CubemeshMode::kExpanded));
+      drawables.cubemeshes.push_back(
+          std::make_unique<bb3d::Cubemesh>(bb3d::CubemeshMode::kInstanced));
+      drawables.gridmeshes.push_back(std::make_unique<bb3d::Gridmesh>(texture));
+      drawables.freetypes.push_back(std::make_unique<bb3d::Freetype>(18));
+    }
+    // some drivers finish linking lazily
+    glFinish();
+  }
+  const double ms =
+      1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  const bb3d::Shader::ProgramCacheStats after = bb3d::Shader::GetProgramCacheStats();
+  printf("%-12s %10.2f %10d %10d %10d\n", name, ms, after.compiled - before.compiled,
+         after.loaded_from_disk - before.loaded_from_disk, after.shared - before.shared);
+}
+
+};  // namespace
+
+int main(int argc, char *argv[]) {
+  const int instances = argc > 1 ? std::atoi(argv[1]) : 10;
+  std::string cache_directory;
+  if (argc > 2) {
+    cache_directory = argv[2];
+  } else {
+    std::string pattern = "/tmp/bb3d_program_cache_XXXXXX";
+    if (mkdtemp(pattern.data()) == nullptr) {
+      perror("mkdtemp");
+      return EXIT_FAILURE;
+    }
+    cache_directory = pattern;
+  }
+
+  std::string texture_directory = "/tmp/bb3d_shader_startup_XXXXXX";
+  if (mkdtemp(texture_directory.data()) == nullptr) {
+    perror("mkdtemp");
+    return EXIT_FAILURE;
+  }
+  const std::string texture = WriteTexture(texture_directory);
+
+  bb3d::Window window(argv[0]);
+  bb3d::Shader::SetProgramBinaryCacheDirectory(cache_directory);
+
+  printf("%d instances each of 6 drawables, program cache in %s\n", instances,
+         cache_directory.c_str());
+  printf("%-12s %10s %10s %10s %10s\n", "cache", "ms", "compiled", "from disk", "shared");
+  Startup("cold", instances, texture);
+  Startup("warm", instances, texture);
+
+  std::remove(texture.c_str());
+  rmdir(texture_directory.c_str());
+
+  return EXIT_SUCCESS;
+}
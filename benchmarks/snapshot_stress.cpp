@@ -0,0 +1,139 @@
+// Stress test for the triple-buffered snapshot path: several producer threads publish scenes at
+// kHz rates while the render loop draws. Prints how many snapshots were published and consumed
+// and the distribution of frame times, and fails if the render loop stalled.
+//
+//   bazel run //:snapshot_stress -- [num_producers] [publish_hz] [seconds]
+
+#include <sys/types.h>  // for key_t
+
+#include <algorithm>    // for sort
+#include <atomic>       // for atomic
+#include <chrono>       // for steady_clock, duration
+#include <cmath>        // for sin, cos
+#include <cstdint>      // for int64_t
+#include <cstdio>       // for printf
+#include <cstdlib>      // for EXIT_SUCCESS, EXIT_FAILURE, atoi, atof
+#include <functional>   // for function
+#include <glm/glm.hpp>  // for mat4, vec3, vec4
+#include <memory>       // for unique_ptr
+#include <thread>       // for thread, sleep_until
+#include <vector>       // for vector
+
+#include "bb3d/opengl_context.hpp"     // for Window
+#include "bb3d/scene_snapshot.hpp"     // for SceneSnapshots, SceneSnapshot
+#include "bb3d/shader/colorlines.hpp"  // for ColorLines, ColoredVec3
+
+// Overwrite the recycled back slot with a spiral which moves with time.
+static void FillSnapshot(bb3d::SceneSnapshot &snapshot, int producer, int64_t sequence) {
+  const int num_lines = 8;
+  const int points_per_line = 256;
+  snapshot.color_lines.resize(num_lines);
+  for (int kl = 0; kl < num_lines; kl++) {
+    std::vector<bb3d::ColoredVec3> &line = snapshot.color_lines[static_cast<size_t>(kl)];
+    line.clear();
+    for (int kp = 0; kp < points_per_line; kp++) {
+      const float s = static_cast<float>(kp) / static_cast<float>(points_per_line - 1);
+      const float phase = 1e-3F * static_cast<float>(sequence) + static_cast<float>(kl);
+      const float radius = 1.0F + static_cast<float>(producer);
+      const glm::vec3 position = {radius * std::cos(6.28F * s + phase),
+                                  radius * std::sin(6.28F * s + phase), -s};
+      const glm::vec4 color = {s, 1.0F - s, static_cast<float>(producer % 2), 1.0F};
+      line.push_back({position, color});
+    }
+  }
+}
+
+int main(int argc, char *argv[]) {
+  const int num_producers = argc > 1 ? std::atoi(argv[1]) : 4;
+  const double publish_hz = argc > 2 ? std::atof(argv[2]) : 2000.0;
+  const double duration_seconds = argc > 3 ? std::atof(argv[3]) : 5.0;
+
+  bb3d::Window window(argv[0]);
+  bb3d::SceneSnapshots snapshots(num_producers);
+
+  std::vector<std::unique_ptr<bb3d::ColorLines> > lines;
+  for (int k = 0; k < num_producers; k++) {
+    lines.push_back(std::make_unique<bb3d::ColorLines>());
+  }
+
+  // producers
+  std::atomic<bool> running{true};
+  std::vector<std::atomic<int64_t> > published(static_cast<size_t>(num_producers));
+  std::vector<std::thread> producers;
+  for (int producer = 0; producer < num_producers; producer++) {
+    producers.emplace_back([&, producer]() {
+      const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::duration<double>(1.0 / publish_hz));
+      auto next_publish = std::chrono::steady_clock::now();
+      bb3d::TripleBuffer<bb3d::SceneSnapshot> &buffer = snapshots.Producer(producer);
+      int64_t sequence = 0;
+      while (running) {
+        FillSnapshot(buffer.Back(), producer, sequence);
+        snapshots.Publish(producer);
+        sequence++;
+        published[static_cast<size_t>(producer)] = sequence;
+        next_publish += period;
+        std::this_thread::sleep_until(next_publish);
+      }
+    });
+  }
+
+  // consumer
+  std::vector<int64_t> consumed(static_cast<size_t>(num_producers), 0);
+  std::vector<double> frame_times;
+  const auto t_start = std::chrono::steady_clock::now();
+  auto t_last_frame = t_start;
+
+  std::function<void(key_t)> handle_keypress = [](key_t key __attribute__((unused))) {};
+
+  std::function<void(int, const bb3d::SceneSnapshot &)> update_visualization =
+      [&](int producer, const bb3d::SceneSnapshot &snapshot) {
+        lines[static_cast<size_t>(producer)]->Update(snapshot.color_lines);
+        consumed[static_cast<size_t>(producer)]++;
+      };
+
+  std::function<void(const glm::mat4 &, const glm::mat4 &)> draw_visualization =
+      [&](const glm::mat4 &view, const glm::mat4 &proj) {
+        for (const std::unique_ptr<bb3d::ColorLines> &line : lines) {
+          line->Draw(view, proj, GL_LINE_STRIP);
+        }
+        const auto t_now = std::chrono::steady_clock::now();
+        frame_times.push_back(std::chrono::duration<double>(t_now - t_last_frame).count());
+        t_last_frame = t_now;
+        if (std::chrono::duration<double>(t_now - t_start).count() > duration_seconds) {
+          window.Close();
+        }
+      };
+
+  window.Run(handle_keypress, snapshots, update_visualization, draw_visualization);
+
+  running = false;
+  for (std::thread &producer : producers) {
+    producer.join();
+  }
+
+  // The first frame includes startup.
+  if (frame_times.size() < 3) {
+    fprintf(stderr, "Too few frames rendered (%zu).\n", frame_times.size());
+    return EXIT_FAILURE;
+  }
+  frame_times.erase(frame_times.begin());
+  std::sort(frame_times.begin(), frame_times.end());
+  const double median = frame_times[frame_times.size() / 2];
+  const double p99 = frame_times[frame_times.size() * 99 / 100];
+  const double worst = frame_times.back();
+
+  for (int producer = 0; producer < num_producers; producer++) {
+    printf("producer %d: published %ld, consumed %ld\n", producer,
+           static_cast<long>(published[static_cast<size_t>(producer)]),  // NOLINT
+           static_cast<long>(consumed[static_cast<size_t>(producer)]));   // NOLINT
+  }
+  printf("frames: %zu, median %.2f ms, p99 %.2f ms, max %.2f ms\n", frame_times.size(),
+         1e3 * median, 1e3 * p99, 1e3 * worst);
+
+  // Steady means no frame took more than a few vsync intervals longer than a typical frame. A
+  // render loop which blocked on producers would show up here.
+  const bool steady = p99 < 3.0 * median;
+  printf("%s\n", steady ? "PASS" : "FAIL: render loop frame time was not steady");
+  return steady ? EXIT_SUCCESS : EXIT_FAILURE;
+}
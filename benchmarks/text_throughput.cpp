@@ -0,0 +1,71 @@
+// Characters per millisecond drawn by Freetype, one RenderText (one draw call) per line compared
+// with queueing every line of the frame with AddText and drawing them with a single Flush.
+//
+//   bazel run //:text_throughput -- [lines] [characters per line]
+
+#include <GL/glew.h>  // for glFinish
+
+#include <chrono>       // for steady_clock, duration
+#include <cstddef>      // for size_t
+#include <cstdio>       // for printf
+#include <cstdlib>      // for EXIT_SUCCESS, atoi
+#include <glm/glm.hpp>  // for mat4, vec3
+#include <string>       // for string
+#include <vector>       // for vector
+
+#include "bb3d/gl_state.hpp"         // for GlState
+#include "bb3d/opengl_context.hpp"   // for Window
+#include "bb3d/shader/freetype.hpp"  // for Freetype
+
+int main(int argc, char *argv[]) {
+  const int num_lines = argc > 1 ? std::atoi(argv[1]) : 50;
+  const int line_length = argc > 2 ? std::atoi(argv[2]) : 80;
+  const int num_frames = 100;
+
+  bb3d::Window window(argv[0]);
+  const glm::mat4 projection = window.GetOrthographicProjection();
+  bb3d::Freetype freetype(14);
+
+  std::vector<std::string> lines;
+  for (int k = 0; k < num_lines; k++) {
+    std::string line;
+    for (int c = 0; c < line_length; c++) {
+      line.push_back(static_cast<char>('!' + (k + c) % 94));
+    }
+    lines.push_back(line);
+  }
+
+  printf("%d lines of %d characters\n", num_lines, line_length);
+  printf("%-12s %14s %12s %12s\n", "path", "draws/frame", "ms/frame", "chars/ms");
+  for (const bool batched : {false, true}) {
+    const auto frame = [&]() {
+      for (size_t k = 0; k < lines.size(); k++) {
+        const float y = 20.0F + 16.0F * static_cast<float>(k);
+        if (batched) {
+          freetype.AddText(lines[k], 10.0F, y, glm::vec3(1, 1, 1));
+        } else {
+          freetype.RenderText(projection, lines[k], 10.0F, y, glm::vec3(1, 1, 1));
+        }
+      }
+      freetype.Flush(projection);
+      bb3d::GlState::Get().EndFrame();
+    };
+    frame();  // warm up
+    glFinish();
+
+    const auto t0 = std::chrono::steady_clock::now();
+    for (int k = 0; k < num_frames; k++) {
+      frame();
+    }
+    glFinish();
+    const double ms_per_frame =
+        1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() /
+        num_frames;
+
+    printf("%-12s %14d %12.3f %12.1f\n", batched ? "batched" : "per-line",
+           bb3d::GlState::Get().FrameStats().draws, ms_per_frame,
+           num_lines * line_length / ms_per_frame);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,89 @@
+// Compare vertex upload throughput of the glBufferSubData and persistent-mapped streaming paths of
+// ColorLines and Lines. Each iteration is one Update and one Draw, like a frame. To measure under
+// Mesa's software rasterizer:
+//
+//   LIBGL_ALWAYS_SOFTWARE=1 GALLIUM_DRIVER=llvmpipe bazel run //:upload_throughput
+
+#include <GL/glew.h>  // for glFinish, GL_LINE_STRIP
+
+#include <chrono>       // for steady_clock, duration
+#include <cstdio>       // for printf
+#include <cstdlib>      // for EXIT_SUCCESS
+#include <glm/glm.hpp>  // for mat4, vec3, vec4
+#include <vector>       // for vector
+
+#include "bb3d/opengl_context.hpp"     // for Window
+#include "bb3d/shader/colorlines.hpp"  // for ColorLines, ColoredVec3
+#include "bb3d/shader/lines.hpp"       // for Lines
+#include "bb3d/streaming_buffer.hpp"   // for UploadMode, StreamingBuffer
+
+static const char *ModeName(bb3d::UploadMode mode) {
+  return mode == bb3d::UploadMode::kPersistentMapped ? "persistent" : "buffersubdata";
+}
+
+// Run `frame` until at least `min_seconds` have passed, return seconds per iteration.
+template <typename F>
+static double TimeIterations(F frame, double min_seconds) {
+  // warm up, including the first allocation
+  frame();
+  glFinish();
+
+  int iterations = 0;
+  const auto t0 = std::chrono::steady_clock::now();
+  double elapsed = 0;
+  while (elapsed < min_seconds) {
+    frame();
+    iterations++;
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  }
+  glFinish();
+  elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+  return elapsed / iterations;
+}
+
+int main(int argc __attribute__((unused)), char *argv[]) {
+  bb3d::Window window(argv[0]);
+  const glm::mat4 view = window.GetWindowState()->GetViewTransformation();
+  const glm::mat4 proj = window.GetProjectionTransformation();
+
+  printf("GL_ARB_buffer_storage: %s\n",
+         bb3d::StreamingBuffer::PersistentMappingSupported() ? "yes" : "no");
+  printf("%-12s %-14s %10s %12s %12s\n", "drawable", "mode", "vertices", "ms/frame", "MB/s");
+
+  for (const int num_vertices : {1000, 10000, 100000, 1000000}) {
+    std::vector<std::vector<bb3d::ColoredVec3> > colored(1);
+    std::vector<std::vector<glm::vec3> > plain(1);
+    for (int k = 0; k < num_vertices; k++) {
+      const auto s = static_cast<float>(k) / static_cast<float>(num_vertices);
+      colored[0].push_back({{s, s * s, -s}, {s, 1 - s, 0.5F, 1}});
+      plain[0].emplace_back(s, s * s, -s);
+    }
+
+    for (const bb3d::UploadMode mode :
+         {bb3d::UploadMode::kBufferSubData, bb3d::UploadMode::kPersistentMapped}) {
+      bb3d::ColorLines color_lines(mode);
+      const double colorlines_seconds = TimeIterations(
+          [&]() {
+            color_lines.Update(colored);
+            color_lines.Draw(view, proj, GL_LINE_STRIP);
+          },
+          1.0);
+      const double colorlines_bytes = 7.0 * sizeof(float) * num_vertices;
+      printf("%-12s %-14s %10d %12.3f %12.1f\n", "ColorLines", ModeName(mode), num_vertices,
+             1e3 * colorlines_seconds, colorlines_bytes / colorlines_seconds / 1e6);
+
+      bb3d::Lines lines(mode);
+      const double lines_seconds = TimeIterations(
+          [&]() {
+            lines.Update(plain);
+            lines.Draw(view, proj, glm::vec4(1, 1, 1, 1), GL_LINE_STRIP);
+          },
+          1.0);
+      const double lines_bytes = 3.0 * sizeof(float) * num_vertices;
+      printf("%-12s %-14s %10d %12.3f %12.1f\n", "Lines", ModeName(mode), num_vertices,
+             1e3 * lines_seconds, lines_bytes / lines_seconds / 1e6);
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
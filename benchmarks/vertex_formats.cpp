@@ -0,0 +1,97 @@
+// GPU memory and frame time of the float and compact vertex formats of ColorLines and Cubemesh, at
+// 10M vertices each, in a headless window. Each iteration is one full Update and one Draw.
+//
+//   bazel run //:vertex_formats
+
+#include <GL/glew.h>  // for glFinish, GL_LINE_STRIP
+
+#include <chrono>              // for steady_clock, duration
+#include <cmath>               // for sin, cos
+#include <cstdio>              // for printf
+#include <cstdlib>             // for EXIT_SUCCESS
+#include <eigen3/Eigen/Dense>  // for Matrix, Dynamic
+#include <glm/glm.hpp>         // for mat4, vec3, vec4
+#include <utility>             // for pair
+#include <vector>              // for vector
+
+#include "bb3d/opengl_context.hpp"     // for Window, HeadlessOptions
+#include "bb3d/shader/colorlines.hpp"  // for ColorLines, ColoredVec3
+#include "bb3d/shader/cubemesh.hpp"    // for Cubemesh, CubemeshMode
+#include "bb3d/vertex_format.hpp"      // for VertexFormat
+
+static const char *FormatName(bb3d::VertexFormat format) {
+  return format == bb3d::VertexFormat::kCompact ? "compact" : "float";
+}
+
+// Time `frame` with the GPU work included, return milliseconds per iteration.
+template <typename F>
+static double TimeIterations(F frame, int iterations) {
+  // warm up, including the first allocation
+  frame();
+  glFinish();
+
+  const auto t0 = std::chrono::steady_clock::now();
+  for (int k = 0; k < iterations; k++) {
+    frame();
+  }
+  glFinish();
+  return 1e3 * std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count() /
+         iterations;
+}
+
+int main(int argc __attribute__((unused)), char *argv[]) {
+  bb3d::Window window(argv[0], bb3d::HeadlessOptions{});
+  const glm::mat4 view = window.GetWindowState()->GetViewTransformation();
+  const glm::mat4 proj = window.GetProjectionTransformation();
+  const int iterations = 10;
+
+  // 10M vertices of a spiral.
+  const int num_vertices = 10000000;
+  std::vector<std::vector<bb3d::ColoredVec3> > spiral(1);
+  spiral[0].reserve(num_vertices);
+  for (int k = 0; k < num_vertices; k++) {
+    const auto s = static_cast<float>(k) / static_cast<float>(num_vertices);
+    const float angle = 2000 * s;
+    spiral[0].push_back(
+        {{100 * s * std::cos(angle), 100 * s * std::sin(angle), 10 * s}, {s, 1 - s, 0.5F, 1}});
+  }
+
+  // 1581 x 1581 cells of 4 vertices each, also 10M vertices.
+  const int n = 1581;
+  Eigen::Matrix<std::pair<float, glm::vec3>, Eigen::Dynamic, Eigen::Dynamic> grid(n, n);
+  for (int kx = 0; kx < n; kx++) {
+    for (int ky = 0; ky < n; ky++) {
+      const float z =
+          std::sin(0.02F * static_cast<float>(kx)) * std::cos(0.03F * static_cast<float>(ky));
+      grid(kx, ky) = {z, glm::vec3(0.5F + 0.5F * z, 0.5F, 0.5F - 0.5F * z)};
+    }
+  }
+
+  printf("%-12s %-8s %10s %14s %12s\n", "drawable", "format", "vertices", "uploaded MB",
+         "ms/frame");
+  for (const bb3d::VertexFormat format :
+       {bb3d::VertexFormat::kFloat, bb3d::VertexFormat::kCompact}) {
+    bb3d::ColorLines color_lines(bb3d::UploadMode::kBufferSubData, format);
+    const double colorlines_ms = TimeIterations(
+        [&]() {
+          color_lines.Update(spiral);
+          color_lines.Draw(view, proj, GL_LINE_STRIP);
+        },
+        iterations);
+    printf("%-12s %-8s %10d %14.1f %12.2f\n", "ColorLines", FormatName(format), num_vertices,
+           static_cast<double>(color_lines.UploadedBytes()) / 1e6, colorlines_ms);
+
+    bb3d::Cubemesh cubemesh(bb3d::CubemeshMode::kExpanded, format);
+    const double cubemesh_ms = TimeIterations(
+        [&]() {
+          cubemesh.Update(grid, -100, 100, -100, 100);
+          cubemesh.Draw(view, proj);
+        },
+        iterations);
+    // UploadedBytes includes the index buffer, which is the same for both formats.
+    printf("%-12s %-8s %10d %14.1f %12.2f\n", "Cubemesh", FormatName(format), 4 * n * n,
+           static_cast<double>(cubemesh.UploadedBytes()) / 1e6, cubemesh_ms);
+  }
+
+  return EXIT_SUCCESS;
+}